@@ -9,8 +9,77 @@ namespace config {
 constexpr const char *kDeviceName = "smart-garden-esp32";
 
 // ---- Telemetry ----
-constexpr uint32_t kTelemetryIntervalMs = 10000;
+constexpr uint32_t kTelemetryIntervalMs = 10000;  // One timestamped sample per tick
 constexpr uint32_t kSensorReadIntervalMs = 5000;  // 5 seconds (easier to read logs)
+// Samples per batch publish. 1 by default: the rule chain that drives
+// self_light_enable reacts to temperature_c only when it arrives, so each
+// extra sample per batch delays it by one telemetry interval.
+constexpr uint32_t kTelemetryBatchSize = 1;
+constexpr uint32_t kTelemetryMaxLatencyMs = 120000;  // Flush even if the batch is not full
+constexpr bool kTelemetryQos1 = true;        // PUBACK-tracked, resent after reconnect
+constexpr uint8_t kTelemetryQos1Window = 4;  // Unacknowledged publishes in flight
+
+// ---- Offline telemetry backlog (raw flash ring log) ----
+// The default partition table's "spiffs" data partition is otherwise unused.
+constexpr const char *kTelemetryLogPartition = "spiffs";
+constexpr uint32_t kReplayIntervalMs = 2000;  // At most one backlog publish per interval
+constexpr uint8_t kReplayBatchSamples = 8;    // Records per backlog publish (RAM buffer size)
+
+// ---- Scheduler (loop() task periods) ----
+constexpr uint32_t kButtonPollIntervalMs = 25;    // Gesture timing uses ISR timestamps
+constexpr uint32_t kNetworkPollIntervalMs = 20;   // Drain inbound RPC / attributes
+constexpr uint32_t kControllerIntervalMs = 50;    // Light relay re-evaluation
+constexpr uint32_t kDhtPollIntervalMs = 10;       // Collect async DHT22 result (~5 ms transaction)
+constexpr uint32_t kLuxPollIntervalMs = 20;       // Advance BH1750 one-shot pipeline
+constexpr uint32_t kAdcDrainIntervalMs = 50;      // Drain DMA ADC blocks (buffer holds ~100 ms)
+constexpr uint32_t kConfigPersistPollMs = 500;    // Check for due config NVS writes
+constexpr uint32_t kSchedulerMaxSleepMs = 100;    // Upper bound for one idle sleep
+
+// ---- Continuous ADC (DMA) for analog sensors ----
+constexpr uint32_t kAdcSampleRateHz = 20000;       // ESP32 digital controller minimum
+constexpr uint32_t kAdcSamplesPerValue = 2000;     // Per channel; 1 pin => 10 values/s
+
+// ---- Network task (WiFi + MQTT, pinned away from the Arduino loop core) ----
+constexpr uint8_t kNetworkTaskCore = 0;
+constexpr uint32_t kNetworkTaskStackBytes = 8192;
+constexpr uint8_t kNetworkTaskPriority = 2;
+constexpr uint32_t kNetworkTaskPollIntervalMs = 10;
+
+// ---- ThingsBoard transport ----
+// MQTT over TLS, verified against tb-cloud-root-ca.pem (embedded at build
+// time). Set kThingsBoardPort in Secrets.h to the TLS port (8883).
+constexpr bool kThingsBoardTls = false;
+
+// ---- Remote config persistence (write-behind NVS blob) ----
+// Attribute changes within this window of the first unsaved one share a
+// single flash write.
+constexpr uint32_t kConfigPersistDelayMs = 5000;
+
+// ---- Logging (util/Log.h; level via -D SG_LOG_LEVEL in platformio.ini) ----
+constexpr bool kLogBinaryOutput = false;   // true: decode with scripts/log_decode.py
+constexpr uint8_t kLogTaskCore = 1;
+constexpr uint32_t kLogTaskStackBytes = 3072;
+constexpr uint8_t kLogTaskPriority = 0;    // Only runs while loop() sleeps
+constexpr uint32_t kLogDrainIntervalMs = 20;
+
+// ---- Shared attribute requests (retried until the response arrives) ----
+constexpr uint32_t kAttrRequestTimeoutMs = 5000;     // No response by then => retry
+constexpr uint32_t kAttrRetryBackoffMinMs = 2000;
+constexpr uint32_t kAttrRetryBackoffMaxMs = 60000;
+constexpr uint8_t kAttrRequestMaxAttempts = 0;       // 0 = keep retrying while connected
+
+// ---- WiFi reconnect (event-driven, exponential backoff with jitter) ----
+constexpr uint32_t kWifiBackoffMinMs = 1000;
+constexpr uint32_t kWifiBackoffMaxMs = 60000;
+constexpr uint32_t kWifiConnectTimeoutMs = 15000;  // No IP by then => retry
+// Directed join to the last good BSSID/channel (cached in RTC memory + NVS)
+constexpr bool kWifiFastJoin = true;
+constexpr uint32_t kWifiDirectedTimeoutMs = 4000;  // Then fall back to a full scan
+constexpr bool kWifiReuseDhcpLease = false;  // Skip DHCP with the cached IP (reserved leases only)
+
+// ---- Performance telemetry (perf_* keys; compiled out with SG_PERF_ENABLED=0) ----
+constexpr uint32_t kPerfReportIntervalMs = 60000;
+constexpr uint8_t kPerfStagesPerMessage = 2;  // Keeps each publish < MQTT buffer
 
 // ---- Pins (change to match your wiring) ----
 constexpr uint8_t kPinDht = 4;
@@ -30,6 +99,8 @@ constexpr uint8_t kPinLightManualButton = 14;
 // ---- I2C for RTC (DS1307) ----
 constexpr uint8_t kPinI2cSda = 21;
 constexpr uint8_t kPinI2cScl = 22;
+// RTC holds local time (set from __DATE__/__TIME__); telemetry "ts" needs UTC.
+constexpr int32_t kRtcUtcOffsetSec = 7 * 3600;  // ICT (UTC+7)
 
 // ---- Relay electrical convention ----
 constexpr bool kRelayActiveLow = false;  // Try Active HIGH if LED doesn't light
@@ -50,4 +121,8 @@ constexpr uint32_t kMinValveOffMs = 60000;  // 1 minute
 constexpr uint32_t kWateringIntervalMs = 60000; // 1 minute (for testing)
 constexpr uint32_t kWateringDurationMs = 30000; // 30 seconds
 
+// ---- Remote light / valve control (self_*_enable shared attributes) ----
+constexpr bool kSelfLightEnableByDefault = true;  // Allow automatic light control
+constexpr bool kSelfValveEnableByDefault = true;  // Only applied once the server sends it
+
 } // namespace config
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Decode binary log frames (util::Log, kLogBinaryOutput) back into text.
+
+Each frame carries the address of its printf-style format string; the
+string itself is read from the firmware ELF, so it must be the exact build
+running on the board. Bytes outside frames (boot ROM output, plain
+Serial.print) are passed through unchanged.
+
+  python scripts/log_decode.py                      # stdin, default ELF
+  python scripts/log_decode.py capture.bin
+  python scripts/log_decode.py --port /dev/ttyUSB0  # needs pyserial
+  pio device monitor --raw | python scripts/log_decode.py
+
+Standard library only (pyserial just for --port).
+"""
+
+import argparse
+import codecs
+import re
+import struct
+import sys
+
+DEFAULT_ELF = ".pio/build/esp32dev/firmware.elf"
+
+FRAME_MARKER = 0xA5
+HEADER_BYTES = 12
+MAX_RECORD_BYTES = 96
+LEVELS = "?EWID"
+
+ARG_INT, ARG_UINT, ARG_FLOAT, ARG_STRING = range(4)
+
+SPEC_RE = re.compile(r"%(%|[-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t|L)?([diouxXcfeEgGaAsp])?")
+
+
+class ElfStrings:
+    """Reads NUL-terminated strings by virtual address from an ELF32 file."""
+
+    SHF_ALLOC = 0x2
+    SHT_NOBITS = 8
+
+    def __init__(self, path):
+        with open(path, "rb") as handle:
+            self._data = handle.read()
+        if self._data[:4] != b"\x7fELF" or self._data[4] != 1:
+            raise ValueError("%s is not an ELF32 file" % path)
+
+        shoff, = struct.unpack_from("<I", self._data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self._data, 0x2E)
+        self._sections = []
+        for index in range(shnum):
+            base = shoff + index * shentsize
+            _, sh_type, flags, addr, offset, size = struct.unpack_from("<IIIIII", self._data, base)
+            if flags & self.SHF_ALLOC and sh_type != self.SHT_NOBITS and size > 0:
+                self._sections.append((addr, size, offset))
+        self._cache = {}
+
+    def string_at(self, address):
+        if address in self._cache:
+            return self._cache[address]
+        text = None
+        for addr, size, offset in self._sections:
+            if addr <= address < addr + size:
+                start = offset + (address - addr)
+                end = self._data.find(b"\0", start, offset + size)
+                if end >= 0:
+                    text = self._data[start:end].decode("utf-8", errors="replace")
+                break
+        self._cache[address] = text
+        return text
+
+
+def parse_args(record):
+    argc = record[1] >> 4
+    types = record[2]
+    offset = HEADER_BYTES
+    args = []
+    for index in range(argc):
+        kind = (types >> (2 * index)) & 0x03
+        if kind == ARG_STRING:
+            length = record[offset]
+            args.append((kind, record[offset + 1:offset + 1 + length].decode("utf-8", errors="replace")))
+            offset += 1 + length
+        else:
+            word, = struct.unpack_from("<I", record, offset)
+            offset += 4
+            if kind == ARG_INT:
+                value = word - (1 << 32) if word & 0x80000000 else word
+            elif kind == ARG_FLOAT:
+                value, = struct.unpack("<f", struct.pack("<I", word))
+            else:
+                value = word
+            args.append((kind, value))
+    return args
+
+
+def format_message(fmt, args):
+    remaining = list(args)
+
+    def convert(match):
+        flags, conv = match.group(1), match.group(2)
+        if flags == "%":
+            return "%"
+        if conv is None or not remaining:
+            return match.group(0)
+        kind, value = remaining.pop(0)
+        if conv == "s":
+            return ("%" + flags + "s") % (value,)
+        if kind == ARG_STRING:
+            return str(value)
+        if conv in "di":
+            return ("%" + flags + "d") % int(value)
+        if conv in "uoxX":
+            return ("%" + flags + ("d" if conv == "u" else conv)) % (int(value) & 0xFFFFFFFF)
+        if conv == "c":
+            return chr(int(value) & 0xFF)
+        if conv == "p":
+            return "0x%08x" % (int(value) & 0xFFFFFFFF)
+        return ("%" + flags + conv) % float(value)
+
+    return SPEC_RE.sub(convert, fmt)
+
+
+def decode_record(record, strings):
+    """Returns the text line, or None if this does not look like a record."""
+    level = record[1] & 0x07
+    argc = record[1] >> 4
+    if not 1 <= level <= 4 or argc > 4 or record[3] != 0:
+        return None
+    millis, address = struct.unpack_from("<II", record, 4)
+    try:
+        args = parse_args(record)
+    except (IndexError, struct.error):
+        return None
+
+    if address == 0:
+        message = "%d log records dropped" % (args[0][1] if args else 0)
+    else:
+        fmt = strings.string_at(address)
+        if fmt is None:
+            return None
+        message = format_message(fmt, args)
+    core = (record[1] >> 3) & 0x01
+    return "[%d] %s/%d: %s" % (millis, LEVELS[level], core, message)
+
+
+def decode_stream(chunks, strings, out):
+    buffer = bytearray()
+    text = bytearray()
+    # Text may split a UTF-8 sequence across chunks.
+    utf8 = codecs.getincrementaldecoder("utf-8")(errors="replace")
+
+    def flush_text(final=False):
+        if text or final:
+            out.write(utf8.decode(bytes(text), final=final))
+            text.clear()
+
+    for chunk in chunks:
+        buffer.extend(chunk)
+        index = 0
+        while index < len(buffer):
+            byte = buffer[index]
+            if byte != FRAME_MARKER:
+                text.append(byte)
+                index += 1
+                continue
+            if index + 2 > len(buffer):
+                break  # Need the length byte
+            length = buffer[index + 1]
+            if not HEADER_BYTES <= length <= MAX_RECORD_BYTES:
+                text.append(byte)
+                index += 1
+                continue
+            if index + 1 + length + 1 > len(buffer):
+                break  # Wait for the rest of the frame
+            record = bytes(buffer[index + 1:index + 1 + length])
+            checksum = buffer[index + 1 + length]
+            line = decode_record(record, strings) if sum(record) & 0xFF == checksum else None
+            if line is None:
+                text.append(byte)  # 0xA5 inside text (e.g. UTF-8)
+                index += 1
+                continue
+            flush_text()
+            out.write(line + "\n")
+            index += 1 + length + 1
+        del buffer[:index]
+        flush_text()
+        out.flush()
+    text.extend(buffer)
+    flush_text(final=True)
+
+
+def read_chunks(args):
+    if args.port:
+        import serial  # pyserial
+
+        with serial.Serial(args.port, args.baud, timeout=0.1) as port:
+            while True:
+                chunk = port.read(4096)
+                if chunk:
+                    yield chunk
+    else:
+        source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+        with source:
+            while True:
+                chunk = source.read1(4096) if hasattr(source, "read1") else source.read(4096)
+                if not chunk:
+                    return
+                yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-", help="capture file, or - for stdin")
+    parser.add_argument("--elf", default=DEFAULT_ELF, help="firmware ELF (default: %(default)s)")
+    parser.add_argument("--port", help="read from a serial port instead (pyserial)")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    strings = ElfStrings(args.elf)
+    try:
+        decode_stream(read_chunks(args), strings, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -1,12 +1,24 @@
 #include "app/RemoteConfigManager.h"
 
-#include <Preferences.h>
+#include "util/Crc32.h"
 
 namespace app {
 
 namespace {
 
 static const char* kPrefsNamespace = "sg_cfg";
+static const char* kPrefsBlobKey = "cfg";
+constexpr uint32_t kStoredConfigMagic = 0x53474332;  // "SGC2"
+
+// Linear scan: ten short keys, most rejected on the first character.
+const ConfigField* findConfigField(const char* key) {
+  for (const ConfigField& field : kConfigFields) {
+    if (field.key[0] == key[0] && strcmp(field.key, key) == 0) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
 
 }  // namespace
 
@@ -18,19 +30,42 @@ RemoteConfigManager::RemoteConfigManager(
     : config_(runtimeConfig), settings_(settings), light_(light), watering_(watering) {}
 
 void RemoteConfigManager::begin() {
+  for (const ConfigField& field : kConfigFields) {
+    setDefault_(field);
+  }
+
   // Load last known config (if any). If not present, runtime config stays at defaults.
-  loadFromNvs_();
+  if (!loadFromNvs_()) {
+    for (size_t i = 0; i < kConfigFieldCount; ++i) {
+      stored_[i] = encode_(kConfigFields[i]);
+    }
+  }
   applyToControllers_();
 
   // Keep Settings in sync with runtime config defaults.
   settings_.setTempLimitEnabled(config_.tempLightEnabled);
   settings_.setTempTooColdC(config_.tempTooColdC);
   settings_.setSelfLightEnable(config_.selfLightEnable);
+  // self_valve_enable is not applied here: the valve stays closed until the
+  // server sends it (see applyAttributes()).
 }
 
 const char* RemoteConfigManager::sharedKeysCsv() {
-  // Keep this stable so dashboards / attributes are easy to manage.
-  return "telemetryIntervalMs,sensorReadIntervalMs,tempLightEnabled,tempTooColdC,minValveOnMs,minValveOffMs,self_light_enable,self_valve_enable";
+  // Keep the schema order stable so dashboards / attributes are easy to manage.
+  static char csv[configKeysCsvLength() + 1] = {0};
+  if (csv[0] == '\0') {
+    size_t pos = 0;
+    for (size_t i = 0; i < kConfigFieldCount; ++i) {
+      if (i > 0) {
+        csv[pos++] = ',';
+      }
+      const size_t length = strlen(kConfigFields[i].key);
+      memcpy(csv + pos, kConfigFields[i].key, length);
+      pos += length;
+    }
+    csv[pos] = '\0';
+  }
+  return csv;
 }
 
 bool RemoteConfigManager::applyAttributes(JsonVariantConst root) {
@@ -47,18 +82,15 @@ bool RemoteConfigManager::applyAttributes(JsonVariantConst root) {
   // - {"client":{...}}        (client-side attributes)
   // - {"key":value,...}       (direct update notification)
   // ===================================================
-
-  // TB attribute payload can be:
-  // - {"shared":{...}}
-  // - {"client":{...}}
-  // - or directly {"key":value,...} for update messages
   JsonVariantConst obj = root;
   if (root.is<JsonObjectConst>()) {
     const JsonObjectConst rootObj = root.as<JsonObjectConst>();
-    if (rootObj.containsKey("shared")) {
-      obj = rootObj["shared"];
-    } else if (rootObj.containsKey("client")) {
-      obj = rootObj["client"];
+    JsonVariantConst nested = rootObj["shared"];
+    if (nested.isNull()) {
+      nested = rootObj["client"];
+    }
+    if (!nested.isNull()) {
+      obj = nested;
     }
   }
 
@@ -66,54 +98,25 @@ bool RemoteConfigManager::applyAttributes(JsonVariantConst root) {
     return false;
   }
 
-  const JsonObjectConst cfg = obj.as<JsonObjectConst>();
-
-  maybeSetU32_(cfg, "telemetryIntervalMs", config_.telemetryIntervalMs);
-  maybeSetU32_(cfg, "sensorReadIntervalMs", config_.sensorReadIntervalMs);
-
-  maybeSetBool_(cfg, "tempLightEnabled", config_.tempLightEnabled);
-  maybeSetFloat_(cfg, "tempTooColdC", config_.tempTooColdC);
-
-  maybeSetU32_(cfg, "minValveOnMs", config_.minValveOnMs);
-  maybeSetU32_(cfg, "minValveOffMs", config_.minValveOffMs);
-
-  // ⚠️ CRITICAL: self_light_enable từ ThingsBoard Rule Chain
-  // Server tự động set attribute này dựa trên nhiệt độ
-  Serial.print("🔍 Checking self_light_enable in attributes... ");
-  if (cfg.containsKey("self_light_enable")) {
-    const bool newVal = cfg["self_light_enable"].as<bool>();
-    Serial.print("Found: ");
-    Serial.print(newVal ? "TRUE" : "FALSE");
-    Serial.print(" (current: ");
-    Serial.print(config_.selfLightEnable ? "TRUE" : "FALSE");
-    Serial.println(")");
-  } else {
-    Serial.println("NOT FOUND in attributes payload!");
-  }
-  maybeSetBool_(cfg, "self_light_enable", config_.selfLightEnable);
-
-  // self_valve_enable: Server controls watering valve
-  Serial.print("🔍 Checking self_valve_enable in attributes... ");
-  if (cfg.containsKey("self_valve_enable")) {
-    const bool newVal = cfg["self_valve_enable"].as<bool>();
-    Serial.print("Found: ");
-    Serial.print(newVal ? "TRUE" : "FALSE");
-    Serial.print(" (current: ");
-    Serial.print(config_.selfValveEnable ? "TRUE" : "FALSE");
-    Serial.println(")");
-  } else {
-    Serial.println("NOT FOUND in attributes payload!");
+  // One pass over the payload; unknown keys are ignored.
+  for (JsonPairConst kv : obj.as<JsonObjectConst>()) {
+    const ConfigField* field = findConfigField(kv.key().c_str());
+    if (field == nullptr) {
+      continue;
+    }
+    if (!applyField_(*field, kv.value())) {
+      Serial.print("Config: ignoring ");
+      Serial.print(field->key);
+      Serial.println(" (wrong type)");
+    } else if (field->offset == offsetof(RuntimeConfig, selfValveEnable)) {
+      valveFromServer_ = true;
+    }
   }
-  maybeSetBool_(cfg, "self_valve_enable", config_.selfValveEnable);
 
-  // Safety clamps (avoid breaking sensors/logic via bad server values)
-  if (config_.sensorReadIntervalMs < 2000) {
-    config_.sensorReadIntervalMs = 2000;
-    changed_ = true;
-  }
-  if (config_.telemetryIntervalMs < 1000) {
-    config_.telemetryIntervalMs = 1000;
-    changed_ = true;
+  // The valve only follows a self_valve_enable the server sent since boot,
+  // never the saved one (its change handler moves the valve).
+  if (valveFromServer_) {
+    settings_.setSelfValveEnable(config_.selfValveEnable);
   }
 
   if (changed_) {
@@ -121,15 +124,16 @@ bool RemoteConfigManager::applyAttributes(JsonVariantConst root) {
 
     settings_.setTempLimitEnabled(config_.tempLightEnabled);
     settings_.setTempTooColdC(config_.tempTooColdC);
-    
+
     // Sync self_light_enable to Settings immediately
     settings_.setSelfLightEnable(config_.selfLightEnable);
-    
-    // Sync self_valve_enable to Settings and WateringController
-    settings_.setSelfValveEnable(config_.selfValveEnable);
-    watering_.setSelfValveEnable(config_.selfValveEnable);
 
-    saveToNvs_();
+    // Write-behind: loop() persists once the oldest change is due.
+    ++stats_.changes;
+    if (!dirty_) {
+      dirty_ = true;
+      dirtySinceMs_ = millis();
+    }
   }
 
   return changed_;
@@ -140,47 +144,152 @@ void RemoteConfigManager::applyToControllers_() {
   // Watering controller now only needs interval/duration, not thresholds
 }
 
-void RemoteConfigManager::maybeSetU32_(JsonVariantConst obj, const char* key, uint32_t& dst) {
-  if (!obj.containsKey(key)) {
-    return;
+bool RemoteConfigManager::applyField_(const ConfigField& field, JsonVariantConst value) {
+  uint32_t word = 0;
+  switch (field.type) {
+    case ConfigType::U32: {
+      if (!value.is<double>()) {
+        return false;
+      }
+      double v = value.as<double>();
+      v = v < field.min ? field.min : (v > field.max ? field.max : v);
+      word = (uint32_t)(v + 0.5);
+      break;
+    }
+    case ConfigType::Bool:
+      // Rule chains sometimes send 0/1.
+      if (value.is<bool>()) {
+        word = value.as<bool>() ? 1 : 0;
+      } else if (value.is<long>()) {
+        word = value.as<long>() != 0 ? 1 : 0;
+      } else {
+        return false;
+      }
+      break;
+    case ConfigType::Float: {
+      if (!value.is<float>()) {
+        return false;
+      }
+      float v = value.as<float>();
+      if (isnan(v)) {
+        return false;
+      }
+      v = v < (float)field.min ? (float)field.min : (v > (float)field.max ? (float)field.max : v);
+      memcpy(&word, &v, sizeof(word));
+      break;
+    }
   }
-  const uint32_t v = obj[key].as<uint32_t>();
-  if (v != dst) {
-    dst = v;
-    changed_ = true;
+
+  if (word == encode_(field)) {
+    return true;
+  }
+  decode_(field, word);
+  changed_ = true;
+
+  Serial.print("Config: ");
+  Serial.print(field.key);
+  Serial.print(" = ");
+  switch (field.type) {
+    case ConfigType::U32:
+      Serial.println(word);
+      break;
+    case ConfigType::Bool:
+      Serial.println(word != 0 ? "TRUE" : "FALSE");
+      break;
+    case ConfigType::Float: {
+      float v;
+      memcpy(&v, &word, sizeof(v));
+      Serial.println(v);
+      break;
+    }
   }
+  return true;
 }
 
-void RemoteConfigManager::maybeSetI32_(JsonVariantConst obj, const char* key, int& dst) {
-  if (!obj.containsKey(key)) {
-    return;
+uint32_t RemoteConfigManager::encode_(const ConfigField& field) const {
+  const uint8_t* base = reinterpret_cast<const uint8_t*>(&config_) + field.offset;
+  uint32_t word = 0;
+  switch (field.type) {
+    case ConfigType::U32:
+      memcpy(&word, base, sizeof(uint32_t));
+      break;
+    case ConfigType::Bool:
+      word = *reinterpret_cast<const bool*>(base) ? 1 : 0;
+      break;
+    case ConfigType::Float:
+      memcpy(&word, base, sizeof(float));
+      break;
   }
-  const int v = obj[key].as<int>();
-  if (v != dst) {
-    dst = v;
-    changed_ = true;
+  return word;
+}
+
+void RemoteConfigManager::decode_(const ConfigField& field, uint32_t word) {
+  uint8_t* base = reinterpret_cast<uint8_t*>(&config_) + field.offset;
+  switch (field.type) {
+    case ConfigType::U32:
+      memcpy(base, &word, sizeof(uint32_t));
+      break;
+    case ConfigType::Bool:
+      *reinterpret_cast<bool*>(base) = word != 0;
+      break;
+    case ConfigType::Float:
+      memcpy(base, &word, sizeof(float));
+      break;
   }
 }
 
-void RemoteConfigManager::maybeSetBool_(JsonVariantConst obj, const char* key, bool& dst) {
-  if (!obj.containsKey(key)) {
-    return;
+void RemoteConfigManager::setDefault_(const ConfigField& field) {
+  uint32_t word = 0;
+  switch (field.type) {
+    case ConfigType::U32:
+      word = (uint32_t)field.def;
+      break;
+    case ConfigType::Bool:
+      word = field.def != 0 ? 1 : 0;
+      break;
+    case ConfigType::Float: {
+      const float v = (float)field.def;
+      memcpy(&word, &v, sizeof(word));
+      break;
+    }
+  }
+  decode_(field, word);
+}
+
+void RemoteConfigManager::setPersistDelay(uint32_t persistDelayMs) {
+  persistDelayMs_ = persistDelayMs;
+}
+
+uint32_t RemoteConfigManager::dirtyFields() const {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kConfigFieldCount; ++i) {
+    if (encode_(kConfigFields[i]) != stored_[i]) {
+      mask |= 1u << i;
+    }
   }
-  const bool v = obj[key].as<bool>();
-  if (v != dst) {
-    dst = v;
-    changed_ = true;
+  return mask;
+}
+
+void RemoteConfigManager::loop(uint32_t nowMs) {
+  if (!dirty_ || (nowMs - dirtySinceMs_) < persistDelayMs_) {
+    return;
   }
+  flush();
 }
 
-void RemoteConfigManager::maybeSetFloat_(JsonVariantConst obj, const char* key, float& dst) {
-  if (!obj.containsKey(key)) {
+void RemoteConfigManager::flush() {
+  if (!dirty_) {
+    return;
+  }
+  dirty_ = false;
+  if (dirtyFields() == 0) {
+    ++stats_.skipped;  // Flapped back to the stored values
     return;
   }
-  const float v = obj[key].as<float>();
-  if (isnan(dst) || fabsf(v - dst) > 0.0001f) {
-    dst = v;
-    changed_ = true;
+  if (!writeBlob_()) {
+    // Try again after another delay.
+    dirty_ = true;
+    dirtySinceMs_ = millis();
   }
 }
 
@@ -190,51 +299,104 @@ bool RemoteConfigManager::loadFromNvs_() {
     return false;
   }
 
-  const bool has = prefs.getBool("has", false);
-  if (!has) {
+  uint32_t blob[kBlobWords];
+  const size_t length = prefs.getBytes(kPrefsBlobKey, blob, sizeof(blob));
+  const bool haveHeader = length >= 3 * sizeof(uint32_t) && blob[0] == kStoredConfigMagic;
+  const uint32_t count = haveHeader ? blob[1] : 0;
+  const bool haveBlob = haveHeader && count >= 1 &&
+                        count <= kConfigFieldCount &&
+                        length == (2 + count + 1) * sizeof(uint32_t) &&
+                        util::crc32(blob, (2 + count) * sizeof(uint32_t)) == blob[2 + count];
+  if (!haveBlob) {
+    const bool haveLegacy = loadLegacyKeys_(prefs);
     prefs.end();
-    return false;
+    if (!haveLegacy) {
+      return false;
+    }
+    // One-time migration to the blob. The old keys are dropped only once
+    // the blob is written; otherwise the next boot migrates again.
+    if (writeBlob_() && prefs.begin(kPrefsNamespace, false)) {
+      prefs.remove("has");
+      for (const ConfigField& field : kConfigFields) {
+        prefs.remove(field.legacyKey);
+      }
+      prefs.end();
+    }
+    return true;
   }
+  prefs.end();
 
-  config_.telemetryIntervalMs = prefs.getUInt("tel_ms", config_.telemetryIntervalMs);
-  config_.sensorReadIntervalMs = prefs.getUInt("sen_ms", config_.sensorReadIntervalMs);
-
-  config_.tempLightEnabled = prefs.getBool("tmp_en", config_.tempLightEnabled);
-  config_.tempTooColdC = prefs.getFloat("tmp_c", config_.tempTooColdC);
-
-  // Soil sensor removed - no longer load thresholds
-  config_.minValveOnMs = prefs.getUInt("v_on", config_.minValveOnMs);
-  config_.minValveOffMs = prefs.getUInt("v_off", config_.minValveOffMs);
+  for (size_t i = 0; i < kConfigFieldCount; ++i) {
+    if (i < count) {
+      decode_(kConfigFields[i], blob[2 + i]);
+    }
+    stored_[i] = encode_(kConfigFields[i]);
+  }
+  // Fields added since the blob was written get saved with the next change.
+  return true;
+}
 
-  config_.selfLightEnable = prefs.getBool("slf_lgt", config_.selfLightEnable);
-  config_.selfValveEnable = prefs.getBool("slf_vlv", config_.selfValveEnable);
+bool RemoteConfigManager::loadLegacyKeys_(Preferences& prefs) {
+  if (!prefs.getBool("has", false)) {
+    return false;
+  }
 
-  prefs.end();
+  for (const ConfigField& field : kConfigFields) {
+    uint8_t* base = reinterpret_cast<uint8_t*>(&config_) + field.offset;
+    switch (field.type) {
+      case ConfigType::U32: {
+        uint32_t* dst = reinterpret_cast<uint32_t*>(base);
+        *dst = prefs.getUInt(field.legacyKey, *dst);
+        break;
+      }
+      case ConfigType::Bool: {
+        bool* dst = reinterpret_cast<bool*>(base);
+        *dst = prefs.getBool(field.legacyKey, *dst);
+        break;
+      }
+      case ConfigType::Float: {
+        float* dst = reinterpret_cast<float*>(base);
+        *dst = prefs.getFloat(field.legacyKey, *dst);
+        break;
+      }
+    }
+  }
   return true;
 }
 
-void RemoteConfigManager::saveToNvs_() {
+// One putBytes(): NVS writes the new entry before erasing the old one, so a
+// reset mid-write leaves either the previous or the new blob, never a mix.
+bool RemoteConfigManager::writeBlob_() {
+  uint32_t blob[kBlobWords];
+  blob[0] = kStoredConfigMagic;
+  blob[1] = kConfigFieldCount;
+  for (size_t i = 0; i < kConfigFieldCount; ++i) {
+    blob[2 + i] = encode_(kConfigFields[i]);
+  }
+  blob[kBlobWords - 1] = util::crc32(blob, (kBlobWords - 1) * sizeof(uint32_t));
+
+  const uint32_t startUs = micros();
   Preferences prefs;
   if (!prefs.begin(kPrefsNamespace, false)) {
-    return;
+    return false;
   }
-
-  prefs.putBool("has", true);
-
-  prefs.putUInt("tel_ms", config_.telemetryIntervalMs);
-  prefs.putUInt("sen_ms", config_.sensorReadIntervalMs);
-
-  prefs.putBool("tmp_en", config_.tempLightEnabled);
-  prefs.putFloat("tmp_c", config_.tempTooColdC);
-
-  // Soil sensor removed - no longer save thresholds
-  prefs.putUInt("v_on", config_.minValveOnMs);
-  prefs.putUInt("v_off", config_.minValveOffMs);
-
-  prefs.putBool("slf_lgt", config_.selfLightEnable);
-  prefs.putBool("slf_vlv", config_.selfValveEnable);
-
+  const bool ok = prefs.putBytes(kPrefsBlobKey, blob, sizeof(blob)) == sizeof(blob);
   prefs.end();
+
+  const uint32_t elapsedUs = micros() - startUs;
+  stats_.lastWriteUs = elapsedUs;
+  if (elapsedUs > stats_.maxWriteUs) {
+    stats_.maxWriteUs = elapsedUs;
+  }
+  if (!ok) {
+    Serial.println("Config NVS write failed");
+    return false;
+  }
+  ++stats_.writes;
+  for (size_t i = 0; i < kConfigFieldCount; ++i) {
+    stored_[i] = blob[2 + i];
+  }
+  return true;
 }
 
 }  // namespace app
@@ -2,46 +2,92 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
 
 #include "app/RuntimeConfig.h"
 #include "app/Settings.h"
+#include "controllers/LightController.h"
 #include "controllers/WateringController.h"
 
 namespace app {
 
+// Applies ThingsBoard shared attributes to RuntimeConfig / Settings, driven
+// by the kConfigFields schema (RuntimeConfig.h), and persists them
+// write-behind: a change only marks fields dirty, and loop()
+// writes one CRC-protected blob once the oldest unsaved change is
+// `persistDelayMs` old. Bursts of updates coalesce into that single write,
+// and nothing is written if the values flapped back to what is stored.
 class RemoteConfigManager {
  public:
+  struct PersistStats {
+    uint32_t changes = 0;     // applyAttributes() calls that changed something
+    uint32_t writes = 0;      // Blob writes (each one NVS entry)
+    uint32_t skipped = 0;     // Pending changes that flapped back: no write
+    uint32_t lastWriteUs = 0;
+    uint32_t maxWriteUs = 0;
+  };
+
   RemoteConfigManager(
       RuntimeConfig& runtimeConfig,
       Settings& settings,
+      controllers::LightController& light,
       controllers::WateringController& watering);
 
   void begin();
 
+  // Write-behind delay (0 = write on the next loop()).
+  void setPersistDelay(uint32_t persistDelayMs);
+  // Writes the pending changes once they are due.
+  void loop(uint32_t nowMs);
+  // Writes pending changes now (e.g. before a planned restart).
+  void flush();
+
+  // Fields changed since the last write (bit i = kConfigFields[i]).
+  uint32_t dirtyFields() const;
+  const PersistStats& persistStats() const { return stats_; }
+
   // Apply attributes payload from ThingsBoard (response or update).
-  // Returns true if any setting was changed.
+  // Returns true if any setting was changed. Changed settings reach the
+  // relays before this returns (see Settings::setChangeHandler).
   bool applyAttributes(JsonVariantConst root);
 
-  // Create a comma-separated list of shared-attribute keys to request.
+  // Comma-separated shared-attribute keys to request (built from the
+  // schema on first use).
   static const char* sharedKeysCsv();
 
  private:
   RuntimeConfig& config_;
   Settings& settings_;
+  controllers::LightController& light_;
   controllers::WateringController& watering_;
 
+  // NVS blob, as 32-bit words: magic, field count, one value per schema
+  // row, CRC over everything before it. A blob with fewer fields (older
+  // firmware) still loads; the newer fields keep their defaults.
+  static constexpr size_t kBlobWords = 2 + kConfigFieldCount + 1;
+
   bool loadFromNvs_();
-  void saveToNvs_();
+  bool loadLegacyKeys_(Preferences& prefs);
+  bool writeBlob_();
+
+  // Field value as a blob word (u32 as is, bool 0/1, float bit pattern).
+  uint32_t encode_(const ConfigField& field) const;
+  void decode_(const ConfigField& field, uint32_t word);
+  // Sets the field to the schema default.
+  void setDefault_(const ConfigField& field);
+  // Validates and clamps `value`; false if its type does not match.
+  bool applyField_(const ConfigField& field, JsonVariantConst value);
 
   bool changed_ = false;
+  bool valveFromServer_ = false;  // self_valve_enable received since boot
 
-  void applyToControllers_();
+  uint32_t stored_[kConfigFieldCount] = {};  // Encoded values NVS holds
+  bool dirty_ = false;
+  uint32_t dirtySinceMs_ = 0;
+  uint32_t persistDelayMs_ = 5000;
+  PersistStats stats_;
 
-  // Helpers
-  void maybeSetU32_(JsonVariantConst obj, const char* key, uint32_t& dst);
-  void maybeSetI32_(JsonVariantConst obj, const char* key, int& dst);
-  void maybeSetBool_(JsonVariantConst obj, const char* key, bool& dst);
-  void maybeSetFloat_(JsonVariantConst obj, const char* key, float& dst);
+  void applyToControllers_();
 };
 
 }  // namespace app
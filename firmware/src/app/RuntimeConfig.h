@@ -2,28 +2,81 @@
 
 #include <Arduino.h>
 
+#include <stddef.h>
+
+#include "Config.h"
+
 namespace app {
 
 // Runtime-configurable parameters.
-// Defaults come from include/Config.h; values may be overridden from
+// Defaults are the kConfigFields `def` column (from include/Config.h),
+// set by RemoteConfigManager::begin(); values may be overridden from
 // ThingsBoard.
 struct RuntimeConfig {
-  uint32_t telemetryIntervalMs = 10000;
-  uint32_t sensorReadIntervalMs = 2000;
+  uint32_t telemetryIntervalMs;
+  uint32_t telemetryBatchSize;
+  uint32_t telemetryMaxLatencyMs;
+  uint32_t sensorReadIntervalMs;
 
   // Temperature-light feature
-  bool tempLightEnabled = false;
-  float tempTooColdC = 18.0f;
+  bool tempLightEnabled;
+  float tempTooColdC;
 
   // Watering (timer-based, no soil sensor)
-  uint32_t minValveOnMs = 30000;
-  uint32_t minValveOffMs = 3600000;
+  uint32_t minValveOnMs;
+  uint32_t minValveOffMs;
 
   // Remote light control from ThingsBoard
-  bool selfLightEnable = true; // Default: allow automatic light control
+  bool selfLightEnable;
 
   // Remote valve control
-  bool selfValveEnable = true; // Default: allow automatic watering
+  bool selfValveEnable;
+};
+
+// ---- Schema ----
+// One row per remotely configurable field. RemoteConfigManager derives the
+// attribute parsing, clamping, NVS storage and sharedKeysCsv() from it, so
+// adding a setting is a RuntimeConfig member plus one row here.
+//
+// The row index is the field's slot in the NVS blob: append new rows at
+// the end, never reorder or remove.
+enum class ConfigType : uint8_t { U32, Bool, Float };
+
+struct ConfigField {
+  const char* key;        // Shared attribute name
+  const char* legacyKey;  // Per-key NVS name before the blob (migration only)
+  ConfigType type;
+  size_t offset;          // In RuntimeConfig
+  double def;             // Default (bool: 0/1)
+  double min;             // Clamp (U32 / Float)
+  double max;
 };
 
+constexpr ConfigField kConfigFields[] = {
+    {"telemetryIntervalMs", "tel_ms", ConfigType::U32, offsetof(RuntimeConfig, telemetryIntervalMs), config::kTelemetryIntervalMs, 1000, 86400000},
+    {"telemetryBatchSize", "tel_bat", ConfigType::U32, offsetof(RuntimeConfig, telemetryBatchSize), config::kTelemetryBatchSize, 1, 1000},
+    {"telemetryMaxLatencyMs", "tel_lat", ConfigType::U32, offsetof(RuntimeConfig, telemetryMaxLatencyMs), config::kTelemetryMaxLatencyMs, 0, 86400000},
+    {"sensorReadIntervalMs", "sen_ms", ConfigType::U32, offsetof(RuntimeConfig, sensorReadIntervalMs), config::kSensorReadIntervalMs, 2000, 3600000},
+    {"tempLightEnabled", "tmp_en", ConfigType::Bool, offsetof(RuntimeConfig, tempLightEnabled), config::kTempLightEnabledByDefault, 0, 1},
+    {"tempTooColdC", "tmp_c", ConfigType::Float, offsetof(RuntimeConfig, tempTooColdC), config::kTempTooColdCDefault, -40, 60},
+    {"minValveOnMs", "v_on", ConfigType::U32, offsetof(RuntimeConfig, minValveOnMs), config::kMinValveOnMs, 0, 86400000},
+    {"minValveOffMs", "v_off", ConfigType::U32, offsetof(RuntimeConfig, minValveOffMs), config::kMinValveOffMs, 0, 86400000},
+    {"self_light_enable", "slf_lgt", ConfigType::Bool, offsetof(RuntimeConfig, selfLightEnable), config::kSelfLightEnableByDefault, 0, 1},
+    {"self_valve_enable", "slf_vlv", ConfigType::Bool, offsetof(RuntimeConfig, selfValveEnable), config::kSelfValveEnableByDefault, 0, 1},
+};
+
+constexpr size_t kConfigFieldCount = sizeof(kConfigFields) / sizeof(kConfigFields[0]);
+static_assert(kConfigFieldCount <= 32, "dirty bits are a uint32_t");
+
+constexpr size_t configKeyLength(const char* key) {
+  return *key ? 1 + configKeyLength(key + 1) : 0;
+}
+
+// Length of "key1,key2,..." (without the terminator).
+constexpr size_t configKeysCsvLength(size_t i = 0) {
+  return i >= kConfigFieldCount
+             ? 0
+             : configKeyLength(kConfigFields[i].key) + (i > 0 ? 1 : 0) + configKeysCsvLength(i + 1);
+}
+
 } // namespace app
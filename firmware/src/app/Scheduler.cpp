@@ -0,0 +1,162 @@
+#include "app/Scheduler.h"
+
+namespace app {
+
+namespace {
+
+const Scheduler::TaskStats kEmptyStats;
+
+}  // namespace
+
+void Scheduler::begin(uint32_t nowMs) {
+  resetStats(nowMs);
+}
+
+void Scheduler::setClock(NowFn now, SleepFn sleep) {
+  now_ = now != nullptr ? now : arduinoNow_;
+  sleep_ = sleep != nullptr ? sleep : arduinoSleep_;
+}
+
+Scheduler::TaskId Scheduler::addTask(const char* name, TaskFn fn, uint32_t periodMs,
+                                     uint8_t priority, uint32_t firstDelayMs) {
+  if (fn == nullptr || taskCount_ >= kMaxTasks) {
+    return kInvalidTask;
+  }
+
+  Task& task = tasks_[taskCount_];
+  task.name = name;
+  task.fn = fn;
+  task.periodMs = periodMs > 0 ? periodMs : 1;
+  task.dueMs = now_() + firstDelayMs;
+  task.priority = priority;
+  return taskCount_++;
+}
+
+void Scheduler::setPeriod(TaskId id, uint32_t periodMs) {
+  if (id >= taskCount_ || periodMs == 0) {
+    return;
+  }
+  Task& task = tasks_[id];
+  // Re-anchor the pending deadline so a shorter period takes effect now
+  // rather than after the old (possibly long) period has elapsed.
+  task.dueMs = task.dueMs - task.periodMs + periodMs;
+  task.periodMs = periodMs;
+}
+
+void Scheduler::trigger(TaskId id, uint32_t nowMs) {
+  if (id >= taskCount_) {
+    return;
+  }
+  tasks_[id].dueMs = nowMs;
+}
+
+bool Scheduler::isDue_(const Task& task, uint32_t nowMs) {
+  // Signed difference keeps this correct across millis() wrap-around.
+  return (int32_t)(nowMs - task.dueMs) >= 0;
+}
+
+void Scheduler::runDue(uint32_t nowMs) {
+  ++passId_;
+
+  while (true) {
+    Task* next = nullptr;
+    for (uint8_t i = 0; i < taskCount_; ++i) {
+      Task& task = tasks_[i];
+      if (task.lastPassId == passId_ || !isDue_(task, nowMs)) {
+        continue;
+      }
+      if (next == nullptr || task.priority > next->priority) {
+        next = &task;
+      }
+    }
+    if (next == nullptr) {
+      return;
+    }
+
+    const uint32_t startMs = now_();
+    const uint32_t latenessMs = startMs - next->dueMs;
+    next->lastPassId = passId_;
+
+    next->fn(startMs);
+
+    const uint32_t runMs = now_() - startMs;
+    TaskStats& st = next->stats;
+    ++st.runs;
+    st.totalLatenessMs += latenessMs;
+    if (latenessMs > st.maxLatenessMs) {
+      st.maxLatenessMs = latenessMs;
+    }
+    if (runMs > st.maxRunMs) {
+      st.maxRunMs = runMs;
+    }
+
+    next->dueMs += next->periodMs;
+    if (isDue_(*next, startMs)) {
+      // Fell behind by more than a period: skip the missed runs.
+      next->dueMs = startMs + next->periodMs;
+    }
+  }
+}
+
+uint32_t Scheduler::msUntilNextDeadline(uint32_t nowMs) const {
+  if (taskCount_ == 0) {
+    return UINT32_MAX;
+  }
+
+  uint32_t best = UINT32_MAX;
+  for (uint8_t i = 0; i < taskCount_; ++i) {
+    const Task& task = tasks_[i];
+    if (isDue_(task, nowMs)) {
+      return 0;
+    }
+    const uint32_t waitMs = task.dueMs - nowMs;
+    if (waitMs < best) {
+      best = waitMs;
+    }
+  }
+  return best;
+}
+
+void Scheduler::sleepUntilNextDeadline(uint32_t maxSleepMs) {
+  const uint32_t nowMs = now_();
+  stats_.elapsedMs = nowMs - statsStartMs_;
+
+  uint32_t sleepMs = msUntilNextDeadline(nowMs);
+  if (sleepMs > maxSleepMs) {
+    sleepMs = maxSleepMs;
+  }
+  if (sleepMs == 0) {
+    return;
+  }
+
+  // delay() maps to vTaskDelay on ESP32, so the idle task (and WiFi modem
+  // sleep) gets the CPU instead of loop() spinning on millis().
+  sleep_(sleepMs);
+  const uint32_t wokeMs = now_();
+  stats_.sleptMs += wokeMs - nowMs;
+  stats_.elapsedMs = wokeMs - statsStartMs_;
+}
+
+const Scheduler::TaskStats& Scheduler::taskStats(TaskId id) const {
+  if (id >= taskCount_) {
+    return kEmptyStats;
+  }
+  return tasks_[id].stats;
+}
+
+const char* Scheduler::taskName(TaskId id) const {
+  if (id >= taskCount_) {
+    return "";
+  }
+  return tasks_[id].name;
+}
+
+void Scheduler::resetStats(uint32_t nowMs) {
+  statsStartMs_ = nowMs;
+  stats_ = Stats();
+  for (uint8_t i = 0; i < taskCount_; ++i) {
+    tasks_[i].stats = TaskStats();
+  }
+}
+
+}  // namespace app
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace app {
+
+// Cooperative task scheduler for loop().
+//
+// Each task has a period, a next deadline and a priority. runDue() runs every
+// task whose deadline has passed (highest priority first, each at most once
+// per pass) and sleepUntilNextDeadline() yields the CPU to FreeRTOS until the
+// earliest deadline instead of spinning.
+//
+// Deadlines advance at a fixed rate (dueMs += periodMs) so periods do not
+// drift with task run time; if a task falls more than one period behind, the
+// missed runs are skipped instead of being replayed in a burst.
+class Scheduler {
+ public:
+  using TaskFn = void (*)(uint32_t nowMs);
+  using TaskId = uint8_t;
+  // Time source and sleep; millis() / delay() unless replaced (host tests
+  // run a simulated clock).
+  using NowFn = uint32_t (*)();
+  using SleepFn = void (*)(uint32_t ms);
+
+  static constexpr TaskId kInvalidTask = 0xFF;
+  static constexpr uint8_t kMaxTasks = 12;
+
+  struct TaskStats {
+    uint32_t runs = 0;
+    uint32_t maxLatenessMs = 0;    // Worst start jitter vs. deadline
+    uint32_t totalLatenessMs = 0;  // Sum, for average jitter
+    uint32_t maxRunMs = 0;         // Longest single run
+  };
+
+  struct Stats {
+    uint32_t elapsedMs = 0;  // Wall time since begin()/resetStats()
+    uint32_t sleptMs = 0;    // Time handed back to the RTOS
+    uint32_t idlePct() const {
+      return elapsedMs == 0 ? 0 : (uint32_t)((uint64_t)sleptMs * 100 / elapsedMs);
+    }
+  };
+
+  void begin(uint32_t nowMs);
+
+  void setClock(NowFn now, SleepFn sleep);
+
+  // Higher priority runs first when several tasks are due on the same pass.
+  // firstDelayMs = 0 makes the task due immediately.
+  TaskId addTask(const char* name, TaskFn fn, uint32_t periodMs, uint8_t priority,
+                 uint32_t firstDelayMs = 0);
+
+  // New period applies from the task's next run.
+  void setPeriod(TaskId id, uint32_t periodMs);
+
+  // Make a task due now (e.g. after an external event).
+  void trigger(TaskId id, uint32_t nowMs);
+
+  void runDue(uint32_t nowMs);
+
+  // 0 if something is already due.
+  uint32_t msUntilNextDeadline(uint32_t nowMs) const;
+
+  // Sleep (vTaskDelay via delay()) until the next deadline, capped at maxSleepMs.
+  void sleepUntilNextDeadline(uint32_t maxSleepMs);
+
+  const Stats& stats() const { return stats_; }
+  const TaskStats& taskStats(TaskId id) const;
+  const char* taskName(TaskId id) const;
+  uint8_t taskCount() const { return taskCount_; }
+  void resetStats(uint32_t nowMs);
+
+ private:
+  struct Task {
+    const char* name = nullptr;
+    TaskFn fn = nullptr;
+    uint32_t periodMs = 0;
+    uint32_t dueMs = 0;
+    uint8_t priority = 0;
+    uint32_t lastPassId = 0;
+    TaskStats stats;
+  };
+
+  Task tasks_[kMaxTasks];
+  uint8_t taskCount_ = 0;
+  uint32_t passId_ = 0;
+
+  uint32_t statsStartMs_ = 0;
+  Stats stats_;
+
+  NowFn now_ = arduinoNow_;
+  SleepFn sleep_ = arduinoSleep_;
+
+  static bool isDue_(const Task& task, uint32_t nowMs);
+  static uint32_t arduinoNow_() { return millis(); }
+  static void arduinoSleep_(uint32_t ms) { delay(ms); }
+};
+
+}  // namespace app
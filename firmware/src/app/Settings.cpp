@@ -2,12 +2,27 @@
 
 namespace app {
 
+void Settings::setChangeHandler(ChangeHandler handler) {
+  changeHandler_ = handler;
+}
+
+void Settings::notify_(Change change) {
+  if (changeHandler_ != nullptr) {
+    changeHandler_(change);
+  }
+}
+
 void Settings::toggleManualOff() {
   manualOff_ = !manualOff_;
+  notify_(Change::Light);
 }
 
 void Settings::setManualOff(bool manualOff) {
+  if (manualOff_ == manualOff) {
+    return;
+  }
   manualOff_ = manualOff;
+  notify_(Change::Light);
 }
 
 bool Settings::manualOff() const {
@@ -15,8 +30,12 @@ bool Settings::manualOff() const {
 }
 
 void Settings::setRemoteLightOverride(bool enabled, bool lightOn) {
+  if (remoteOverrideEnabled_ == enabled && remoteLightOn_ == lightOn) {
+    return;
+  }
   remoteOverrideEnabled_ = enabled;
   remoteLightOn_ = lightOn;
+  notify_(Change::Light);
 }
 
 bool Settings::remoteOverrideEnabled() const {
@@ -28,7 +47,11 @@ bool Settings::remoteLightOn() const {
 }
 
 void Settings::setTempLimitEnabled(bool enabled) {
+  if (tempLimitEnabled_ == enabled) {
+    return;
+  }
   tempLimitEnabled_ = enabled;
+  notify_(Change::Light);
 }
 
 bool Settings::tempLimitEnabled() const {
@@ -36,7 +59,12 @@ bool Settings::tempLimitEnabled() const {
 }
 
 void Settings::setTempTooColdC(float tempC) {
+  // NaN != NaN: without the isnan() check every repeated NaN would notify.
+  if (tempTooColdC_ == tempC || (isnan(tempTooColdC_) && isnan(tempC))) {
+    return;
+  }
   tempTooColdC_ = tempC;
+  notify_(Change::Light);
 }
 
 float Settings::tempTooColdC() const {
@@ -44,7 +72,11 @@ float Settings::tempTooColdC() const {
 }
 
 void Settings::setSelfLightEnable(bool enable) {
+  if (selfLightEnable_ == enable) {
+    return;
+  }
   selfLightEnable_ = enable;
+  notify_(Change::Light);
 }
 
 bool Settings::selfLightEnable() const {
@@ -52,7 +84,11 @@ bool Settings::selfLightEnable() const {
 }
 
 void Settings::setSelfValveEnable(bool enable) {
+  if (selfValveEnable_ == enable) {
+    return;
+  }
   selfValveEnable_ = enable;
+  notify_(Change::Valve);
 }
 
 bool Settings::selfValveEnable() const {
@@ -6,6 +6,14 @@ namespace app {
 
 class Settings {
  public:
+  // Which actuator a change affects. Setters notify only when the value
+  // actually changes, so the handler can re-evaluate that controller right
+  // away instead of waiting for its next periodic update.
+  enum class Change : uint8_t { Light, Valve };
+  using ChangeHandler = void (*)(Change change);
+
+  void setChangeHandler(ChangeHandler handler);
+
   // Manual OFF latch (local button). When latched, light stays off.
   void toggleManualOff();
   void setManualOff(bool manualOff);
@@ -42,6 +50,10 @@ class Settings {
 
   bool selfLightEnable_ = true;  // Default: enabled
   bool selfValveEnable_ = false; // Default: disabled (Server controls)
+
+  ChangeHandler changeHandler_ = nullptr;
+
+  void notify_(Change change);
 };
 
 }  // namespace app
@@ -3,18 +3,146 @@
 namespace app {
 
 void Telemetry::updateSensors(
-    const sensors::DhtReading& dht,
-    bool motionDetected,
     int mq135Raw,
+    uint32_t mq135MilliVolts,
     float lightLux) {
-  dht_ = dht;
-  motionDetected_ = motionDetected;
   mq135Raw_ = mq135Raw;
+  mq135MilliVolts_ = mq135MilliVolts;
   lightLux_ = lightLux;
 }
 
-String Telemetry::buildTelemetryJson(const controllers::LightState& light, const controllers::WateringState& watering, bool selfLightEnable, bool selfValveEnable) const {
-  JsonDocument doc;
+void Telemetry::updateDht(const sensors::DhtReading& dht) {
+  dht_ = dht;
+}
+
+void Telemetry::updateMotion(const sensors::MotionWindow& motion) {
+  motion_ = motion;
+}
+
+void Telemetry::setBatching(uint32_t batchSize, uint32_t maxLatencyMs) {
+  if (batchSize < 1) {
+    batchSize = 1;
+  } else if (batchSize > kMaxSamples) {
+    batchSize = kMaxSamples;
+  }
+  batchSize_ = (uint8_t)batchSize;
+  maxLatencyMs_ = maxLatencyMs;
+}
+
+void Telemetry::setEpochAnchor(uint64_t epochMs, uint32_t atMs) {
+  anchorEpochMs_ = epochMs;
+  anchorMillis_ = atMs;
+  hasEpoch_ = true;
+}
+
+void Telemetry::captureSample(uint32_t nowMs, const controllers::LightState& light, const controllers::WateringState& watering, bool selfLightEnable, bool selfValveEnable) {
+  if (count_ == kMaxSamples) {
+    // Full (e.g. offline for a long time): keep the newest samples.
+    head_ = (uint8_t)((head_ + 1) % kMaxSamples);
+    --count_;
+    ++dropped_;
+  }
+
+  Sample& sample = samples_[(head_ + count_) % kMaxSamples];
+  sample.tsMs = hasEpoch_ ? epochMsAt_(nowMs) : 0;
+  sample.takenMs = nowMs;
+  sample.dht = dht_;
+  sample.motion = motion_;
+  sample.mq135Raw = mq135Raw_;
+  sample.mq135MilliVolts = mq135MilliVolts_;
+  sample.lightLux = lightLux_;
+  sample.lightOn = light.lightOn;
+  sample.manualOff = light.manualOff;
+  sample.selfLightEnable = selfLightEnable;
+  sample.valveOn = watering.valveOn;
+  sample.selfValveEnable = selfValveEnable;
+  ++count_;
+}
+
+const Telemetry::Sample& Telemetry::sampleAt_(size_t index) const {
+  return samples_[(head_ + index) % kMaxSamples];
+}
+
+bool Telemetry::flushDue(uint32_t nowMs) const {
+  if (count_ == 0) {
+    return false;
+  }
+  if (sampleAt_(0).tsMs == 0 || count_ >= batchSize_) {
+    return true;
+  }
+  return nowMs - sampleAt_(0).takenMs >= maxLatencyMs_;
+}
+
+size_t Telemetry::writeBatchJson(util::JsonWriter& json, size_t maxSamples) const {
+  if (count_ == 0 || maxSamples == 0) {
+    return 0;
+  }
+
+  if (sampleAt_(0).tsMs == 0) {
+    // No wall clock: plain object, ThingsBoard stamps it on arrival.
+    json.beginObject();
+    writeValues_(json, sampleAt_(0));
+    json.endObject();
+    return json.ok() ? 1 : 0;
+  }
+
+  size_t n = 0;
+  json.beginArray();
+  while (n < count_ && n < maxSamples && sampleAt_(n).tsMs != 0) {
+    writeRecordJson(json, sampleAt_(n));
+    ++n;
+  }
+  json.endArray();
+  return json.ok() ? n : 0;
+}
+
+void Telemetry::writeRecordJson(util::JsonWriter& json, const Sample& sample) {
+  using namespace telemetry_keys;
+
+  json.beginObject();
+  json.addUint64(kTs, sample.tsMs);
+  json.beginObject(kValues);
+  writeValues_(json, sample);
+  json.endObject();
+  json.endObject();
+}
+
+bool Telemetry::popOldest(Sample& out) {
+  if (count_ == 0) {
+    return false;
+  }
+  out = sampleAt_(0);
+  consumeSamples(1);
+  return true;
+}
+
+uint64_t Telemetry::epochMsAt_(uint32_t atMs) const {
+  // Signed offset: also correct if the anchor is refreshed after atMs.
+  const int32_t offsetMs = (int32_t)(atMs - anchorMillis_);
+  return (uint64_t)((int64_t)anchorEpochMs_ + offsetMs);
+}
+
+void Telemetry::consumeSamples(size_t count) {
+  if (count > count_) {
+    count = count_;
+  }
+  head_ = (uint8_t)((head_ + count) % kMaxSamples);
+  count_ = (uint8_t)(count_ - count);
+}
+
+bool Telemetry::writeLatestJson(util::JsonWriter& json) const {
+  if (count_ == 0) {
+    return false;
+  }
+  json.beginObject();
+  writeValues_(json, sampleAt_(count_ - 1));
+  json.endObject();
+  return json.ok();
+}
+
+// Writes the members of one "values" object (caller opens/closes it).
+void Telemetry::writeValues_(util::JsonWriter& json, const Sample& sample) {
+  using namespace telemetry_keys;
 
   // ========== REQUIRED BY THINGSBOARD RULE CHAIN ==========
   // Server's Rule Chain filters on "temperature_c" to trigger automation.
@@ -22,39 +150,43 @@ String Telemetry::buildTelemetryJson(const controllers::LightState& light, const
   // ========================================================
   
   // DHT22 sensor data
-  if (dht_.ok) {
-    doc["temperature_c"] = dht_.temperatureC;  // ⚠️ CRITICAL: Server depends on this key
-    doc["humidity_pct"] = dht_.humidityPct;
+  if (sample.dht.ok) {
+    json.addFloat(kTemperatureC, sample.dht.temperatureC);  // ⚠️ CRITICAL: Server depends on this key
+    json.addFloat(kHumidityPct, sample.dht.humidityPct);
   } else {
-    doc["temperature_c"] = nullptr;
-    doc["humidity_pct"] = nullptr;
+    json.addNull(kTemperatureC);
+    json.addNull(kHumidityPct);
   }
 
-  // Motion sensor (for monitoring/telemetry only, not used in automation)
-  doc["motion"] = motionDetected_;
+  // Motion sensor (for monitoring/telemetry only, not used in automation).
+  // Edge-captured per telemetry window; event offsets are ms from window start.
+  json.addBool(kMotion, sample.motion.motionCount > 0 || sample.motion.activeNow);
+  json.addUint(kMotionCount, sample.motion.motionCount);
+  json.addUint(kOccupancyPct, sample.motion.occupancyPct());
+  if (sample.motion.hasEvent) {
+    json.addUint(kMotionFirstMs, sample.motion.firstEventOffsetMs);
+    json.addUint(kMotionLastMs, sample.motion.lastEventOffsetMs);
+  }
 
   // Air quality (MQ135)
-  doc["air_quality_raw"] = mq135Raw_;
+  json.addInt(kAirQualityRaw, sample.mq135Raw);
+  json.addUint(kAirQualityMv, sample.mq135MilliVolts);
 
   // Light intensity (BH1750)
-  if (lightLux_ >= 0) {
-    doc["light_lux"] = lightLux_;
+  if (sample.lightLux >= 0) {
+    json.addFloat(kLightLux, sample.lightLux);
   } else {
-    doc["light_lux"] = nullptr;
+    json.addNull(kLightLux);
   }
 
   // Light controller state
-  doc["light_on"] = light.lightOn;
-  doc["manual_off"] = light.manualOff;
-  doc["self_light_enable"] = selfLightEnable;
+  json.addBool(kLightOn, sample.lightOn);
+  json.addBool(kManualOff, sample.manualOff);
+  json.addBool(kSelfLightEnable, sample.selfLightEnable);
 
   // Watering controller state
-  doc["valve_on"] = watering.valveOn;
-  doc["self_valve_enable"] = selfValveEnable;
-
-  String out;
-  serializeJson(doc, out);
-  return out;
+  json.addBool(kValveOn, sample.valveOn);
+  json.addBool(kSelfValveEnable, sample.selfValveEnable);
 }
 
 }  // namespace app
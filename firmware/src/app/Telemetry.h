@@ -2,30 +2,157 @@
 
 #include <Arduino.h>
 
-#include <ArduinoJson.h>
-
 #include "controllers/LightController.h"
 #include "controllers/WateringController.h"
 #include "sensors/DhtSensor.h"
+#include "sensors/PirSensor.h"
+#include "util/JsonWriter.h"
 
 namespace app {
 
+// Telemetry keys (shared by the serializer and the compile-time size bound).
+namespace telemetry_keys {
+constexpr char kTemperatureC[] = "temperature_c";  // ⚠️ Rule chain depends on this key
+constexpr char kHumidityPct[] = "humidity_pct";
+constexpr char kMotion[] = "motion";
+constexpr char kMotionCount[] = "motion_count";
+constexpr char kOccupancyPct[] = "occupancy_pct";
+constexpr char kMotionFirstMs[] = "motion_first_ms";
+constexpr char kMotionLastMs[] = "motion_last_ms";
+constexpr char kAirQualityRaw[] = "air_quality_raw";
+constexpr char kAirQualityMv[] = "air_quality_mv";
+constexpr char kLightLux[] = "light_lux";
+constexpr char kLightOn[] = "light_on";
+constexpr char kManualOff[] = "manual_off";
+constexpr char kSelfLightEnable[] = "self_light_enable";
+constexpr char kValveOn[] = "valve_on";
+constexpr char kSelfValveEnable[] = "self_valve_enable";
+
+// Batch record wrapper (ThingsBoard [{"ts":...,"values":{...}}] format).
+constexpr char kTs[] = "ts";
+constexpr char kValues[] = "values";
+}  // namespace telemetry_keys
+
+// Collects sensor values and keeps a ring of timestamped samples.
+//
+// captureSample() snapshots the latest values (plus controller state) stamped
+// with millis() at acquisition time. Samples are flushed as one ThingsBoard
+// batch publish [{"ts":<epoch ms>,"values":{...}},...] once batchSize samples
+// are pending or the oldest is maxLatencyMs old, so per-sample resolution is
+// kept while the number of publishes drops by ~batchSize.
 class Telemetry {
  public:
+  // Ring capacity; samples beyond this (e.g. while offline) overwrite the oldest.
+  static constexpr uint8_t kMaxSamples = 32;
+
+  // One snapshot. Plain data: also stored as-is in the offline flash log.
+  struct Sample {
+    uint64_t tsMs = 0;  // Unix epoch ms; 0 = no wall clock (no RTC anchor)
+    uint32_t takenMs = 0;
+    sensors::DhtReading dht;
+    sensors::MotionWindow motion;
+    int mq135Raw = -1;
+    uint32_t mq135MilliVolts = 0;
+    float lightLux = -1.0f;
+    bool lightOn = false;
+    bool manualOff = false;
+    bool selfLightEnable = false;
+    bool valveOn = false;
+    bool selfValveEnable = false;
+  };
+
   void updateSensors(
-      const sensors::DhtReading& dht,
-      bool motionDetected,
       int mq135Raw,
+      uint32_t mq135MilliVolts,
       float lightLux);
 
-  // Returns a compact JSON object string (fits in PubSubClient buffer).
-  String buildTelemetryJson(const controllers::LightState& light, const controllers::WateringState& watering, bool selfLightEnable, bool selfValveEnable) const;
+  // DHT results arrive asynchronously (see sensors::DhtSensor::poll()).
+  void updateDht(const sensors::DhtReading& dht);
+
+  // Motion summary for the window ending at this telemetry tick.
+  void updateMotion(const sensors::MotionWindow& motion);
+
+  // batchSize is clamped to [1, kMaxSamples].
+  void setBatching(uint32_t batchSize, uint32_t maxLatencyMs);
+
+  // Unix epoch (ms) at millis() == atMs, e.g. from the RTC. Samples captured
+  // without an anchor are flushed one by one without "ts" (server time).
+  void setEpochAnchor(uint64_t epochMs, uint32_t atMs);
+  bool hasEpoch() const { return hasEpoch_; }
+
+  void captureSample(uint32_t nowMs, const controllers::LightState& light, const controllers::WateringState& watering, bool selfLightEnable, bool selfValveEnable);
+
+  size_t pendingSamples() const { return count_; }
+  // Samples overwritten because the ring was full.
+  uint32_t droppedSamples() const { return dropped_; }
+
+  // Removes the oldest pending sample (e.g. to move it to flash while offline).
+  bool popOldest(Sample& out);
+
+  // True when a batch should be published now.
+  bool flushDue(uint32_t nowMs) const;
+
+  // Worst-case size of one "values" object (including a NUL).
+  static constexpr size_t kMaxJsonBytes =
+      2 /* {} */ + 1 /* NUL */ +
+      util::jsonFieldBound(telemetry_keys::kTemperatureC, util::kJsonFloatMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kHumidityPct, util::kJsonFloatMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kMotion, util::kJsonBoolMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kMotionCount, util::kJsonUint32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kOccupancyPct, util::kJsonUint32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kMotionFirstMs, util::kJsonUint32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kMotionLastMs, util::kJsonUint32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kAirQualityRaw, util::kJsonInt32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kAirQualityMv, util::kJsonUint32MaxChars) +
+      util::jsonFieldBound(telemetry_keys::kLightLux, util::kJsonFloatMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kLightOn, util::kJsonBoolMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kManualOff, util::kJsonBoolMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kSelfLightEnable, util::kJsonBoolMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kValveOn, util::kJsonBoolMaxChars) +
+      util::jsonFieldBound(telemetry_keys::kSelfValveEnable, util::kJsonBoolMaxChars);
+
+  // Worst-case size of one {"ts":...,"values":{...}} array element.
+  static constexpr size_t kMaxRecordBytes =
+      2 /* {} */ + 1 /* array comma */ +
+      util::jsonFieldBound(telemetry_keys::kTs, util::kJsonUint64MaxChars) +
+      (sizeof(telemetry_keys::kValues) - 1) + 3 /* "": */ + (kMaxJsonBytes - 1);
+
+  // Writes up to maxSamples of the oldest pending samples through `json` as a
+  // batch array (or, without an epoch anchor, the oldest sample as a plain
+  // object). Returns how many were written, 0 on writer failure. Samples stay
+  // pending until consumeSamples().
+  size_t writeBatchJson(util::JsonWriter& json, size_t maxSamples) const;
+  void consumeSamples(size_t count);
+
+  // Newest sample's values object (for the Serial debug echo).
+  bool writeLatestJson(util::JsonWriter& json) const;
+
+  // One {"ts":...,"values":{...}} batch element (sample.tsMs must be set).
+  static void writeRecordJson(util::JsonWriter& json, const Sample& sample);
 
  private:
+  static void writeValues_(util::JsonWriter& json, const Sample& sample);
+  const Sample& sampleAt_(size_t index) const;  // 0 = oldest pending
+  uint64_t epochMsAt_(uint32_t atMs) const;
+
+  // Latest inputs (copied into each Sample).
   sensors::DhtReading dht_;
-  bool motionDetected_ = false;
+  sensors::MotionWindow motion_;
   int mq135Raw_ = -1;
+  uint32_t mq135MilliVolts_ = 0;
   float lightLux_ = -1.0f;
+
+  Sample samples_[kMaxSamples];
+  uint8_t head_ = 0;  // Oldest pending sample
+  uint8_t count_ = 0;
+  uint32_t dropped_ = 0;
+
+  uint8_t batchSize_ = 1;
+  uint32_t maxLatencyMs_ = 0;
+
+  bool hasEpoch_ = false;
+  uint64_t anchorEpochMs_ = 0;
+  uint32_t anchorMillis_ = 0;
 };
 
 }  // namespace app
@@ -6,30 +6,137 @@ Button::Button(uint8_t pin) : pin_(pin) {}
 
 void Button::begin() {
   pinMode(pin_, INPUT_PULLUP);
-  stableLevel_ = digitalRead(pin_) == HIGH;
-  lastRawLevel_ = stableLevel_;
-  lastChangeMs_ = millis();
+  rawLevel_ = digitalRead(pin_) == HIGH;
+  stableLevel_ = rawLevel_;
+  rawSinceMs_ = millis();
+  isrLevel_ = rawLevel_;
+  isrEdgeMs_ = rawSinceMs_;
+  attachInterruptArg(pin_, onEdge_, this, CHANGE);
 }
 
-bool Button::update(uint32_t nowMs) {
-  const bool rawLevel = digitalRead(pin_) == HIGH;
+void IRAM_ATTR Button::onEdge_(void* arg) {
+  Button* self = static_cast<Button*>(arg);
+  Edge edge;
+  edge.timeMs = millis();
+  edge.level = (uint8_t)digitalRead(self->pin_);
+  self->isrEdgeMs_ = edge.timeMs;
+  self->isrLevel_ = edge.level == HIGH;
+  self->edges_.push(edge);
+}
+
+void Button::update(uint32_t nowMs) {
+  if (edges_.empty() && state_ == State::Idle && rawLevel_ == stableLevel_ &&
+      isrLevel_ == rawLevel_) {
+    return;  // Idle fast path
+  }
+
+  Edge edge;
+  while (edges_.pop(edge)) {
+    onRawLevel_(edge.level == HIGH, edge.timeMs);
+  }
+
+  // Edges were dropped (ring full during a bounce burst): the ring's last
+  // level is stale. Take the ISR's newest level, re-reading if an edge
+  // lands between the two loads.
+  bool liveLevel;
+  uint32_t liveMs;
+  do {
+    liveMs = isrEdgeMs_;
+    liveLevel = isrLevel_;
+  } while (liveMs != isrEdgeMs_);
+  if (edges_.empty()) {
+    onRawLevel_(liveLevel, liveMs);
+  }
 
-  if (rawLevel != lastRawLevel_) {
-    lastRawLevel_ = rawLevel;
-    lastChangeMs_ = nowMs;
+  if (rawLevel_ != stableLevel_ && nowMs - rawSinceMs_ >= kDebounceMs_) {
+    stableLevel_ = rawLevel_;
+    onStableChange_(!stableLevel_, rawSinceMs_);
   }
 
-  if (rawLevel != stableLevel_ && (nowMs - lastChangeMs_) >= kDebounceMs_) {
-    const bool previousStable = stableLevel_;
-    stableLevel_ = rawLevel;
+  checkTimeouts_(nowMs);
+}
 
-    // Detect press edge: HIGH -> LOW
-    if (previousStable == true && stableLevel_ == false) {
-      return true;
-    }
+void Button::onRawLevel_(bool level, uint32_t atMs) {
+  if (level == rawLevel_) {
+    return;
+  }
+  // The previous raw level lasted long enough: it was a real transition.
+  if (rawLevel_ != stableLevel_ && atMs - rawSinceMs_ >= kDebounceMs_) {
+    stableLevel_ = rawLevel_;
+    onStableChange_(!stableLevel_, rawSinceMs_);
   }
+  rawLevel_ = level;
+  rawSinceMs_ = atMs;
+}
+
+void Button::onStableChange_(bool pressed, uint32_t atMs) {
+  switch (state_) {
+    case State::Idle:
+      if (pressed) {
+        state_ = State::Pressed;
+        stateSinceMs_ = atMs;
+      }
+      break;
+
+    case State::Pressed:
+      if (!pressed) {
+        if (atMs - stateSinceMs_ >= kLongPressMs_) {
+          // Released after the threshold before update() noticed it.
+          emit_(ButtonGesture::LongPress);
+          state_ = State::Idle;
+        } else {
+          state_ = State::WaitSecond;
+          stateSinceMs_ = atMs;
+        }
+      }
+      break;
+
+    case State::LongHeld:
+      if (!pressed) {
+        state_ = State::Idle;
+      }
+      break;
+
+    case State::WaitSecond:
+      if (pressed) {
+        if (atMs - stateSinceMs_ < kDoubleClickMs_) {
+          state_ = State::SecondPressed;
+        } else {
+          // Window had already expired: first click was a short press.
+          emit_(ButtonGesture::ShortPress);
+          state_ = State::Pressed;
+        }
+        stateSinceMs_ = atMs;
+      }
+      break;
+
+    case State::SecondPressed:
+      if (!pressed) {
+        emit_(ButtonGesture::DoubleClick);
+        state_ = State::Idle;
+      }
+      break;
+  }
+}
+
+void Button::checkTimeouts_(uint32_t nowMs) {
+  if (state_ == State::Pressed && nowMs - stateSinceMs_ >= kLongPressMs_) {
+    emit_(ButtonGesture::LongPress);
+    state_ = State::LongHeld;
+  } else if (state_ == State::WaitSecond && nowMs - stateSinceMs_ >= kDoubleClickMs_) {
+    emit_(ButtonGesture::ShortPress);
+    state_ = State::Idle;
+  }
+}
+
+void Button::emit_(ButtonGesture gesture) {
+  if (!gestures_.push(gesture)) {
+    Serial.println("Button gesture queue full; dropped");
+  }
+}
 
-  return false;
+bool Button::nextGesture(ButtonGesture& gesture) {
+  return gestures_.pop(gesture);
 }
 
 }  // namespace inputs
@@ -2,25 +2,68 @@
 
 #include <Arduino.h>
 
+#include "util/SpscRing.h"
+
 namespace inputs {
 
+enum class ButtonGesture : uint8_t {
+  ShortPress,   // Emitted once the double-click window has expired
+  LongPress,    // Emitted while still held, at the long-press threshold
+  DoubleClick,
+};
+
+// Interrupt-driven push button (wired to GND, INPUT_PULLUP).
+//
+// A CHANGE interrupt timestamps raw edges into a ring; update() debounces
+// them using those timestamps and runs a gesture state machine that emits
+// ButtonGesture events into a queue. While the button is idle update() is
+// a couple of loads, so it can run at a relaxed period without losing
+// timing accuracy (all timing comes from the ISR timestamps).
 class Button {
  public:
   explicit Button(uint8_t pin);
 
   void begin();
 
-  // Call frequently from loop(). Returns true once per physical press.
-  bool update(uint32_t nowMs);
+  void update(uint32_t nowMs);
+
+  // Pop the next gesture; false when none is queued.
+  bool nextGesture(ButtonGesture& gesture);
 
  private:
+  struct Edge {
+    uint32_t timeMs;
+    uint8_t level;
+  };
+
+  enum class State : uint8_t { Idle, Pressed, LongHeld, WaitSecond, SecondPressed };
+
   const uint8_t pin_;
 
-  bool stableLevel_ = true;      // HIGH = not pressed (INPUT_PULLUP)
-  bool lastRawLevel_ = true;
-  uint32_t lastChangeMs_ = 0;
+  util::SpscRing<Edge, 16> edges_;
+  // Level and time of the newest edge, written by the ISR even when the
+  // ring is full, so a bounce burst cannot lose the final release.
+  volatile bool isrLevel_ = true;
+  volatile uint32_t isrEdgeMs_ = 0;
+  util::SpscRing<ButtonGesture, 8> gestures_;
+
+  // Debounce (raw level must persist kDebounceMs_ to become stable).
+  bool rawLevel_ = true;         // HIGH = not pressed (INPUT_PULLUP)
+  uint32_t rawSinceMs_ = 0;
+  bool stableLevel_ = true;
+
+  State state_ = State::Idle;
+  uint32_t stateSinceMs_ = 0;
 
   static constexpr uint32_t kDebounceMs_ = 30;
+  static constexpr uint32_t kLongPressMs_ = 1000;
+  static constexpr uint32_t kDoubleClickMs_ = 400;
+
+  static void IRAM_ATTR onEdge_(void* arg);
+  void onRawLevel_(bool level, uint32_t atMs);
+  void onStableChange_(bool pressed, uint32_t atMs);
+  void checkTimeouts_(uint32_t nowMs);
+  void emit_(ButtonGesture gesture);
 };
 
 }  // namespace inputs
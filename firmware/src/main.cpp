@@ -11,9 +11,11 @@
 #include "Secrets.h.example"
 #endif
 
+#include "net/NetworkTask.h"
 #include "net/WiFiManager.h"
 #include "thingsboard/ThingsBoardClient.h"
 
+#include "sensors/AdcScanner.h"
 #include "sensors/AnalogSensor.h"
 #include "sensors/DhtSensor.h"
 #include "sensors/PirSensor.h"
@@ -25,10 +27,15 @@
 
 #include "app/RemoteConfigManager.h"
 #include "app/RuntimeConfig.h"
+#include "app/Scheduler.h"
 #include "app/Settings.h"
 #include "inputs/Button.h"
 
 #include "app/Telemetry.h"
+#include "storage/FlashRingLog.h"
+#include "util/JsonWriter.h"
+#include "util/Log.h"
+#include "util/PerfMonitor.h"
 
 #include <RTClib.h>
 #include <Wire.h>
@@ -40,12 +47,21 @@ net::WiFiManager wifiManager;
 WiFiClient wifiClient;
 tb::ThingsBoardClient tbClient(wifiClient);
 
+// tb-cloud-root-ca.pem, embedded (NUL-terminated) via board_build.embed_txtfiles.
+extern const char kTbRootCaPem[] asm("_binary_tb_cloud_root_ca_pem_start");
+
+// WiFi + MQTT run on their own task (core 0); everything else stays on loop().
+net::NetworkTask networkTask(wifiManager, tbClient);
+
 sensors::DhtSensor dht(config::kPinDht);
 sensors::PirSensor pir(config::kPinPir);
 sensors::Bh1750Sensor bh1750;
 
-// MQ-135 is treated as raw analog value
-sensors::AnalogSensor mq135(config::kPinMq135Analog);
+// Background DMA scan shared by all analog channels.
+sensors::AdcScanner adcScanner;
+
+// MQ-135 is treated as raw analog value (oversampled + calibrated mV)
+sensors::AnalogSensor mq135(adcScanner, config::kPinMq135Analog);
 
 actuators::RelayActuator lightRelay(config::kPinRelayLight, config::kRelayActiveLow);
 actuators::RelayActuator valveRelay(config::kPinRelayValve, config::kRelayActiveLow);
@@ -56,6 +72,8 @@ controllers::LightController lightController(
 controllers::WateringController wateringController(valveRelay);
 
 app::Telemetry telemetry;
+// Samples taken while MQTT is down; replayed after reconnect.
+storage::FlashRingLog telemetryLog;
 
 app::RuntimeConfig runtimeConfig;
 
@@ -67,76 +85,115 @@ app::RemoteConfigManager remoteConfig(runtimeConfig, settings, lightController,
 
 RTC_DS1307 rtc;
 
-uint32_t lastSensorReadMs = 0;
-uint32_t lastTelemetryMs = 0;
+app::Scheduler scheduler;
+app::Scheduler::TaskId sensorTask = app::Scheduler::kInvalidTask;
+app::Scheduler::TaskId telemetryTask = app::Scheduler::kInvalidTask;
 
-uint32_t lastAttrRequestMs = 0;
-uint32_t attrRequestId = 1;
-bool attrRequestedThisConnection = false;
+bool mqttConnected = false;
+
+uint32_t attrRequestedForConnection = 0;  // tbClient.connectionCount() when last requested
 
 sensors::DhtReading lastDhtReading;
 bool lastMotionDetected = false;
 
-void onTbRpc(const char* method, JsonVariantConst params) {
-  // ========== DUMB DEVICE MODE ==========
-  // ESP32 chủ yếu nhận lệnh từ Shared Attributes (self_light_enable).
-  // RPC commands dưới đây là backup cho manual control/testing.
-  // =======================================
-
-  if (strcmp(method, "setLight") == 0) {
-    const bool on = params.as<bool>();
-    settings.setRemoteLightOverride(true, on);
-    Serial.print("RPC setLight: ");
-    Serial.println(on ? "ON" : "OFF");
-    return;
-  }
+// Command-to-GPIO latency of remote commands (MQTT receive to relay write).
+uint32_t actuationLastUs = 0;
+uint32_t actuationMaxUs = 0;
 
-  if (strcmp(method, "clearLightOverride") == 0) {
-    settings.setRemoteLightOverride(false, false);
-    Serial.println("RPC clearLightOverride");
-    return;
+// Settings changed (RPC, attribute, button): move the relays now instead
+// of on the next controller tick.
+void onSettingsChanged(app::Settings::Change change) {
+  const uint32_t nowMs = millis();
+  switch (change) {
+    case app::Settings::Change::Light:
+      lightController.update(nowMs, lastMotionDetected, lastDhtReading, settings);
+      break;
+    case app::Settings::Change::Valve:
+      wateringController.setSelfValveEnable(settings.selfValveEnable());
+      wateringController.update(nowMs);
+      break;
   }
 
-  // Legacy RPCs for temp limit (not used in dumb device mode, kept for compatibility)
-  if (strcmp(method, "setTempLimit") == 0) {
-    const float limitC = params.as<float>();
-    settings.setTempTooColdC(limitC);
-    settings.setTempLimitEnabled(true);
-    Serial.print("RPC setTempLimit (legacy): ");
-    Serial.println(limitC);
-    return;
+  const uint32_t ageUs = tbClient.inboundAgeUs();
+  if (ageUs > 0) {
+    actuationLastUs = ageUs;
+    if (ageUs > actuationMaxUs) {
+      actuationMaxUs = ageUs;
+    }
   }
+}
 
-  if (strcmp(method, "setTempLimitEnabled") == 0) {
-    const bool enabled = params.as<bool>();
-    settings.setTempLimitEnabled(enabled);
-    Serial.print("RPC setTempLimitEnabled (legacy): ");
-    Serial.println(enabled ? "true" : "false");
-    return;
-  }
+// ========== DUMB DEVICE MODE ==========
+// ESP32 chủ yếu nhận lệnh từ Shared Attributes (self_light_enable).
+// RPC commands dưới đây là backup cho manual control/testing.
+// Mỗi handler trả về nullptr (OK) hoặc message lỗi; kết quả ghi vào `reply`.
+// =======================================
+
+const char* rpcSetLight(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  settings.setRemoteLightOverride(true, args.flag);
+  SG_LOGI("RPC setLight: %s", args.flag ? "ON" : "OFF");
+  reply.addBool("light_override", settings.remoteOverrideEnabled());
+  reply.addBool("light_on", settings.remoteLightOn());
+  return nullptr;
+}
 
-  if (strcmp(method, "setManualOff") == 0) {
-    const bool off = params.as<bool>();
-    settings.setManualOff(off);
-    Serial.print("RPC setManualOff: ");
-    Serial.println(off ? "true" : "false");
-    return;
-  }
+const char* rpcClearLightOverride(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  (void)args;
+  settings.setRemoteLightOverride(false, false);
+  SG_LOGI("RPC clearLightOverride");
+  reply.addBool("light_override", settings.remoteOverrideEnabled());
+  return nullptr;
+}
 
-  if (strcmp(method, "toggleManualOff") == 0) {
-    settings.toggleManualOff();
-    Serial.print("RPC toggleManualOff: ");
-    Serial.println(settings.manualOff() ? "ON" : "OFF");
-    return;
+// Legacy RPCs for temp limit (not used in dumb device mode, kept for compatibility)
+const char* rpcSetTempLimit(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  if (!(args.number >= -40.0f && args.number <= 60.0f)) {
+    return "params: temperature out of range (-40..60)";
   }
+  settings.setTempTooColdC(args.number);
+  settings.setTempLimitEnabled(true);
+  SG_LOGI("RPC setTempLimit (legacy): %.2f", args.number);
+  reply.addFloat("temp_limit_c", settings.tempTooColdC(), 1);
+  reply.addBool("temp_limit_enabled", settings.tempLimitEnabled());
+  return nullptr;
+}
 
-  // Note: Watering is now controlled by Server via self_valve_enable attribute
-  // (removed setWateringInterval RPC)
+const char* rpcSetTempLimitEnabled(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  settings.setTempLimitEnabled(args.flag);
+  SG_LOGI("RPC setTempLimitEnabled (legacy): %s", args.flag ? "true" : "false");
+  reply.addBool("temp_limit_enabled", settings.tempLimitEnabled());
+  return nullptr;
+}
 
-  Serial.print("RPC unknown method: ");
-  Serial.println(method);
+const char* rpcSetManualOff(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  settings.setManualOff(args.flag);
+  SG_LOGI("RPC setManualOff: %s", args.flag ? "true" : "false");
+  reply.addBool("manual_off", settings.manualOff());
+  return nullptr;
 }
 
+const char* rpcToggleManualOff(const tb::RpcArgs& args, util::JsonWriter& reply) {
+  (void)args;
+  settings.toggleManualOff();
+  SG_LOGI("RPC toggleManualOff: %s", settings.manualOff() ? "ON" : "OFF");
+  reply.addBool("manual_off", settings.manualOff());
+  return nullptr;
+}
+
+// Note: Watering is now controlled by Server via self_valve_enable attribute
+// (removed setWateringInterval RPC)
+
+// Sorted by name (binary search in ThingsBoardClient).
+constexpr tb::RpcMethod kRpcMethods[] = {
+    {"clearLightOverride", tb::RpcParam::None, rpcClearLightOverride},
+    {"setLight", tb::RpcParam::Bool, rpcSetLight},
+    {"setManualOff", tb::RpcParam::Bool, rpcSetManualOff},
+    {"setTempLimit", tb::RpcParam::Number, rpcSetTempLimit},
+    {"setTempLimitEnabled", tb::RpcParam::Bool, rpcSetTempLimitEnabled},
+    {"toggleManualOff", tb::RpcParam::None, rpcToggleManualOff},
+};
+static_assert(tb::rpcTableSorted(kRpcMethods), "kRpcMethods must be sorted by name");
+
 void onTbAttributes(JsonVariantConst root) {
   // ========== THINGSBOARD SHARED ATTRIBUTES HANDLER ==========
   // Callback này được gọi khi:
@@ -147,37 +204,398 @@ void onTbAttributes(JsonVariantConst root) {
   // được trigger tự động => ESP32 nhận lệnh real-time
   // ===========================================================
   
-  // 🔍 DEBUG: In ra toàn bộ JSON nhận được từ Server
-  Serial.print("📥 Received attributes from ThingsBoard at ");
-  Serial.print(millis());
-  Serial.println(" ms:");
-  String jsonDebug;
-  serializeJsonPretty(root, jsonDebug);
-  Serial.println(jsonDebug);
+  SG_LOGI("📥 Received attributes from ThingsBoard");
+#if SG_LOG_ENABLED(SG_LOG_LEVEL_DEBUG)
+  // 🔍 DEBUG: toàn bộ JSON (chỉ còn các key đã lọc), stream thẳng ra Serial.
+  serializeJson(root, Serial);
+  Serial.println();
+#endif
   
   if (remoteConfig.applyAttributes(root)) {
-    Serial.println("✅ Applied remote config from ThingsBoard attributes");
-    Serial.print("   └─ self_light_enable = ");
-    Serial.println(settings.selfLightEnable() ? "TRUE" : "FALSE");
-    Serial.print("   └─ self_valve_enable = ");
-    Serial.println(settings.selfValveEnable() ? "TRUE" : "FALSE");
-    Serial.print("   └─ Current temperature = ");
+    scheduler.setPeriod(sensorTask, runtimeConfig.sensorReadIntervalMs);
+    scheduler.setPeriod(telemetryTask, runtimeConfig.telemetryIntervalMs);
+    telemetry.setBatching(runtimeConfig.telemetryBatchSize, runtimeConfig.telemetryMaxLatencyMs);
+
+    SG_LOGI("✅ Applied remote config: self_light_enable=%s self_valve_enable=%s",
+            settings.selfLightEnable() ? "TRUE" : "FALSE",
+            settings.selfValveEnable() ? "TRUE" : "FALSE");
     if (lastDhtReading.ok) {
-      Serial.print(lastDhtReading.temperatureC);
-      Serial.println("°C");
+      SG_LOGI("   └─ Current temperature = %.2f°C", lastDhtReading.temperatureC);
+    }
+  } else {
+    SG_LOGD("No changes applied (attribute format issue or no change)");
+  }
+}
+
+// ---- Scheduled tasks (see setup() for periods/priorities) ----
+
+void taskButton(uint32_t nowMs) {
+  lightManualButton.update(nowMs);
+
+  inputs::ButtonGesture gesture;
+  while (lightManualButton.nextGesture(gesture)) {
+    switch (gesture) {
+      case inputs::ButtonGesture::ShortPress:
+        settings.toggleManualOff();
+        SG_LOGI("Manual light OFF latch: %s", settings.manualOff() ? "ON" : "OFF");
+        break;
+
+      case inputs::ButtonGesture::LongPress:
+        // Back to automatic: drop the local latch and any RPC override.
+        settings.setManualOff(false);
+        settings.setRemoteLightOverride(false, false);
+        SG_LOGI("Button long press: light back to server control");
+        break;
+
+      case inputs::ButtonGesture::DoubleClick:
+        // On-site check: push a telemetry snapshot right away.
+        scheduler.trigger(telemetryTask, nowMs);
+        SG_LOGI("Button double click: sending telemetry now");
+        break;
+    }
+  }
+}
+
+void taskNetwork(uint32_t /*nowMs*/) {
+  // Run RPC / attribute handlers queued by the network task.
+  tbClient.processInbound();
+
+  mqttConnected = tbClient.isConnected();
+  if (!mqttConnected) {
+    return;
+  }
+
+  // ========== REQUEST ATTRIBUTES ON RECONNECT ==========
+  // Khi mới connect/reconnect, ESP32 cần hỏi Server về trạng thái hiện tại:
+  // "Đèn nên ON hay OFF lúc này?"
+  // 
+  // Lý do: ESP32 có thể mất điện/reset giữa chừng, cần đồng bộ lại
+  // với trạng thái self_light_enable từ Server
+  // ======================================================
+  const uint32_t connection = tbClient.connectionCount();
+  // tbClient retries until the matching response arrives.
+  if (attrRequestedForConnection != connection) {
+    if (tbClient.requestSharedAttributes(app::RemoteConfigManager::sharedKeysCsv())) {
+      SG_LOGI("📡 Shared attributes requested");
+      attrRequestedForConnection = connection;
     } else {
-      Serial.println("N/A");
+      SG_LOGW("❌ Shared attribute request failed");
     }
+  }
+}
+
+void taskSensors(uint32_t /*nowMs*/) {
+  {
+    // Only triggers the transaction; taskDht collects the result.
+    SG_PERF_SCOPE(DhtRead);
+    if (!dht.startRead()) {
+      SG_LOGW("DHT busy or read interval < 2000ms; skipping");
+    }
+  }
+  
+  // Level is tracked by the PIR interrupt; drain() just folds queued edges
+  // into the current telemetry window so the ring never fills.
+  pir.drain();
+  lastMotionDetected = pir.readMotion();
+  SG_LOGD("PIR motion: %s", lastMotionDetected ? "DETECTED" : "none");
+  
+  // Latest decimated block from the DMA scan (taskAdc); no ADC access here.
+  const int mq135Raw = mq135.readRaw();
+  const uint32_t mq135Mv = mq135.readMilliVolts();
+  SG_LOGD("MQ135 raw: %d (%u mV)", mq135Raw, mq135Mv);
+  
+  // Cached value from the background pipeline (taskLux); no I2C here.
+  const float lightLux = bh1750.readLux();
+  if (bh1750.isOk()) {
+    SG_LOGD("BH1750 light: %.2f lux", lightLux);
+  } else {
+    SG_LOGD("BH1750 not initialized");
+  }
+
+  telemetry.updateSensors(mq135Raw, mq135Mv, lightLux);
+}
+
+void taskDht(uint32_t /*nowMs*/) {
+  sensors::DhtReading reading;
+  if (!dht.poll(reading)) {
+    return;
+  }
+
+  lastDhtReading = reading;
+  telemetry.updateDht(lastDhtReading);
+  if (lastDhtReading.ok) {
+    SG_LOGD("DHT ok: T=%.2fC H=%.2f%%", lastDhtReading.temperatureC, lastDhtReading.humidityPct);
   } else {
-    Serial.println("⚠️  No changes applied (attribute format issue or no change)");
+    SG_LOGW("DHT read failed (timeout/checksum). Check wiring/pin/type");
+  }
+}
+
+void taskAdc(uint32_t /*nowMs*/) {
+  SG_PERF_SCOPE(AdcDrain);
+  adcScanner.update();
+}
+
+void taskLux(uint32_t nowMs) {
+  SG_PERF_SCOPE(LuxRead);
+  bh1750.update(nowMs);
+}
+
+void taskControllers(uint32_t nowMs) {
+  // Setting changes are applied at once by onSettingsChanged(); this tick
+  // follows sensor inputs (temperature safety) and re-asserts the relays.
+  lightController.update(nowMs, lastMotionDetected, lastDhtReading, settings);
+  wateringController.update(nowMs);
+  
+  // Log light state changes
+  static bool prevLightOn = false;
+  const bool currentLightOn = lightController.state().lightOn;
+  if (currentLightOn != prevLightOn) {
+    SG_LOGI("💡 Light state changed: %s", currentLightOn ? "ON" : "OFF");
+    prevLightOn = currentLightOn;
+  }
+}
+
+// Debug only: the I2C read exists just for this line, so it is compiled
+// out together with it.
+void logRtcTime() {
+  if (!SG_LOG_ENABLED(SG_LOG_LEVEL_DEBUG)) {
+    return;
+  }
+  if (rtc.begin() && rtc.isrunning()) {
+    const DateTime now = rtc.now();
+    char text[24];
+    snprintf(text, sizeof(text), "%04u/%02u/%02u %02u:%02u:%02u", (unsigned)now.year(),
+             (unsigned)now.month(), (unsigned)now.day(), (unsigned)now.hour(),
+             (unsigned)now.minute(), (unsigned)now.second());
+    SG_LOGD("🕐 RTC Time: %s", text);
+  }
+}
+
+// Batch records per publish that always fit one outbound stream.
+constexpr size_t kMaxSamplesPerPublish =
+    (tb::ThingsBoardClient::kMaxOutboundPayload - 2 /* [] */) / app::Telemetry::kMaxRecordBytes;
+static_assert(kMaxSamplesPerPublish >= 1, "one telemetry record must fit the outbound MQTT stream");
+
+// Offline: move timestamped samples from RAM to the flash log so an outage
+// longer than the RAM ring (Telemetry::kMaxSamples) leaves no gap.
+void spillTelemetryToFlash() {
+  if (!telemetryLog.ready() || !telemetry.hasEpoch()) {
+    return;  // Without "ts" a replayed sample would be stamped on arrival.
+  }
+  SG_PERF_SCOPE(FlashLog);
+  app::Telemetry::Sample sample;
+  while (telemetry.popOldest(sample)) {
+    telemetryLog.append(&sample);
+  }
+}
+
+void taskTelemetry(uint32_t nowMs) {
+  {
+    SG_PERF_SCOPE(RtcLog);
+    logRtcTime();
+  }
+
+  SG_LOGD("⏱️  Scheduler idle: %u%%", scheduler.stats().idlePct());
+
+  const sensors::MotionWindow motion = pir.closeWindow();
+  telemetry.updateMotion(motion);
+  SG_LOGD("PIR window: count=%u occupancy=%u%%", motion.motionCount, motion.occupancyPct());
+
+  // Stamp a sample now; it is published later as part of a batch.
+  telemetry.captureSample(nowMs, lightController.state(), wateringController.state(), settings.selfLightEnable(), settings.selfValveEnable());
+#if SG_LOG_ENABLED(SG_LOG_LEVEL_DEBUG)
+  Serial.print("📝 Telemetry sample ");
+  util::JsonWriter echo(Serial);
+  telemetry.writeLatestJson(echo);
+  Serial.println();
+#endif
+
+  if (!mqttConnected) {
+    spillTelemetryToFlash();
+    return;
+  }
+
+  // Several publishes if the batch is larger than one outbound stream holds.
+  while (telemetry.flushDue(nowMs)) {
+    const size_t pending = telemetry.pendingSamples();
+    size_t sent = 0;
+    {
+      SG_PERF_SCOPE(TelemetryBuild);
+      // Streamed straight into the outbound MQTT queue (no String / staging buffer).
+      Print* out = tbClient.beginTelemetryPublish();
+      if (out != nullptr) {
+        util::JsonWriter json(*out);
+        sent = telemetry.writeBatchJson(json, kMaxSamplesPerPublish);
+        if (sent == 0) {
+          tbClient.abortPublish();
+        } else if (!tbClient.endPublish()) {
+          sent = 0;
+        }
+      }
+    }
+    if (sent == 0) {
+      // Samples stay queued; retried on the next tick.
+      SG_LOGW("❌ Telemetry publish failed");
+      return;
+    }
+    telemetry.consumeSamples(sent);
+    SG_LOGI("✅ Telemetry batch published: %u/%u samples", sent, pending);
+  }
+}
+
+// Persists remote config changes once the write-behind delay has passed.
+void taskConfigPersist(uint32_t nowMs) {
+  remoteConfig.loop(nowMs);
+}
+
+// Replays the flash backlog after reconnect: one small batch per period so
+// the backlog never starves live telemetry or floods the broker. A batch
+// is erased from flash only once the broker has it (PUBACK at QoS1, socket
+// write at QoS0); a lost batch is peeked again on a later tick.
+void taskReplay(uint32_t nowMs) {
+  static_assert(config::kReplayBatchSamples <= kMaxSamplesPerPublish,
+                "replay batch must fit one outbound MQTT stream");
+  static app::Telemetry::Sample batch[config::kReplayBatchSamples];
+  static size_t inFlight = 0;  // Samples of the batch awaiting delivery
+
+  if (inFlight > 0) {
+    switch (tbClient.publishDelivery()) {
+      case tb::ThingsBoardClient::Delivery::Pending:
+        return;  // QoS1 batches are re-sent across reconnects
+      case tb::ThingsBoardClient::Delivery::Delivered:
+        telemetryLog.consumePeeked();
+        SG_LOGI("📼 Backlog replayed: %u samples", inFlight);
+        break;
+      case tb::ThingsBoardClient::Delivery::Lost:
+        SG_LOGW("❌ Backlog replay lost: %u samples (will retry)", inFlight);
+        break;
+    }
+    inFlight = 0;
+  }
+
+  if (!mqttConnected || !telemetryLog.hasPending() || telemetry.flushDue(nowMs)) {
+    return;  // Live samples go first.
+  }
+
+  SG_PERF_SCOPE(FlashLog);
+  const size_t count = telemetryLog.peek(batch, config::kReplayBatchSamples);
+  if (count == 0) {
+    // Only torn / corrupt slots were scanned; skip past them.
+    telemetryLog.consumePeeked();
+    return;
+  }
+
+  Print* out = tbClient.beginTelemetryPublish();
+  if (out == nullptr) {
+    return;
+  }
+  util::JsonWriter json(*out);
+  json.beginArray();
+  for (size_t i = 0; i < count; ++i) {
+    app::Telemetry::writeRecordJson(json, batch[i]);
+  }
+  json.endArray();
+  if (!json.ok()) {
+    tbClient.abortPublish();
+  } else if (tbClient.endPublish(true)) {
+    inFlight = count;
+    return;
   }
+  SG_LOGW("❌ Backlog replay failed: %u samples", count);
 }
 
+#if SG_PERF_ENABLED
+void taskPerfReport(uint32_t nowMs) {
+  if (!mqttConnected) {
+    return;
+  }
+
+  // Per-stage histograms are split so each publish fits the MQTT buffer.
+  // Everything is streamed straight into the outbound MQTT queue.
+  util::PerfMonitor& perf = util::PerfMonitor::instance();
+  for (uint8_t first = 0; first < (uint8_t)util::PerfStage::kCount;
+       first += config::kPerfStagesPerMessage) {
+    Print* out = tbClient.beginTelemetryPublish();
+    if (out == nullptr) {
+      continue;
+    }
+    util::JsonWriter json(*out);
+    if (perf.writeTelemetryJson(json, first, config::kPerfStagesPerMessage) == 0) {
+      tbClient.abortPublish();
+    } else {
+      tbClient.endPublish();
+    }
+  }
+
+  Print* out = tbClient.beginTelemetryPublish();
+  if (out != nullptr) {
+    util::JsonWriter json(*out);
+    json.beginObject();
+    json.addUint("perf_idle_pct", scheduler.stats().idlePct());
+    json.addUint("perf_heap_free", ESP.getFreeHeap());
+    json.addUint("perf_heap_min", ESP.getMinFreeHeap());
+    json.addUint("perf_net_stack_free", networkTask.stackHighWaterMark());
+    json.addUint("perf_log_dropped", telemetryLog.stats().dropped);
+    json.addUint("perf_log_corrupt", telemetryLog.stats().corrupt);
+    json.addUint("perf_mqtt_connect_ms", tbClient.lastConnectDurationMs());
+    json.addUint("perf_mqtt_step_max_us", tbClient.worstConnectStepUs());
+    if (config::kThingsBoardTls) {
+      json.addUint("perf_tls_hs_ms", tbClient.tlsHandshakeMs());
+      json.addUint("perf_tls_hs_heap", tbClient.tlsHandshakeHeapBytes());
+      json.addUint("perf_tls_resumed", tbClient.tlsResumedCount());
+      json.addUint("perf_tls_full", tbClient.tlsFullHandshakeCount());
+    }
+    json.addUint("perf_mqtt_rx_arena_peak", tbClient.inboundJsonPeakBytes());
+    json.addUint("perf_mqtt_rx_arena_fail", tbClient.inboundJsonFailures());
+    json.addUint("perf_actuate_us", actuationLastUs);
+    json.addUint("perf_actuate_max_us", actuationMaxUs);
+    json.addUint("perf_cfg_changes", remoteConfig.persistStats().changes);
+    json.addUint("perf_cfg_writes", remoteConfig.persistStats().writes);
+    json.addUint("perf_cfg_write_us", remoteConfig.persistStats().lastWriteUs);
+    json.addUint("perf_cfg_write_max_us", remoteConfig.persistStats().maxWriteUs);
+    json.addUint("perf_attr_rtt_ms", tbClient.attrRttLastMs());
+    json.addUint("perf_attr_rtt_max_ms", tbClient.attrRttMaxMs());
+    json.addUint("perf_attr_timeouts", tbClient.attrTimeoutCount());
+    json.addUint("perf_attr_failed", tbClient.attrFailedCount());
+    json.addUint("perf_attr_unmatched", tbClient.attrUnmatchedCount());
+    json.addUint("perf_mqtt_acked", tbClient.qos1AckedCount());
+    json.addUint("perf_mqtt_retx", tbClient.qos1RetransmitCount());
+    json.addUint("perf_mqtt_inflight", tbClient.qos1InFlight());
+    const util::Log::Stats logStats = util::Log::instance().stats();
+    json.addUint("perf_serial_log_dropped", logStats.dropped);
+    json.addUint("perf_serial_log_peak", logStats.peakBytes);
+    json.addUint("perf_mqtt_ack_avg_ms", tbClient.ackLatencyAvgMs());
+    json.addUint("perf_mqtt_ack_max_ms", tbClient.ackLatencyMaxMs());
+    json.addUint("perf_wifi_connect_ms", wifiManager.lastConnectDurationMs());
+    json.addUint("perf_wifi_boot_ms", wifiManager.bootToConnectedMs());
+    json.addUint("perf_wifi_fast_join", wifiManager.fastJoinCount());
+    json.addUint("perf_wifi_fast_fallback", wifiManager.fastJoinFallbackCount());
+    json.addUint("perf_wifi_disc", wifiManager.disconnectTotal());
+    json.addUint("perf_wifi_disc_auth", wifiManager.disconnectCount(net::WiFiManager::DisconnectCause::Auth));
+    json.addUint("perf_wifi_disc_no_ap", wifiManager.disconnectCount(net::WiFiManager::DisconnectCause::NoAp));
+    json.addUint("perf_wifi_disc_beacon", wifiManager.disconnectCount(net::WiFiManager::DisconnectCause::Beacon));
+    json.addUint("perf_wifi_disc_timeout", wifiManager.disconnectCount(net::WiFiManager::DisconnectCause::Timeout));
+    json.addUint("perf_wifi_disc_other", wifiManager.disconnectCount(net::WiFiManager::DisconnectCause::Other));
+    json.addUint("perf_wifi_reason", wifiManager.lastDisconnectReason());
+    json.endObject();
+    tbClient.endPublish();
+  }
+
+  // Each report covers one window.
+  perf.reset();
+  scheduler.resetStats(nowMs);
+}
+#endif
+
 }  // namespace
 
 void setup() {
   Serial.begin(115200);
   delay(50);
+  // SG_LOGx records are queued in RAM and written out by this task.
+  util::Log::instance().startDrainTask(Serial, config::kLogBinaryOutput, config::kLogTaskCore,
+                                       config::kLogTaskStackBytes, config::kLogTaskPriority,
+                                       config::kLogDrainIntervalMs);
 
   Serial.println();
   Serial.println("Smart Garden ESP32 starting...");
@@ -206,6 +624,10 @@ void setup() {
       Serial.print(':');
       Serial.println(now.second(), DEC);
     }
+    // Wall-clock anchor for telemetry "ts" (RTC local time -> UTC epoch ms).
+    const uint32_t anchorMs = millis();
+    const uint32_t rtcUnix = rtc.now().unixtime();
+    telemetry.setEpochAnchor((uint64_t)(rtcUnix - config::kRtcUtcOffsetSec) * 1000ULL, anchorMs);
   }
 
   lightRelay.begin();
@@ -214,166 +636,75 @@ void setup() {
   dht.begin();
   pir.begin();
   mq135.begin();
+  adcScanner.begin(config::kAdcSampleRateHz, config::kAdcSamplesPerValue);
   bh1750.begin();
 
   lightManualButton.begin();
 
+  settings.setChangeHandler(onSettingsChanged);
   settings.setTempLimitEnabled(config::kTempLightEnabledByDefault);
   settings.setTempTooColdC(config::kTempTooColdCDefault);
 
-  // Initialize runtime defaults from Config.h (fallback).
-  runtimeConfig.telemetryIntervalMs = config::kTelemetryIntervalMs;
-  runtimeConfig.sensorReadIntervalMs = config::kSensorReadIntervalMs;
-  runtimeConfig.tempLightEnabled = config::kTempLightEnabledByDefault;
-  runtimeConfig.tempTooColdC = config::kTempTooColdCDefault;
-  runtimeConfig.minValveOnMs = config::kMinValveOnMs;
-  runtimeConfig.minValveOffMs = config::kMinValveOffMs;
-  runtimeConfig.selfLightEnable = true;  // Default: enabled
-
   // WateringController is now controlled via Server (no timer logic)
   // wateringController.setInterval() removed - Server controls via self_valve_enable
 
+  remoteConfig.setPersistDelay(config::kConfigPersistDelayMs);
   remoteConfig.begin();
+  telemetry.setBatching(runtimeConfig.telemetryBatchSize, runtimeConfig.telemetryMaxLatencyMs);
 
   Serial.print("Telemetry interval ms: ");
   Serial.println(runtimeConfig.telemetryIntervalMs);
+  Serial.print("Telemetry batch: ");
+  Serial.print(runtimeConfig.telemetryBatchSize);
+  Serial.print(" samples / max ");
+  Serial.print(runtimeConfig.telemetryMaxLatencyMs);
+  Serial.println(" ms");
   Serial.print("Sensor read interval ms: ");
   Serial.println(runtimeConfig.sensorReadIntervalMs);
 
-  wifiManager.begin(secrets::kWifiSsid, secrets::kWifiPassword);
-  wifiManager.ensureConnected();
+  wifiManager.begin(secrets::kWifiSsid, secrets::kWifiPassword, config::kWifiBackoffMinMs,
+                    config::kWifiBackoffMaxMs, config::kWifiConnectTimeoutMs);
+  wifiManager.setFastJoin(config::kWifiFastJoin, config::kWifiDirectedTimeoutMs,
+                          config::kWifiReuseDhcpLease);
 
   tbClient.begin(secrets::kThingsBoardHost, secrets::kThingsBoardPort, secrets::kThingsBoardAccessToken);
-  tbClient.setRpcHandler(onTbRpc);
+  tbClient.setTelemetryQos1(config::kTelemetryQos1, config::kTelemetryQos1Window);
+  if (config::kThingsBoardTls) {
+    tbClient.setTls(kTbRootCaPem);
+  }
+  tbClient.setRpcMethods(kRpcMethods);
   tbClient.setAttributesHandler(onTbAttributes);
+  tbClient.setAttributeKeys(app::RemoteConfigManager::sharedKeysCsv());
+  tbClient.setAttributeRequestPolicy(config::kAttrRequestTimeoutMs, config::kAttrRetryBackoffMinMs,
+                                     config::kAttrRetryBackoffMaxMs, config::kAttrRequestMaxAttempts);
+
+  // Connects WiFi/MQTT in the background; setup() no longer blocks on it.
+  networkTask.start(config::kDeviceName, config::kNetworkTaskCore,
+                    config::kNetworkTaskStackBytes, config::kNetworkTaskPriority,
+                    config::kNetworkTaskPollIntervalMs);
+
+  telemetryLog.begin(config::kTelemetryLogPartition, sizeof(app::Telemetry::Sample));
+
+  // Priorities: input first so a press is never delayed behind a slow
+  // sensor read; sensors before telemetry so a shared tick sends fresh data.
+  scheduler.begin(millis());
+  scheduler.addTask("button", taskButton, config::kButtonPollIntervalMs, 50);
+  scheduler.addTask("network", taskNetwork, config::kNetworkPollIntervalMs, 40);
+  scheduler.addTask("controllers", taskControllers, config::kControllerIntervalMs, 30);
+  sensorTask = scheduler.addTask("sensors", taskSensors, runtimeConfig.sensorReadIntervalMs, 20);
+  scheduler.addTask("dht", taskDht, config::kDhtPollIntervalMs, 25);
+  scheduler.addTask("lux", taskLux, config::kLuxPollIntervalMs, 24);
+  scheduler.addTask("adc", taskAdc, config::kAdcDrainIntervalMs, 23);
+  telemetryTask = scheduler.addTask("telemetry", taskTelemetry, runtimeConfig.telemetryIntervalMs, 10);
+  scheduler.addTask("replay", taskReplay, config::kReplayIntervalMs, 8);
+  scheduler.addTask("cfg_persist", taskConfigPersist, config::kConfigPersistPollMs, 6);
+#if SG_PERF_ENABLED
+  scheduler.addTask("perf", taskPerfReport, config::kPerfReportIntervalMs, 5,
+                    config::kPerfReportIntervalMs);
+#endif
 }
 
 void loop() {
-  wifiManager.ensureConnected();
-
-  const uint32_t nowMs = millis();
-
-  if (lightManualButton.update(nowMs)) {
-    settings.toggleManualOff();
-    Serial.print("Manual light OFF latch: ");
-    Serial.println(settings.manualOff() ? "ON" : "OFF");
-  }
-
-  // Keep MQTT alive (non-blocking).
-  tbClient.loop();
-
-  const bool mqttConnected = tbClient.ensureConnected(config::kDeviceName);
-  if (!mqttConnected) {
-    // Force attribute re-request after reconnect.
-    attrRequestedThisConnection = false;
-  } else {
-    // ========== REQUEST ATTRIBUTES ON RECONNECT ==========
-    // Khi mới connect/reconnect, ESP32 cần hỏi Server về trạng thái hiện tại:
-    // "Đèn nên ON hay OFF lúc này?"
-    // 
-    // Lý do: ESP32 có thể mất điện/reset giữa chừng, cần đồng bộ lại
-    // với trạng thái self_light_enable từ Server
-    // ======================================================
-    if (!attrRequestedThisConnection && (nowMs - lastAttrRequestMs) >= 30000) {
-      lastAttrRequestMs = nowMs;
-      Serial.print("📡 Requesting shared attributes: ");
-      Serial.println(app::RemoteConfigManager::sharedKeysCsv());
-      if (tbClient.requestSharedAttributes(attrRequestId++, app::RemoteConfigManager::sharedKeysCsv())) {
-        Serial.println("   └─ Request sent successfully");
-        attrRequestedThisConnection = true;
-      } else {
-        Serial.println("   └─ ❌ Request failed!");
-      }
-    }
-  }
-
-  // Periodic sensor read.
-  if (nowMs - lastSensorReadMs >= runtimeConfig.sensorReadIntervalMs) {
-    lastSensorReadMs = nowMs;
-
-    lastDhtReading = dht.read();
-    if (lastDhtReading.ok) {
-      Serial.print("DHT ok: T=");
-      Serial.print(lastDhtReading.temperatureC);
-      Serial.print("C H=");
-      Serial.print(lastDhtReading.humidityPct);
-      Serial.println("%");
-    } else {
-      Serial.println("DHT read failed (NaN). Check wiring/pin/type or read interval >= 2000ms");
-    }
-    
-    lastMotionDetected = pir.readMotion();
-    Serial.print("PIR motion: ");
-    Serial.println(lastMotionDetected ? "DETECTED" : "none");
-    
-    const int mq135Raw = mq135.readRaw();
-    Serial.print("MQ135 raw: ");
-    Serial.println(mq135Raw);
-    
-    const float lightLux = bh1750.readLux();
-    if (bh1750.isOk()) {
-      Serial.print("BH1750 light: ");
-      Serial.print(lightLux);
-      Serial.println(" lux");
-    } else {
-      Serial.println("BH1750 not initialized");
-    }
-
-    telemetry.updateSensors(lastDhtReading, lastMotionDetected, mq135Raw, lightLux);
-
-    wateringController.update(nowMs);
-  }
-
-  // Update light frequently so manual button / remote override takes effect immediately.
-  lightController.update(nowMs, lastMotionDetected, lastDhtReading, settings);
-  
-  // Log light state changes
-  static bool prevLightOn = false;
-  const bool currentLightOn = lightController.state().lightOn;
-  if (currentLightOn != prevLightOn) {
-    Serial.print("💡 Light state changed: ");
-    Serial.println(currentLightOn ? "ON" : "OFF");
-    prevLightOn = currentLightOn;
-  }
-
-  // Periodic telemetry send.
-  if (nowMs - lastTelemetryMs >= runtimeConfig.telemetryIntervalMs) {
-    lastTelemetryMs = nowMs;
-
-    // Log RTC time
-    if (rtc.begin() && rtc.isrunning()) {
-      DateTime now = rtc.now();
-      Serial.print("🕐 RTC Time: ");
-      Serial.print(now.year(), DEC);
-      Serial.print('/');
-      if (now.month() < 10) Serial.print('0');
-      Serial.print(now.month(), DEC);
-      Serial.print('/');
-      if (now.day() < 10) Serial.print('0');
-      Serial.print(now.day(), DEC);
-      Serial.print(" ");
-      if (now.hour() < 10) Serial.print('0');
-      Serial.print(now.hour(), DEC);
-      Serial.print(':');
-      if (now.minute() < 10) Serial.print('0');
-      Serial.print(now.minute(), DEC);
-      Serial.print(':');
-      if (now.second() < 10) Serial.print('0');
-      Serial.println(now.second(), DEC);
-    }
-
-    if (mqttConnected) {
-      const auto payload = telemetry.buildTelemetryJson(lightController.state(), wateringController.state(), settings.selfLightEnable(), settings.selfValveEnable());
-      Serial.println("========================================");
-      Serial.print("📤 Sending Telemetry to ThingsBoard");
-      Serial.println(payload);
-      Serial.println("========================================");
-      const bool ok = tbClient.sendTelemetryJson(payload.c_str());
-      if (!ok) {
-        Serial.println("❌ Telemetry publish failed");
-      } else {
-        Serial.println("✅ Telemetry published successfully");
-      }
-    }
-  }
+  scheduler.runDue(millis());
+  scheduler.sleepUntilNextDeadline(config::kSchedulerMaxSleepMs);
 }
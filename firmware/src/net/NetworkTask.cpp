@@ -0,0 +1,62 @@
+#include "net/NetworkTask.h"
+
+#include <freertos/task.h>
+
+#include "util/PerfMonitor.h"
+
+namespace net {
+
+NetworkTask::NetworkTask(WiFiManager& wifi, tb::ThingsBoardClient& tbClient)
+    : wifi_(wifi), tbClient_(tbClient) {}
+
+bool NetworkTask::start(const char* deviceName, uint8_t core, uint32_t stackBytes,
+                        uint8_t priority, uint32_t pollIntervalMs) {
+  if (handle_ != nullptr) {
+    return true;
+  }
+  deviceName_ = deviceName;
+  pollIntervalMs_ = pollIntervalMs > 0 ? pollIntervalMs : 1;
+
+  const BaseType_t ok = xTaskCreatePinnedToCore(
+      taskEntry_, "net", stackBytes, this, priority, &handle_, core);
+  if (ok != pdPASS) {
+    handle_ = nullptr;
+    Serial.println("Failed to start network task");
+    return false;
+  }
+  return true;
+}
+
+uint32_t NetworkTask::stackHighWaterMark() const {
+  if (handle_ == nullptr) {
+    return 0;
+  }
+  return uxTaskGetStackHighWaterMark(handle_);
+}
+
+void NetworkTask::taskEntry_(void* arg) {
+  static_cast<NetworkTask*>(arg)->run_();
+}
+
+void NetworkTask::run_() {
+  for (;;) {
+    {
+      SG_PERF_SCOPE(WifiEnsure);
+      wifi_.ensureConnected();
+    }
+
+    if (wifi_.isConnected()) {
+      SG_PERF_SCOPE(MqttConnect);
+      tbClient_.ensureConnected(deviceName_);
+    }
+
+    {
+      SG_PERF_SCOPE(MqttLoop);
+      tbClient_.loop();
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(pollIntervalMs_));
+  }
+}
+
+}  // namespace net
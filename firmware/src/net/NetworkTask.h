@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "net/WiFiManager.h"
+#include "thingsboard/ThingsBoardClient.h"
+
+namespace net {
+
+// FreeRTOS task that owns all blocking network work (WiFi association,
+// MQTT connect, socket I/O) so it can never stall relays, the button or
+// sensors on the Arduino loop task. Pin it to the protocol core (0); the
+// Arduino loop task runs on core 1.
+class NetworkTask {
+ public:
+  NetworkTask(WiFiManager& wifi, tb::ThingsBoardClient& tbClient);
+
+  // Returns false if the task could not be created.
+  bool start(const char* deviceName, uint8_t core, uint32_t stackBytes,
+             uint8_t priority, uint32_t pollIntervalMs);
+
+  // Minimum free stack seen so far (bytes), for sizing stackBytes.
+  uint32_t stackHighWaterMark() const;
+
+ private:
+  WiFiManager& wifi_;
+  tb::ThingsBoardClient& tbClient_;
+
+  const char* deviceName_ = nullptr;
+  uint32_t pollIntervalMs_ = 10;
+  TaskHandle_t handle_ = nullptr;
+
+  static void taskEntry_(void* arg);
+  void run_();
+};
+
+}  // namespace net
@@ -1,14 +1,53 @@
 #include "net/WiFiManager.h"
 
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+
+#include "util/Crc32.h"
+#include "util/Log.h"
+
 namespace net {
 
-void WiFiManager::begin(const char* ssid, const char* password) {
+namespace {
+
+constexpr uint32_t kJoinCacheMagic = 0x4A4F494E;  // "JOIN"
+constexpr const char* kPrefsNamespace = "wifi";
+constexpr const char* kPrefsJoinKey = "join";
+
+}  // namespace
+
+WiFiManager* WiFiManager::active_ = nullptr;
+// Not cleared by software resets, panics, watchdog or brownout resets.
+RTC_NOINIT_ATTR WiFiManager::JoinCache WiFiManager::rtcCache_;
+
+void WiFiManager::begin(const char* ssid, const char* password, uint32_t backoffMinMs,
+                        uint32_t backoffMaxMs, uint32_t connectTimeoutMs) {
   ssid_ = ssid;
   password_ = password;
+  backoffMinMs_ = backoffMinMs > 0 ? backoffMinMs : 1;
+  backoffMaxMs_ = backoffMaxMs > backoffMinMs_ ? backoffMaxMs : backoffMinMs_;
+  connectTimeoutMs_ = connectTimeoutMs;
+  backoffMs_ = backoffMinMs_;
+  active_ = this;
 
   WiFi.mode(WIFI_STA);
-  WiFi.setAutoReconnect(true);
+  // The core's auto-reconnect retries immediately from the event task;
+  // retries are paced by our backoff instead.
+  WiFi.setAutoReconnect(false);
   WiFi.persistent(false);
+
+  WiFi.onEvent(onGotIp_, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  WiFi.onEvent(onDisconnected_, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+
+  loadCache_();
+}
+
+void WiFiManager::setFastJoin(bool enabled, uint32_t directedTimeoutMs, bool reuseLease) {
+  fastJoinEnabled_ = enabled;
+  directedTimeoutMs_ = directedTimeoutMs;
+  reuseLease_ = reuseLease;
+  directedArmed_ = enabled && cacheValid_;
 }
 
 bool WiFiManager::isConnected() const {
@@ -19,44 +58,245 @@ IPAddress WiFiManager::localIp() const {
   return WiFi.localIP();
 }
 
+uint32_t WiFiManager::disconnectCount(DisconnectCause cause) const {
+  const uint8_t i = static_cast<uint8_t>(cause);
+  if (i >= static_cast<uint8_t>(DisconnectCause::Count)) {
+    return 0;
+  }
+  return disconnects_[i].load(std::memory_order_relaxed);
+}
+
+uint32_t WiFiManager::disconnectTotal() const {
+  uint32_t total = 0;
+  for (const auto& count : disconnects_) {
+    total += count.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+// Event callbacks run on the Arduino event task: only record what happened.
+void WiFiManager::onGotIp_(arduino_event_id_t event, arduino_event_info_t info) {
+  (void)event;
+  (void)info;
+  if (active_ != nullptr) {
+    active_->gotIpSeq_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void WiFiManager::onDisconnected_(arduino_event_id_t event, arduino_event_info_t info) {
+  (void)event;
+  if (active_ != nullptr) {
+    active_->pendingReason_.store(info.wifi_sta_disconnected.reason, std::memory_order_relaxed);
+    active_->disconnectSeq_.fetch_add(1, std::memory_order_release);
+  }
+}
+
 void WiFiManager::ensureConnected() {
-  if (isConnected()) {
+  const uint32_t nowMs = millis();
+
+  const uint32_t disconnectSeq = disconnectSeq_.load(std::memory_order_acquire);
+  if (disconnectSeq != seenDisconnectSeq_) {
+    seenDisconnectSeq_ = disconnectSeq;
+    const uint8_t reason = pendingReason_.load(std::memory_order_relaxed);
+    if (expectLeave_ && reason == WIFI_REASON_ASSOC_LEAVE) {
+      expectLeave_ = false;  // Echo of our own WiFi.disconnect()
+    } else if (state_ == State::Connecting || state_ == State::Connected) {
+      scheduleRetry_(nowMs, classify_(reason), reason);
+    }
+  }
+
+  const uint32_t gotIpSeq = gotIpSeq_.load(std::memory_order_acquire);
+  if (gotIpSeq != seenGotIpSeq_) {
+    seenGotIpSeq_ = gotIpSeq;
+    if (state_ == State::Connecting && isConnected()) {
+      const uint32_t durationMs = nowMs - attemptStartMs_;
+      lastConnectMs_.store(durationMs, std::memory_order_relaxed);
+      backoffMs_ = backoffMinMs_;
+      state_ = State::Connected;
+      if (bootToConnectedMs_.load(std::memory_order_relaxed) == 0) {
+        bootToConnectedMs_.store(nowMs, std::memory_order_relaxed);
+      }
+      if (attemptDirected_) {
+        fastJoins_.fetch_add(1, std::memory_order_relaxed);
+      }
+      storeCache_();
+
+      SG_LOGI("WiFi connected in %u ms%s. IP: %s", durationMs,
+              attemptDirected_ ? " (directed join)" : "", WiFi.localIP().toString());
+      // The join is over: a later disconnect is an ordinary one (backoff),
+      // not a failed directed join.
+      attemptDirected_ = false;
+    }
+  }
+
+  switch (state_) {
+    case State::Idle:
+      startAttempt_(nowMs);
+      break;
+
+    case State::Connecting:
+      if (nowMs - attemptStartMs_ >= (attemptDirected_ ? directedTimeoutMs_ : connectTimeoutMs_)) {
+        scheduleRetry_(nowMs, DisconnectCause::Timeout, 0);
+        expectLeave_ = true;
+        WiFi.disconnect();
+      }
+      break;
+
+    case State::Backoff:
+      if ((int32_t)(nowMs - retryAtMs_) >= 0) {
+        startAttempt_(nowMs);
+      }
+      break;
+
+    case State::Connected:
+      break;
+  }
+}
+
+void WiFiManager::startAttempt_(uint32_t nowMs) {
+  if (ssid_ == nullptr || ssid_[0] == '\0') {
+    if (state_ == State::Idle) {
+      SG_LOGE("WiFi SSID is empty. Check include/Secrets.h");
+    }
+    state_ = State::Backoff;
+    retryAtMs_ = nowMs + backoffMaxMs_;
     return;
   }
 
-  const uint32_t nowMs = millis();
-  if (nowMs - lastAttemptMs_ < kRetryIntervalMs_) {
+  attemptDirected_ = fastJoinEnabled_ && directedArmed_ && cacheValid_;
+  if (attemptDirected_) {
+    SG_LOGI("Connecting to WiFi: %s (directed, channel %u)", ssid_, cache_.channel);
+    if (reuseLease_ && cache_.ip != 0) {
+      WiFi.config(IPAddress(cache_.ip), IPAddress(cache_.gateway), IPAddress(cache_.subnet),
+                  IPAddress(cache_.dns));
+    }
+    // Known channel + BSSID: the driver probes one channel instead of all.
+    WiFi.begin(ssid_, password_, cache_.channel, cache_.bssid);
+  } else {
+    SG_LOGI("Connecting to WiFi: %s", ssid_);
+    if (reuseLease_) {
+      // All-zero config re-enables the DHCP client.
+      WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    }
+    WiFi.begin(ssid_, password_);
+  }
+  attemptStartMs_ = nowMs;
+  state_ = State::Connecting;
+}
+
+void WiFiManager::scheduleRetry_(uint32_t nowMs, DisconnectCause cause, uint8_t reason) {
+  disconnects_[static_cast<uint8_t>(cause)].fetch_add(1, std::memory_order_relaxed);
+  lastReason_.store(reason, std::memory_order_relaxed);
+
+  if (attemptDirected_) {
+    // The cached AP may have moved channel or gone away: scan next, now.
+    attemptDirected_ = false;
+    directedArmed_ = false;
+    fastJoinFallbacks_.fetch_add(1, std::memory_order_relaxed);
+    retryAtMs_ = nowMs;
+    state_ = State::Backoff;
+    SG_LOGW("WiFi directed join failed (reason %u); falling back to scan", reason);
     return;
   }
 
-  lastAttemptMs_ = nowMs;
-  connect_();
+  // "Equal jitter": wait between half and all of the current backoff.
+  const uint32_t half = backoffMs_ / 2;
+  const uint32_t delayMs = half + (half > 0 ? esp_random() % (half + 1) : 0);
+  retryAtMs_ = nowMs + delayMs;
+  backoffMs_ = backoffMs_ >= backoffMaxMs_ / 2 ? backoffMaxMs_ : backoffMs_ * 2;
+  state_ = State::Backoff;
+
+  const char* what = cause == DisconnectCause::Timeout ? "connect timeout" : "disconnected";
+  if (reason != 0) {
+    SG_LOGW("WiFi %s (reason %u); retry in %u ms", what, reason, delayMs);
+  } else {
+    SG_LOGW("WiFi %s; retry in %u ms", what, delayMs);
+  }
+}
+
+// Reason codes: wifi_err_reason_t (esp_wifi_types.h).
+WiFiManager::DisconnectCause WiFiManager::classify_(uint8_t reason) {
+  switch (reason) {
+    case WIFI_REASON_AUTH_EXPIRE:
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+      return DisconnectCause::Auth;
+    case WIFI_REASON_NO_AP_FOUND:
+      return DisconnectCause::NoAp;
+    case WIFI_REASON_BEACON_TIMEOUT:
+    case WIFI_REASON_ASSOC_EXPIRE:
+      return DisconnectCause::Beacon;
+    default:
+      return DisconnectCause::Other;
+  }
+}
+
+uint32_t WiFiManager::ssidHash_() const {
+  return util::crc32(ssid_, strlen(ssid_));
 }
 
-void WiFiManager::connect_() {
+bool WiFiManager::cacheUsable_(const JoinCache& cache) const {
+  return cache.magic == kJoinCacheMagic && cache.ssidHash == ssidHash_() &&
+         cache.channel >= 1 && cache.channel <= 14 &&
+         util::crc32(&cache, offsetof(JoinCache, crc)) == cache.crc;
+}
+
+// RTC copy first (warm reset), NVS copy after a power cycle.
+void WiFiManager::loadCache_() {
+  cacheValid_ = false;
   if (ssid_ == nullptr || ssid_[0] == '\0') {
-    Serial.println("WiFi SSID is empty. Check include/Secrets.h");
+    return;
+  }
+  if (cacheUsable_(rtcCache_)) {
+    cache_ = rtcCache_;
+    cacheValid_ = true;
     return;
   }
 
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(ssid_);
+  Preferences prefs;
+  if (!prefs.begin(kPrefsNamespace, true)) {
+    return;
+  }
+  JoinCache stored;
+  if (prefs.getBytes(kPrefsJoinKey, &stored, sizeof(stored)) == sizeof(stored) &&
+      cacheUsable_(stored)) {
+    cache_ = stored;
+    rtcCache_ = stored;
+    cacheValid_ = true;
+  }
+  prefs.end();
+}
 
-  WiFi.begin(ssid_, password_);
+void WiFiManager::storeCache_() {
+  JoinCache fresh;
+  memset(&fresh, 0, sizeof(fresh));
+  fresh.magic = kJoinCacheMagic;
+  fresh.ssidHash = ssidHash_();
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid == nullptr) {
+    return;
+  }
+  memcpy(fresh.bssid, bssid, sizeof(fresh.bssid));
+  fresh.channel = (uint8_t)WiFi.channel();
+  fresh.ip = (uint32_t)WiFi.localIP();
+  fresh.gateway = (uint32_t)WiFi.gatewayIP();
+  fresh.subnet = (uint32_t)WiFi.subnetMask();
+  fresh.dns = (uint32_t)WiFi.dnsIP();
+  fresh.crc = util::crc32(&fresh, offsetof(JoinCache, crc));
 
-  // Quick wait loop (bounded) for nicer UX at boot.
-  const uint32_t startMs = millis();
-  while (!isConnected() && millis() - startMs < 12000) {
-    delay(250);
-    Serial.print('.');
+  rtcCache_ = fresh;
+  directedArmed_ = fastJoinEnabled_;
+  if (cacheValid_ && memcmp(&fresh, &cache_, sizeof(fresh)) == 0) {
+    return;  // Unchanged: no NVS write
   }
-  Serial.println();
+  cache_ = fresh;
+  cacheValid_ = true;
 
-  if (isConnected()) {
-    Serial.print("WiFi connected. IP: ");
-    Serial.println(WiFi.localIP());
-  } else {
-    Serial.println("WiFi not connected yet; will retry...");
+  Preferences prefs;
+  if (prefs.begin(kPrefsNamespace, false)) {
+    prefs.putBytes(kPrefsJoinKey, &fresh, sizeof(fresh));
+    prefs.end();
   }
 }
 
@@ -3,27 +3,125 @@
 #include <Arduino.h>
 #include <WiFi.h>
 
+#include <atomic>
+
 namespace net {
 
+// Station connection manager driven by WiFi.onEvent() callbacks.
+//
+// ensureConnected() never waits: it starts an association, and the event
+// callbacks (Arduino event task) report the outcome. Failed attempts and
+// link drops are retried with exponential backoff plus random jitter, so
+// many devices losing the same AP do not reconnect in lock-step.
+//
+// Fast join: the last good BSSID/channel (and optionally the DHCP lease)
+// is kept in RTC memory, which survives soft resets and brownouts, and
+// mirrored to NVS for cold boots. Attempts first join that AP directly,
+// skipping the all-channel scan; if that fails the next attempt falls
+// back to a normal scan + DHCP right away.
 class WiFiManager {
  public:
-  void begin(const char* ssid, const char* password);
+  // Disconnect reasons grouped into the buckets reported as telemetry.
+  enum class DisconnectCause : uint8_t {
+    Auth,     // Wrong password / 4-way handshake failures
+    NoAp,     // SSID not found in scan
+    Beacon,   // Link lost (beacon timeout, AP went away)
+    Timeout,  // Our own connect timeout fired
+    Other,
+    Count,
+  };
+
+  // backoffMinMs doubles after each failure up to backoffMaxMs; an attempt
+  // with no IP after connectTimeoutMs counts as a failure.
+  void begin(const char* ssid, const char* password, uint32_t backoffMinMs,
+             uint32_t backoffMaxMs, uint32_t connectTimeoutMs);
+
+  // directedTimeoutMs bounds a directed join before falling back to a scan.
+  // reuseLease also skips DHCP by re-applying the cached IP configuration
+  // (only safe when the router's leases are long / reserved).
+  void setFastJoin(bool enabled, uint32_t directedTimeoutMs, bool reuseLease);
 
-  // Ensures we are connected; tries reconnect if not.
-  // This is safe to call from loop() frequently.
+  // Advances the connect state machine; safe to call from loop()/task
+  // frequently. Returns immediately.
   void ensureConnected();
 
   bool isConnected() const;
   IPAddress localIp() const;
 
+  // Telemetry (readable from any task).
+  uint32_t lastConnectDurationMs() const { return lastConnectMs_.load(std::memory_order_relaxed); }
+  uint32_t disconnectCount(DisconnectCause cause) const;
+  uint32_t disconnectTotal() const;
+  uint8_t lastDisconnectReason() const { return lastReason_.load(std::memory_order_relaxed); }
+  // millis() at the first GOT_IP since boot (0 until then).
+  uint32_t bootToConnectedMs() const { return bootToConnectedMs_.load(std::memory_order_relaxed); }
+  uint32_t fastJoinCount() const { return fastJoins_.load(std::memory_order_relaxed); }
+  uint32_t fastJoinFallbackCount() const { return fastJoinFallbacks_.load(std::memory_order_relaxed); }
+
  private:
+  enum class State : uint8_t { Idle, Connecting, Connected, Backoff };
+
+  // Last good association. Plain POD: it lives in RTC_NOINIT memory.
+  struct JoinCache {
+    uint32_t magic;
+    uint32_t ssidHash;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t crc;  // Over all fields above
+  };
+
   const char* ssid_ = nullptr;
   const char* password_ = nullptr;
+  uint32_t backoffMinMs_ = 1000;
+  uint32_t backoffMaxMs_ = 60000;
+  uint32_t connectTimeoutMs_ = 15000;
+
+  State state_ = State::Idle;
+  uint32_t attemptStartMs_ = 0;
+  uint32_t retryAtMs_ = 0;
+  uint32_t backoffMs_ = 0;
+
+  bool fastJoinEnabled_ = false;
+  bool reuseLease_ = false;
+  uint32_t directedTimeoutMs_ = 3000;
+  JoinCache cache_;
+  bool cacheValid_ = false;
+  bool directedArmed_ = false;  // Next attempt may use the cache
+  bool attemptDirected_ = false;
+  bool expectLeave_ = false;  // Our own WiFi.disconnect() is pending
+
+  // Written by the event callbacks, consumed by ensureConnected().
+  std::atomic<uint32_t> gotIpSeq_{0};
+  std::atomic<uint32_t> disconnectSeq_{0};
+  std::atomic<uint8_t> pendingReason_{0};
+  uint32_t seenGotIpSeq_ = 0;
+  uint32_t seenDisconnectSeq_ = 0;
+
+  std::atomic<uint32_t> lastConnectMs_{0};
+  std::atomic<uint8_t> lastReason_{0};
+  std::atomic<uint32_t> bootToConnectedMs_{0};
+  std::atomic<uint32_t> fastJoins_{0};
+  std::atomic<uint32_t> fastJoinFallbacks_{0};
+  std::atomic<uint32_t> disconnects_[static_cast<uint8_t>(DisconnectCause::Count)] = {};
+
+  static WiFiManager* active_;
+  static JoinCache rtcCache_;
+  static void onGotIp_(arduino_event_id_t event, arduino_event_info_t info);
+  static void onDisconnected_(arduino_event_id_t event, arduino_event_info_t info);
 
-  uint32_t lastAttemptMs_ = 0;
-  static constexpr uint32_t kRetryIntervalMs_ = 5000;
+  void startAttempt_(uint32_t nowMs);
+  void scheduleRetry_(uint32_t nowMs, DisconnectCause cause, uint8_t reason);
+  static DisconnectCause classify_(uint8_t reason);
 
-  void connect_();
+  uint32_t ssidHash_() const;
+  bool cacheUsable_(const JoinCache& cache) const;
+  void loadCache_();
+  void storeCache_();
 };
 
 }  // namespace net
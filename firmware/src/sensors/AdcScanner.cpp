@@ -0,0 +1,160 @@
+#include "sensors/AdcScanner.h"
+
+#include <esp_idf_version.h>
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <driver/adc.h>
+#define SG_ADC_DMA_SUPPORTED 1
+#else
+#define SG_ADC_DMA_SUPPORTED 0
+#endif
+
+namespace sensors {
+
+int8_t AdcScanner::addPin(uint8_t pin) {
+  if (running_ || channelCount_ >= kMaxChannels) {
+    return -1;
+  }
+  const int8_t adcChannel = digitalPinToAnalogChannel(pin);
+  // ADC1 channels are 0..7; ADC2 (channel >= 10) conflicts with WiFi.
+  if (adcChannel < 0 || adcChannel > 7) {
+    Serial.print("AdcScanner: pin is not an ADC1 pin: ");
+    Serial.println(pin);
+    return -1;
+  }
+
+  Channel& ch = channels_[channelCount_];
+  ch.pin = pin;
+  ch.adcChannel = (uint8_t)adcChannel;
+  return (int8_t)channelCount_++;
+}
+
+#if SG_ADC_DMA_SUPPORTED
+
+bool AdcScanner::begin(uint32_t sampleRateHz, uint32_t samplesPerValue) {
+  if (running_ || channelCount_ == 0) {
+    return running_;
+  }
+
+  uint32_t channelMask = 0;
+  adc_digi_pattern_config_t pattern[kMaxChannels] = {};
+  for (uint8_t i = 0; i < channelCount_; ++i) {
+    Channel& ch = channels_[i];
+    ch.decimator.setFactor(samplesPerValue);
+    channelMask |= 1UL << ch.adcChannel;
+
+    pattern[i].atten = ADC_ATTEN_DB_11;  // Full 0..~3.1 V range
+    pattern[i].channel = ch.adcChannel;
+    pattern[i].unit = 0;                 // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = kDmaBufferBytes;
+  initConfig.conv_num_each_intr = kBytesPerInterrupt;
+  initConfig.adc1_chan_mask = channelMask;
+  initConfig.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&initConfig) != ESP_OK) {
+    Serial.println("AdcScanner: adc_digi_initialize failed");
+    return false;
+  }
+
+  adc_digi_configuration_t digiConfig = {};
+  digiConfig.conv_limit_en = true;  // Required on ESP32
+  digiConfig.conv_limit_num = 250;
+  digiConfig.pattern_num = channelCount_;
+  digiConfig.adc_pattern = pattern;
+  digiConfig.sample_freq_hz = sampleRateHz;
+  digiConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digiConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&digiConfig) != ESP_OK) {
+    Serial.println("AdcScanner: adc_digi_controller_configure failed");
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100,
+                           &calibration_);
+
+  if (adc_digi_start() != ESP_OK) {
+    Serial.println("AdcScanner: adc_digi_start failed");
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  running_ = true;
+  Serial.println("AdcScanner: continuous ADC (DMA) started");
+  return true;
+}
+
+void AdcScanner::update() {
+  if (!running_) {
+    return;
+  }
+
+  uint8_t buffer[kReadChunkBytes];
+  for (;;) {
+    uint32_t length = 0;
+    // Timeout 0: take only what DMA has already completed.
+    const esp_err_t err = adc_digi_read_bytes(buffer, sizeof(buffer), &length, 0);
+    if (err == ESP_ERR_INVALID_STATE) {
+      // Driver ring overflowed because we drained too slowly; data is still valid.
+      ++overruns_;
+    } else if (err != ESP_OK) {
+      return;
+    }
+    if (length == 0) {
+      return;
+    }
+
+    for (uint32_t offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= length;
+         offset += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* result =
+          reinterpret_cast<const adc_digi_output_data_t*>(&buffer[offset]);
+      const uint8_t adcChannel = result->type1.channel;
+
+      for (uint8_t i = 0; i < channelCount_; ++i) {
+        Channel& ch = channels_[i];
+        if (ch.adcChannel != adcChannel) {
+          continue;
+        }
+        if (ch.decimator.add(result->type1.data)) {
+          ch.raw = ch.decimator.output();
+          ch.milliVolts = esp_adc_cal_raw_to_voltage(ch.raw, &calibration_);
+          ch.hasValue = true;
+        }
+        break;
+      }
+    }
+
+    if (length < sizeof(buffer)) {
+      return;
+    }
+  }
+}
+
+#else
+
+bool AdcScanner::begin(uint32_t sampleRateHz, uint32_t samplesPerValue) {
+  Serial.println("AdcScanner: DMA ADC not supported on this core; using analogRead()");
+  return false;
+}
+
+void AdcScanner::update() {}
+
+#endif  // SG_ADC_DMA_SUPPORTED
+
+bool AdcScanner::latest(int8_t slot, uint16_t& raw, uint32_t& milliVolts) const {
+  if (!running_ || slot < 0 || slot >= channelCount_) {
+    return false;
+  }
+  const Channel& ch = channels_[slot];
+  if (!ch.hasValue) {
+    return false;
+  }
+  raw = ch.raw;
+  milliVolts = ch.milliVolts;
+  return true;
+}
+
+}  // namespace sensors
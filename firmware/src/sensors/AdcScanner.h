@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_adc_cal.h>
+
+#include "util/Decimator.h"
+
+namespace sensors {
+
+// Continuous multi-channel ADC1 scan using the digital controller + DMA.
+//
+// The hardware samples every registered pin round-robin at sampleRateHz
+// into a DMA ring; update() drains whatever finished blocks are waiting
+// (non-blocking) and decimates each channel into averaged values that are
+// converted to millivolts with the eFuse calibration curve (esp_adc_cal).
+// Only ADC1 pins are usable (ADC2 is taken by WiFi).
+//
+// Targets the IDF 4.4 adc_digi API used by Arduino-ESP32 2.x; on other
+// cores begin() returns false and AnalogSensor falls back to analogRead().
+class AdcScanner {
+ public:
+  static constexpr uint8_t kMaxChannels = 4;
+
+  // Register a pin before begin(). Returns the slot, or -1.
+  int8_t addPin(uint8_t pin);
+
+  // samplesPerValue: decimation factor per channel (e.g. 20 kHz / 2 pins
+  // / 1000 => one averaged value per channel every 100 ms).
+  bool begin(uint32_t sampleRateHz, uint32_t samplesPerValue);
+
+  // Drain DMA results. Cheap no-op when no block is ready.
+  void update();
+
+  bool isRunning() const { return running_; }
+
+  // Latest decimated value for a slot; false until the first block.
+  bool latest(int8_t slot, uint16_t& raw, uint32_t& milliVolts) const;
+
+  uint32_t overruns() const { return overruns_; }
+
+ private:
+  struct Channel {
+    uint8_t pin = 0;
+    uint8_t adcChannel = 0;
+    util::Decimator decimator;
+    bool hasValue = false;
+    uint16_t raw = 0;
+    uint32_t milliVolts = 0;
+  };
+
+  Channel channels_[kMaxChannels];
+  uint8_t channelCount_ = 0;
+  bool running_ = false;
+  uint32_t overruns_ = 0;
+
+  esp_adc_cal_characteristics_t calibration_;
+
+  static constexpr uint32_t kDmaBufferBytes = 4096;
+  static constexpr uint32_t kBytesPerInterrupt = 1024;
+  static constexpr uint16_t kReadChunkBytes = 256;
+};
+
+}  // namespace sensors
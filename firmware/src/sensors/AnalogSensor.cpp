@@ -2,14 +2,31 @@
 
 namespace sensors {
 
-AnalogSensor::AnalogSensor(uint8_t pin) : pin_(pin) {}
+AnalogSensor::AnalogSensor(AdcScanner& scanner, uint8_t pin)
+    : scanner_(scanner), pin_(pin) {}
 
 void AnalogSensor::begin() {
   pinMode(pin_, INPUT);
+  slot_ = scanner_.addPin(pin_);
 }
 
 int AnalogSensor::readRaw() const {
-  return analogRead(pin_);
+  uint16_t raw = 0;
+  uint32_t milliVolts = 0;
+  if (scanner_.latest(slot_, raw, milliVolts)) {
+    return raw;
+  }
+  // analogRead() must not touch ADC1 while the DMA scan owns it.
+  return scanner_.isRunning() ? -1 : analogRead(pin_);
+}
+
+uint32_t AnalogSensor::readMilliVolts() const {
+  uint16_t raw = 0;
+  uint32_t milliVolts = 0;
+  if (scanner_.latest(slot_, raw, milliVolts)) {
+    return milliVolts;
+  }
+  return scanner_.isRunning() ? 0 : analogReadMilliVolts(pin_);
 }
 
 }  // namespace sensors
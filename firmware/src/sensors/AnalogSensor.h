@@ -2,18 +2,27 @@
 
 #include <Arduino.h>
 
+#include "sensors/AdcScanner.h"
+
 namespace sensors {
 
-// Simple wrapper for ESP32 ADC reads.
+// ESP32 ADC channel. Values come from the background AdcScanner (DMA,
+// oversampled, calibrated); falls back to a single analogRead() when the
+// scanner is not running. readRaw() is -1 until the first block is ready.
 class AnalogSensor {
  public:
-  explicit AnalogSensor(uint8_t pin);
+  AnalogSensor(AdcScanner& scanner, uint8_t pin);
 
+  // Registers the pin with the scanner; call before scanner.begin().
   void begin();
+
   int readRaw() const;
+  uint32_t readMilliVolts() const;
 
  private:
+  AdcScanner& scanner_;
   const uint8_t pin_;
+  int8_t slot_ = -1;
 };
 
 }  // namespace sensors
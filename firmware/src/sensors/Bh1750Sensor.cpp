@@ -2,22 +2,141 @@
 
 namespace sensors {
 
-Bh1750Sensor::Bh1750Sensor() {}
+namespace {
+
+// BH1750 opcodes (datasheet).
+constexpr uint8_t kPowerOn = 0x01;
+constexpr uint8_t kOneTimeHighRes = 0x20;   // 1 lx resolution
+constexpr uint8_t kOneTimeHighRes2 = 0x21;  // 0.5 lx resolution
+constexpr uint8_t kOneTimeLowRes = 0x23;    // 4 lx resolution, fast
+
+// Max conversion times at default MTreg (69); typ. is 120 / 16 ms.
+constexpr uint32_t kHighResMaxMs = 180;
+constexpr uint32_t kLowResMaxMs = 24;
+
+// Auto-range thresholds on the raw 16-bit count.
+constexpr uint16_t kSaturationRaw = 60000;
+constexpr uint16_t kDarkRaw = 500;
+
+}  // namespace
+
+Bh1750Sensor::Bh1750Sensor(TwoWire& wire, uint8_t address)
+    : wire_(wire), address_(address) {}
 
 void Bh1750Sensor::begin() {
-  if (lightMeter_.begin(BH1750::CONTINUOUS_HIGH_RES_MODE)) {
+  if (writeCommand_(kPowerOn) && writeMtreg_(kDefaultMtreg)) {
     initialized_ = true;
+    mtreg_ = kDefaultMtreg;
     Serial.println("BH1750 initialized");
   } else {
     Serial.println("Error initializing BH1750");
   }
 }
 
-float Bh1750Sensor::readLux() {
+bool Bh1750Sensor::writeCommand_(uint8_t command) {
+  wire_.beginTransmission(address_);
+  wire_.write(command);
+  return wire_.endTransmission() == 0;
+}
+
+bool Bh1750Sensor::writeMtreg_(uint8_t mtreg) {
+  // MTreg is written as high 3 bits (01000_xxx) then low 5 bits (011_xxxxx).
+  return writeCommand_((uint8_t)(0x40 | (mtreg >> 5))) &&
+         writeCommand_((uint8_t)(0x60 | (mtreg & 0x1F)));
+}
+
+bool Bh1750Sensor::startConversion_(uint32_t nowMs) {
+  // High-res mode 2 only pays off when MTreg is raised for dark scenes.
+  if (mtreg_ <= kMinMtreg) {
+    mode_ = kOneTimeLowRes;
+  } else if (mtreg_ > kDefaultMtreg) {
+    mode_ = kOneTimeHighRes2;
+  } else {
+    mode_ = kOneTimeHighRes;
+  }
+
+  if (!writeCommand_(mode_)) {
+    return false;
+  }
+  const uint32_t baseMs = mode_ == kOneTimeLowRes ? kLowResMaxMs : kHighResMaxMs;
+  conversionMs_ = (baseMs * mtreg_ + kDefaultMtreg - 1) / kDefaultMtreg;
+  conversionStartMs_ = nowMs;
+  state_ = State::Converting;
+  return true;
+}
+
+bool Bh1750Sensor::readRaw_(uint16_t& raw) {
+  if (wire_.requestFrom(address_, (uint8_t)2) != 2) {
+    return false;
+  }
+  const uint8_t high = (uint8_t)wire_.read();
+  const uint8_t low = (uint8_t)wire_.read();
+  raw = ((uint16_t)high << 8) | low;
+  return true;
+}
+
+void Bh1750Sensor::autoRange_(uint16_t raw) {
+  uint8_t next = mtreg_;
+  if (raw >= kSaturationRaw && mtreg_ > kMinMtreg) {
+    next = kMinMtreg;
+  } else if (raw <= kDarkRaw && mtreg_ < kMaxMtreg) {
+    next = kMaxMtreg;
+  } else if (raw > kDarkRaw * 4 && raw < kSaturationRaw / 4 && mtreg_ != kDefaultMtreg) {
+    // Comfortably mid-range again: return to the datasheet default.
+    next = kDefaultMtreg;
+  }
+
+  if (next != mtreg_ && writeMtreg_(next)) {
+    mtreg_ = next;
+  }
+}
+
+void Bh1750Sensor::update(uint32_t nowMs) {
   if (!initialized_) {
+    return;
+  }
+
+  if (state_ == State::Idle) {
+    if (hasSample_ && nowMs - lastSampleMs_ < kSampleIntervalMs) {
+      return;
+    }
+    if (!startConversion_(nowMs)) {
+      lux_ = -1.0f;
+      lastSampleMs_ = nowMs;
+      hasSample_ = true;
+    }
+    return;
+  }
+
+  if (nowMs - conversionStartMs_ < conversionMs_) {
+    return;
+  }
+
+  state_ = State::Idle;
+  lastSampleMs_ = nowMs;
+  hasSample_ = true;
+
+  uint16_t raw = 0;
+  if (!readRaw_(raw)) {
+    lux_ = -1.0f;
+    return;
+  }
+
+  // lux = count / 1.2 * (69 / MTreg); mode 2 has twice the resolution.
+  float lux = raw / 1.2f * ((float)kDefaultMtreg / mtreg_);
+  if (mode_ == kOneTimeHighRes2) {
+    lux *= 0.5f;
+  }
+  lux_ = lux;
+
+  autoRange_(raw);
+}
+
+float Bh1750Sensor::readLux() const {
+  if (!initialized_ || !hasSample_) {
     return -1.0f;
   }
-  return lightMeter_.readLightLevel();
+  return lux_;
 }
 
 } // namespace sensors
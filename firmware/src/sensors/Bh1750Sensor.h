@@ -1,21 +1,61 @@
 #pragma once
 
 #include <Arduino.h>
-#include <BH1750.h>
+#include <Wire.h>
 
 namespace sensors {
 
+// Pipelined BH1750 driver (direct I2C, no blocking waits).
+//
+// update() runs a small state machine from a scheduler task: it triggers a
+// one-shot conversion, returns, and collects the result on a later call
+// once the conversion window (~120 ms high-res / ~16 ms low-res, scaled by
+// MTreg) has passed. The sensor powers down between samples. readLux()
+// only returns the cached value, so reading lux costs no I2C time.
+//
+// Auto-ranging: MTreg (measurement time) is raised in the dark for
+// resolution and lowered in bright light to stay below saturation.
 class Bh1750Sensor {
  public:
-  Bh1750Sensor();
+  explicit Bh1750Sensor(TwoWire& wire = Wire, uint8_t address = 0x23);
 
   void begin();
-  float readLux();
+
+  // Advance the pipeline; cheap when nothing is due.
+  void update(uint32_t nowMs);
+
+  // Latest lux value, or -1 if not initialized / no sample yet.
+  float readLux() const;
   bool isOk() const { return initialized_; }
 
+  uint8_t mtreg() const { return mtreg_; }
+
  private:
-  BH1750 lightMeter_;
+  enum class State : uint8_t { Idle, Converting };
+
+  TwoWire& wire_;
+  const uint8_t address_;
+
   bool initialized_ = false;
+  State state_ = State::Idle;
+  uint8_t mode_ = 0;
+  uint8_t mtreg_ = kDefaultMtreg;
+  uint32_t conversionStartMs_ = 0;
+  uint32_t conversionMs_ = 0;
+  uint32_t lastSampleMs_ = 0;
+  bool hasSample_ = false;
+  float lux_ = -1.0f;
+
+  static constexpr uint8_t kDefaultMtreg = 69;
+  static constexpr uint8_t kMinMtreg = 31;
+  static constexpr uint8_t kMaxMtreg = 254;
+  static constexpr uint32_t kSampleIntervalMs = 1000;
+
+  bool writeCommand_(uint8_t command);
+  bool writeMtreg_(uint8_t mtreg);
+  bool startConversion_(uint32_t nowMs);
+  bool readRaw_(uint16_t& raw);
+  void autoRange_(uint16_t raw);
 };
 
 } // namespace sensors
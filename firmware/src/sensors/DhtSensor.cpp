@@ -1,42 +1,159 @@
 #include "sensors/DhtSensor.h"
 
-#include <DHTesp.h>
-
 namespace sensors {
 
-// Static DHTesp instance to ensure it persists
-static DHTesp dhtSensor;
+namespace {
+
+// Data "1" highs are ~70 us, "0" highs ~26-28 us.
+constexpr uint32_t kBitOneThresholdUs = 48;
+
+// Response high is ~80 us; anything far outside a data/response high means
+// the capture is corrupt.
+constexpr uint32_t kMaxHighUs = 120;
+
+constexpr uint8_t kDataBits = 40;
+
+}  // namespace
 
 DhtSensor::DhtSensor(uint8_t pin) : pin_(pin) {}
 
 void DhtSensor::begin() {
-  dhtSensor.setup(pin_, DHTesp::DHT22);
-  dht_ = &dhtSensor;
+  pinMode(pin_, INPUT_PULLUP);
+
+  esp_timer_create_args_t args = {};
+  args.callback = onReleaseTimer_;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "dht_release";
+  if (esp_timer_create(&args, &releaseTimer_) != ESP_OK) {
+    releaseTimer_ = nullptr;
+    Serial.println("DHT: failed to create release timer");
+  }
 }
 
-DhtReading DhtSensor::read() {
-  DhtReading out;
-  if (dht_ == nullptr) {
-    return out;
+bool DhtSensor::startRead() {
+  if (releaseTimer_ == nullptr || state_ != State::Idle) {
+    return false;
+  }
+  const uint32_t nowMs = millis();
+  if (hasStarted_ && nowMs - lastStartMs_ < kMinIntervalMs) {
+    return false;
   }
+  hasStarted_ = true;
+  lastStartMs_ = nowMs;
+  startMs_ = nowMs;
 
-  DHTesp* dht = static_cast<DHTesp*>(dht_);
-  
-  float humidity = dht->getHumidity();
-  float temperature = dht->getTemperature();
+  edgeCount_.store(0, std::memory_order_relaxed);
+  state_ = State::StartPulse;
 
-  if (dht->getStatus() != DHTesp::ERROR_NONE) {
-    return out;
+  // Host start signal: hold the line low, the timer releases it.
+  pinMode(pin_, OUTPUT);
+  digitalWrite(pin_, LOW);
+  esp_timer_start_once(releaseTimer_, kStartPulseUs);
+  return true;
+}
+
+// esp_timer task context.
+void DhtSensor::onReleaseTimer_(void* arg) {
+  DhtSensor* self = static_cast<DhtSensor*>(arg);
+  if (self->state_ != State::StartPulse) {
+    return;
+  }
+  self->state_ = State::Capturing;
+  pinMode(self->pin_, INPUT_PULLUP);
+  attachInterruptArg(self->pin_, onEdge_, self, CHANGE);
+}
+
+void IRAM_ATTR DhtSensor::onEdge_(void* arg) {
+  DhtSensor* self = static_cast<DhtSensor*>(arg);
+  const uint8_t index = self->edgeCount_.load(std::memory_order_relaxed);
+  if (index >= kMaxEdges) {
+    return;
   }
+  self->edgeUs_[index] = micros();
+  self->levels_[index] = (uint8_t)digitalRead(self->pin_);
+  self->edgeCount_.store(index + 1, std::memory_order_release);
+}
+
+void DhtSensor::finish_() {
+  esp_timer_stop(releaseTimer_);
+  detachInterrupt(pin_);
+  pinMode(pin_, INPUT_PULLUP);
+  state_ = State::Idle;
+}
 
-  if (isnan(humidity) || isnan(temperature)) {
-    return out;
+bool DhtSensor::poll(DhtReading& out) {
+  if (state_ == State::Idle) {
+    return false;
+  }
+
+  const uint8_t edges = edgeCount_.load(std::memory_order_acquire);
+  const bool complete = edges >= 2 * kDataBits + 3;
+  const bool timedOut = millis() - startMs_ >= kTransactionTimeoutMs;
+  if (!complete && !timedOut) {
+    return false;
+  }
+
+  finish_();
+  out = DhtReading();
+  decode(edgeUs_, levels_, edgeCount_.load(std::memory_order_acquire), out);
+  return true;
+}
+
+bool DhtSensor::decode(const uint32_t* edgeUs, const uint8_t* levels, uint8_t edgeCount,
+                       DhtReading& out) {
+  out = DhtReading();
+
+  // Collect the width of every complete HIGH phase (rising -> falling).
+  // The last 40 of them are the data bits; earlier ones (response high,
+  // and possibly a glitch) are ignored, so a missed first edge is harmless.
+  uint32_t highUs[kMaxEdges / 2 + 1];
+  uint8_t highCount = 0;
+  for (uint8_t i = 0; i + 1 < edgeCount; ++i) {
+    if (levels[i] == HIGH && levels[i + 1] == LOW) {
+      if (highCount >= sizeof(highUs) / sizeof(highUs[0])) {
+        return false;
+      }
+      highUs[highCount++] = edgeUs[i + 1] - edgeUs[i];
+    }
+  }
+  if (highCount < kDataBits) {
+    return false;
+  }
+
+  uint8_t bytes[5] = {0, 0, 0, 0, 0};
+  const uint8_t firstBit = highCount - kDataBits;
+  for (uint8_t bit = 0; bit < kDataBits; ++bit) {
+    const uint32_t width = highUs[firstBit + bit];
+    if (width > kMaxHighUs) {
+      return false;
+    }
+    bytes[bit / 8] <<= 1;
+    if (width > kBitOneThresholdUs) {
+      bytes[bit / 8] |= 1;
+    }
+  }
+
+  const uint8_t checksum = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+  if (checksum != bytes[4]) {
+    return false;
+  }
+
+  const uint16_t rawHumidity = ((uint16_t)bytes[0] << 8) | bytes[1];
+  const uint16_t rawTemp = ((uint16_t)(bytes[2] & 0x7F) << 8) | bytes[3];
+  float temperature = rawTemp * 0.1f;
+  if (bytes[2] & 0x80) {
+    temperature = -temperature;
+  }
+  const float humidity = rawHumidity * 0.1f;
+  if (humidity > 100.0f || temperature < -40.0f || temperature > 80.0f) {
+    return false;
   }
 
   out.ok = true;
   out.humidityPct = humidity;
   out.temperatureC = temperature;
-  return out;
+  return true;
 }
 
 }  // namespace sensors
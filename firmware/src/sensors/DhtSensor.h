@@ -1,6 +1,9 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_timer.h>
+
+#include <atomic>
 
 namespace sensors {
 
@@ -10,18 +13,60 @@ struct DhtReading {
   float humidityPct = NAN;
 };
 
+// Non-blocking DHT22 (AM2302) driver.
+//
+// startRead() pulls the data line low and returns; an esp_timer releases it
+// after the start pulse and arms a GPIO CHANGE interrupt that timestamps
+// every edge of the sensor's reply. poll() decodes the captured pulse train
+// once it is complete (~5 ms later). Nothing blocks and interrupts are never
+// disabled, unlike bit-banged drivers.
 class DhtSensor {
  public:
+  // Max edges in one transaction: response (3) + 40 bits x 2 + release.
+  static constexpr uint8_t kMaxEdges = 90;
+
   explicit DhtSensor(uint8_t pin);
 
   void begin();
-  DhtReading read();
+
+  // Begin a transaction. False if one is already running or the sensor's
+  // 2 s minimum sampling interval has not elapsed.
+  bool startRead();
+
+  // Returns true once when the running transaction finishes; `out` then
+  // holds the result (out.ok == false on timeout / checksum error).
+  bool poll(DhtReading& out);
+
+  bool busy() const { return state_ != State::Idle; }
+
+  // Decode a captured edge trace: edgeUs[i] is the time of edge i and
+  // levels[i] the line level right after it. Pure function (no hardware).
+  static bool decode(const uint32_t* edgeUs, const uint8_t* levels, uint8_t edgeCount,
+                     DhtReading& out);
 
  private:
+  enum class State : uint8_t { Idle, StartPulse, Capturing };
+
   const uint8_t pin_;
+  volatile State state_ = State::Idle;
+
+  esp_timer_handle_t releaseTimer_ = nullptr;
+  uint32_t startMs_ = 0;
+  uint32_t lastStartMs_ = 0;
+  bool hasStarted_ = false;
+
+  // Filled by the ISR; edgeCount_ is published after the slot is written.
+  uint32_t edgeUs_[kMaxEdges];
+  uint8_t levels_[kMaxEdges];
+  std::atomic<uint8_t> edgeCount_{0};
+
+  static constexpr uint32_t kStartPulseUs = 1100;   // Datasheet: >= 1 ms
+  static constexpr uint32_t kTransactionTimeoutMs = 20;
+  static constexpr uint32_t kMinIntervalMs = 2000;
 
-  // Opaque pointer to avoid leaking DHT include into all translation units.
-  void* dht_ = nullptr;
+  static void onReleaseTimer_(void* arg);
+  static void IRAM_ATTR onEdge_(void* arg);
+  void finish_();
 };
 
 }  // namespace sensors
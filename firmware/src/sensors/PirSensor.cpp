@@ -6,10 +6,76 @@ PirSensor::PirSensor(uint8_t pin) : pin_(pin) {}
 
 void PirSensor::begin() {
   pinMode(pin_, INPUT);
+
+  const uint32_t nowMs = millis();
+  level_ = digitalRead(pin_) == HIGH;
+  isrLevel_ = level_;
+  levelSinceMs_ = nowMs;
+  windowStartMs_ = nowMs;
+
+  attachInterruptArg(pin_, onEdge_, this, CHANGE);
+}
+
+void IRAM_ATTR PirSensor::onEdge_(void* arg) {
+  PirSensor* self = static_cast<PirSensor*>(arg);
+  Edge edge;
+  edge.timeMs = millis();
+  edge.level = (uint8_t)digitalRead(self->pin_);
+  self->isrLevel_ = edge.level == HIGH;
+  self->edges_.push(edge);
 }
 
 bool PirSensor::readMotion() const {
-  return digitalRead(pin_) == HIGH;
+  return isrLevel_;
+}
+
+void PirSensor::apply_(const Edge& edge) {
+  const bool high = edge.level == HIGH;
+  if (high == level_) {
+    return;  // Bounce / duplicate level
+  }
+
+  if (level_) {
+    window_.occupiedMs += edge.timeMs - levelSinceMs_;
+  } else {
+    const uint32_t offsetMs = edge.timeMs - windowStartMs_;
+    if (!window_.hasEvent) {
+      window_.hasEvent = true;
+      window_.firstEventOffsetMs = offsetMs;
+    }
+    window_.lastEventOffsetMs = offsetMs;
+    ++window_.motionCount;
+  }
+
+  level_ = high;
+  levelSinceMs_ = edge.timeMs;
+}
+
+void PirSensor::drain() {
+  Edge edge;
+  while (edges_.pop(edge)) {
+    apply_(edge);
+  }
+}
+
+MotionWindow PirSensor::closeWindow() {
+  drain();
+  // Sampled after drain() so no processed edge is newer than nowMs.
+  const uint32_t nowMs = millis();
+
+  if (level_) {
+    window_.occupiedMs += nowMs - levelSinceMs_;
+    levelSinceMs_ = nowMs;
+  }
+
+  MotionWindow out = window_;
+  out.windowMs = nowMs - windowStartMs_;
+  out.activeNow = level_;
+  out.droppedEvents = edges_.dropped();
+
+  window_ = MotionWindow();
+  windowStartMs_ = nowMs;
+  return out;
 }
 
 }  // namespace sensors
@@ -2,17 +2,64 @@
 
 #include <Arduino.h>
 
+#include "util/SpscRing.h"
+
 namespace sensors {
 
+// Motion statistics for one telemetry window.
+struct MotionWindow {
+  uint32_t windowMs = 0;
+  uint16_t motionCount = 0;       // Rising edges (new detections)
+  bool hasEvent = false;
+  uint32_t firstEventOffsetMs = 0;  // From window start
+  uint32_t lastEventOffsetMs = 0;
+  uint32_t occupiedMs = 0;        // Time the PIR output was HIGH
+  bool activeNow = false;
+  uint32_t droppedEvents = 0;     // Edges lost to a full ring (total)
+
+  uint8_t occupancyPct() const {
+    return windowMs == 0 ? 0 : (uint8_t)((uint64_t)occupiedMs * 100 / windowMs);
+  }
+};
+
+// Interrupt-driven PIR capture.
+//
+// A CHANGE interrupt timestamps every edge into a lock-free ring, so
+// pulses shorter than the sensor-read interval are no longer missed and
+// nothing polls the pin. drain() folds queued edges into the current
+// window (cheap, call it from any periodic task); closeWindow() returns
+// the window's counts / first+last event / occupancy and starts a new one.
 class PirSensor {
  public:
   explicit PirSensor(uint8_t pin);
 
   void begin();
+
+  // Current PIR output level as last reported by the ISR.
   bool readMotion() const;
 
+  void drain();
+  MotionWindow closeWindow();
+
  private:
+  struct Edge {
+    uint32_t timeMs;
+    uint8_t level;
+  };
+
   const uint8_t pin_;
+
+  util::SpscRing<Edge, 32> edges_;
+  volatile bool isrLevel_ = false;
+
+  // Window accumulators (consumer side only).
+  uint32_t windowStartMs_ = 0;
+  bool level_ = false;
+  uint32_t levelSinceMs_ = 0;
+  MotionWindow window_;
+
+  static void IRAM_ATTR onEdge_(void* arg);
+  void apply_(const Edge& edge);
 };
 
 }  // namespace sensors
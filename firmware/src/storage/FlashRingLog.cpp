@@ -0,0 +1,301 @@
+#include "storage/FlashRingLog.h"
+
+#include "util/Crc32.h"
+
+namespace storage {
+
+namespace {
+
+constexpr uint32_t kSectorBytes = 4096;
+constexpr uint32_t kErased = 0xFFFFFFFF;
+constexpr uint32_t kMagic = 0x53474C47;      // "SGLG"
+constexpr uint32_t kCommitted = 0x5A5AA5A5;  // Any value other than erased / 0
+constexpr uint32_t kCleared = 0;
+
+// Sector header. `consumed` is cleared once every record in it was read.
+struct SectorHeader {
+  uint32_t tag;  // kMagic ^ record size
+  uint32_t seq;  // Increments by one per sector written
+  uint32_t consumed;
+};
+
+// Record slot header, followed by the record body (padded to 4 bytes).
+// Write order: crc + body, then commit. ack is cleared on consumption.
+struct RecordHeader {
+  uint32_t commit;
+  uint32_t ack;
+  uint32_t crc;
+};
+
+constexpr uint32_t kAckOffset = offsetof(RecordHeader, ack);
+constexpr uint32_t kCrcOffset = offsetof(RecordHeader, crc);
+
+}  // namespace
+
+bool FlashRingLog::begin(const char* partitionLabel, uint16_t recordSize) {
+  partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                        partitionLabel);
+  if (partition_ == nullptr || recordSize == 0) {
+    Serial.print("FlashRingLog: partition not found: ");
+    Serial.println(partitionLabel);
+    partition_ = nullptr;
+    return false;
+  }
+
+  recordSize_ = recordSize;
+  slotBytes_ = (uint16_t)(sizeof(RecordHeader) + ((recordSize + 3) & ~3u));
+  slotsPerSector_ = (uint16_t)((kSectorBytes - sizeof(SectorHeader)) / slotBytes_);
+  sectorCount_ = partition_->size / kSectorBytes;
+  layoutTag_ = kMagic ^ recordSize;
+
+  if (slotsPerSector_ == 0 || sectorCount_ < 2) {
+    Serial.println("FlashRingLog: partition too small for record size");
+    partition_ = nullptr;
+    return false;
+  }
+
+  recover_();
+
+  Serial.print("FlashRingLog: ");
+  Serial.print(sectorCount_);
+  Serial.print(" sectors x ");
+  Serial.print(slotsPerSector_);
+  Serial.print(" records, backlog ");
+  Serial.println(hasPending() ? "present" : "empty");
+  return true;
+}
+
+size_t FlashRingLog::sectorOffset_(uint32_t sector) const {
+  return (size_t)sector * kSectorBytes;
+}
+
+size_t FlashRingLog::slotOffset_(const Cursor& at) const {
+  return sectorOffset_(at.sector) + sizeof(SectorHeader) + (size_t)at.slot * slotBytes_;
+}
+
+bool FlashRingLog::readSectorHeader_(uint32_t sector, uint32_t& seq, bool& consumed) const {
+  SectorHeader header;
+  if (esp_partition_read(partition_, sectorOffset_(sector), &header, sizeof(header)) != ESP_OK) {
+    return false;
+  }
+  if (header.tag != layoutTag_ || header.seq == kErased) {
+    return false;
+  }
+  seq = header.seq;
+  consumed = header.consumed != kErased;
+  return true;
+}
+
+bool FlashRingLog::startSector_(uint32_t sector, uint32_t seq) {
+  if (esp_partition_erase_range(partition_, sectorOffset_(sector), kSectorBytes) != ESP_OK) {
+    return false;
+  }
+  ++stats_.erases;
+
+  SectorHeader header;
+  header.tag = layoutTag_;
+  header.seq = seq;
+  header.consumed = kErased;
+  // `consumed` stays erased so it can be cleared later without an erase.
+  return esp_partition_write(partition_, sectorOffset_(sector), &header,
+                             offsetof(SectorHeader, consumed)) == ESP_OK;
+}
+
+void FlashRingLog::markSectorConsumed_(uint32_t sector) {
+  const uint32_t cleared = kCleared;
+  esp_partition_write(partition_, sectorOffset_(sector) + offsetof(SectorHeader, consumed),
+                      &cleared, sizeof(cleared));
+}
+
+// Rebuild cursors after boot. Valid sectors form one circular run of
+// consecutive sequence numbers ending at the newest (write) sector.
+void FlashRingLog::recover_() {
+  bool found = false;
+  uint32_t headSector = 0;
+  uint32_t headSeq = 0;
+  for (uint32_t s = 0; s < sectorCount_; ++s) {
+    uint32_t seq;
+    bool consumed;
+    if (readSectorHeader_(s, seq, consumed) && (!found || seq > headSeq)) {
+      found = true;
+      headSector = s;
+      headSeq = seq;
+    }
+  }
+
+  if (!found) {
+    startSector_(0, 1);
+    write_ = Cursor();
+    writeSectorSeq_ = 1;
+    read_ = write_;
+    return;
+  }
+
+  // Write cursor: first never-written slot of the head sector.
+  write_.sector = headSector;
+  write_.slot = 0;
+  writeSectorSeq_ = headSeq;
+  for (; write_.slot < slotsPerSector_; ++write_.slot) {
+    RecordHeader header;
+    esp_partition_read(partition_, slotOffset_(write_), &header, sizeof(header));
+    if (header.commit == kErased && header.crc == kErased && header.ack == kErased) {
+      break;
+    }
+  }
+
+  // Oldest sector of the run: walk backwards while sequence numbers chain.
+  uint32_t tail = headSector;
+  uint32_t tailSeq = headSeq;
+  for (uint32_t i = 1; i < sectorCount_; ++i) {
+    const uint32_t prev = (tail + sectorCount_ - 1) % sectorCount_;
+    uint32_t seq;
+    bool consumed;
+    if (!readSectorHeader_(prev, seq, consumed) || seq != tailSeq - 1) {
+      break;
+    }
+    tail = prev;
+    tailSeq = seq;
+  }
+
+  // Read cursor: first sector not marked consumed, after its last acked record.
+  read_.sector = headSector;
+  read_.slot = 0;
+  for (uint32_t s = tail;; s = nextSector_(s)) {
+    uint32_t seq;
+    bool consumed;
+    if (s == headSector || (readSectorHeader_(s, seq, consumed) && !consumed)) {
+      read_.sector = s;
+      break;
+    }
+  }
+  const uint16_t scanEnd = read_.sector == write_.sector ? write_.slot : slotsPerSector_;
+  Cursor c;
+  c.sector = read_.sector;
+  for (c.slot = 0; c.slot < scanEnd; ++c.slot) {
+    uint32_t ack = kErased;
+    esp_partition_read(partition_, slotOffset_(c) + kAckOffset, &ack, sizeof(ack));
+    if (ack != kErased) {
+      read_.slot = (uint16_t)(c.slot + 1);
+    }
+  }
+  normalize_(read_);
+}
+
+bool FlashRingLog::atWriteEnd_(const Cursor& at) const {
+  return at.sector == write_.sector && at.slot >= write_.slot;
+}
+
+void FlashRingLog::normalize_(Cursor& at) const {
+  if (at.slot >= slotsPerSector_ && at.sector != write_.sector) {
+    at.sector = nextSector_(at.sector);
+    at.slot = 0;
+  }
+}
+
+void FlashRingLog::advanceWriteSector_() {
+  const uint32_t next = nextSector_(write_.sector);
+
+  if (read_.sector == next) {
+    // Full: the oldest sector is about to be erased.
+    stats_.dropped += slotsPerSector_ - read_.slot;
+    read_.sector = nextSector_(next);
+    read_.slot = 0;
+    hasPeek_ = false;
+  }
+
+  startSector_(next, ++writeSectorSeq_);
+  write_.sector = next;
+  write_.slot = 0;
+  normalize_(read_);
+}
+
+bool FlashRingLog::append(const void* record) {
+  if (!ready()) {
+    return false;
+  }
+  if (write_.slot >= slotsPerSector_) {
+    advanceWriteSector_();
+  }
+
+  const size_t offset = slotOffset_(write_);
+  ++write_.slot;  // A failed write still consumes the slot (never rewritten).
+
+  const uint32_t crc = util::crc32(record, recordSize_);
+  if (esp_partition_write(partition_, offset + kCrcOffset, &crc, sizeof(crc)) != ESP_OK ||
+      esp_partition_write(partition_, offset + sizeof(RecordHeader), record, recordSize_) != ESP_OK) {
+    return false;
+  }
+  const uint32_t commit = kCommitted;
+  if (esp_partition_write(partition_, offset, &commit, sizeof(commit)) != ESP_OK) {
+    return false;
+  }
+  ++stats_.appended;
+  return true;
+}
+
+bool FlashRingLog::hasPending() const {
+  return ready() && !atWriteEnd_(read_);
+}
+
+size_t FlashRingLog::peek(void* out, size_t maxRecords) {
+  hasPeek_ = false;
+  peekCount_ = 0;
+  peekCorrupt_ = 0;
+  if (!ready()) {
+    return 0;
+  }
+
+  uint8_t* dst = static_cast<uint8_t*>(out);
+  Cursor c = read_;
+  while (peekCount_ < maxRecords && !atWriteEnd_(c)) {
+    if (c.slot >= slotsPerSector_) {
+      normalize_(c);
+      continue;
+    }
+
+    RecordHeader header;
+    const size_t offset = slotOffset_(c);
+    esp_partition_read(partition_, offset, &header, sizeof(header));
+    if (header.commit == kCommitted) {
+      esp_partition_read(partition_, offset + sizeof(RecordHeader), dst, recordSize_);
+      if (util::crc32(dst, recordSize_) == header.crc) {
+        dst += recordSize_;
+        ++peekCount_;
+      } else {
+        ++peekCorrupt_;
+      }
+    } else {
+      ++peekCorrupt_;  // Torn write (reset between body and commit)
+    }
+    // Skipped slots are acked with the batch, so a torn slot at the end of
+    // the log does not keep hasPending() true forever.
+    peekLast_ = c;
+    hasPeek_ = true;
+    ++c.slot;
+  }
+
+  normalize_(c);
+  peekEnd_ = c;
+  return peekCount_;
+}
+
+void FlashRingLog::consumePeeked() {
+  if (!hasPeek_) {
+    return;
+  }
+  hasPeek_ = false;
+
+  // Sectors first, then the ack: a reset in between replays (duplicates)
+  // part of this batch instead of losing it.
+  for (uint32_t s = read_.sector; s != peekEnd_.sector; s = nextSector_(s)) {
+    markSectorConsumed_(s);
+  }
+  const uint32_t cleared = kCleared;
+  esp_partition_write(partition_, slotOffset_(peekLast_) + kAckOffset, &cleared, sizeof(cleared));
+
+  read_ = peekEnd_;
+  stats_.consumed += peekCount_;
+  stats_.corrupt += peekCorrupt_;  // Acked now, so never scanned again
+}
+
+}  // namespace storage
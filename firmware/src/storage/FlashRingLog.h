@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+namespace storage {
+
+// Append-only log of fixed-size records in a raw flash data partition.
+//
+// The partition is used as a ring of 4 KB sectors. A sector is erased only
+// when the writer wraps around to it, so all sectors wear evenly without a
+// filesystem. Records are never rewritten; crash safety relies on NOR flash
+// writes only clearing bits:
+//
+// - A record body is written before its commit word, so a write torn by a
+//   reset is detected (and skipped) on the next boot.
+// - Consumption is recorded by clearing the ack word of the last consumed
+//   record and the "consumed" word of every fully drained sector.
+//
+// begin() rebuilds the write and read cursors from the sector headers plus
+// the records of two sectors, so RAM use is a few cursors regardless of the
+// partition size. When the log is full the oldest sector is erased and its
+// unread records are dropped (newest data wins).
+class FlashRingLog {
+ public:
+  struct Stats {
+    uint32_t appended = 0;
+    uint32_t consumed = 0;
+    uint32_t dropped = 0;  // Unread records lost to wrap-around (approx.)
+    uint32_t corrupt = 0;  // Torn / CRC-failed records skipped (counted once)
+    uint32_t erases = 0;
+  };
+
+  // recordSize must be the same on every boot; a different size (or a
+  // partition never used by this log) starts an empty log.
+  bool begin(const char* partitionLabel, uint16_t recordSize);
+  bool ready() const { return partition_ != nullptr; }
+
+  bool append(const void* record);
+
+  bool hasPending() const;
+
+  // Copies up to maxRecords of the oldest unconsumed records into `out`
+  // (recordSize bytes each) without consuming them. Returns the count.
+  size_t peek(void* out, size_t maxRecords);
+  // Consumes everything returned by the last peek(), plus the unreadable
+  // slots it skipped (also when it returned 0).
+  void consumePeeked();
+
+  const Stats& stats() const { return stats_; }
+  uint32_t sectorCount() const { return sectorCount_; }
+  uint16_t recordsPerSector() const { return slotsPerSector_; }
+
+ private:
+  struct Cursor {
+    uint32_t sector = 0;
+    uint16_t slot = 0;
+  };
+
+  const esp_partition_t* partition_ = nullptr;
+  uint16_t recordSize_ = 0;
+  uint16_t slotBytes_ = 0;
+  uint16_t slotsPerSector_ = 0;
+  uint32_t sectorCount_ = 0;
+  uint32_t layoutTag_ = 0;
+
+  Cursor write_;
+  uint32_t writeSectorSeq_ = 0;
+  Cursor read_;
+
+  bool hasPeek_ = false;
+  Cursor peekLast_;  // Last slot scanned by peek() (good or skipped)
+  Cursor peekEnd_;   // Read cursor after consumePeeked()
+  uint32_t peekCount_ = 0;
+  uint32_t peekCorrupt_ = 0;
+
+  Stats stats_;
+
+  uint32_t nextSector_(uint32_t sector) const { return (sector + 1) % sectorCount_; }
+  size_t sectorOffset_(uint32_t sector) const;
+  size_t slotOffset_(const Cursor& at) const;
+
+  bool readSectorHeader_(uint32_t sector, uint32_t& seq, bool& consumed) const;
+  bool startSector_(uint32_t sector, uint32_t seq);
+  void markSectorConsumed_(uint32_t sector);
+  void advanceWriteSector_();
+  bool atWriteEnd_(const Cursor& at) const;
+  // Moves a cursor sitting past the last slot onto the next sector.
+  void normalize_(Cursor& at) const;
+
+  void recover_();
+};
+
+}  // namespace storage
@@ -0,0 +1,144 @@
+#include "thingsboard/MqttSocket.h"
+
+namespace tb {
+
+void MqttSocket::primeHandshake(const uint8_t* connack, uint8_t length) {
+  if (length > kMaxReplay) {
+    length = kMaxReplay;
+  }
+  memcpy(replay_, connack, length);
+  replayLength_ = length;
+  replayPos_ = 0;
+  swallowNextWrite_ = true;
+  rxStage_ = RxStage::Header;  // New session: CONNACK is the next frame
+}
+
+void MqttSocket::clearHandshake() {
+  swallowNextWrite_ = false;
+  replayLength_ = 0;
+  replayPos_ = 0;
+}
+
+int MqttSocket::connect(IPAddress ip, uint16_t port) {
+  return inner_->connect(ip, port);
+}
+
+int MqttSocket::connect(const char* host, uint16_t port) {
+  return inner_->connect(host, port);
+}
+
+int MqttSocket::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  (void)timeoutMs;  // Not part of Client on every core version
+  return inner_->connect(ip, port);
+}
+
+int MqttSocket::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  (void)timeoutMs;
+  return inner_->connect(host, port);
+}
+
+size_t MqttSocket::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t MqttSocket::write(const uint8_t* buf, size_t size) {
+  if (swallowNextWrite_) {
+    // PubSubClient's CONNECT: already sent by the connect state machine.
+    swallowNextWrite_ = false;
+    return size;
+  }
+  return inner_->write(buf, size);
+}
+
+int MqttSocket::available() {
+  if (replayPos_ < replayLength_) {
+    return replayLength_ - replayPos_;
+  }
+  return inner_->available();
+}
+
+int MqttSocket::read() {
+  const int b = replayPos_ < replayLength_ ? replay_[replayPos_++] : inner_->read();
+  if (b >= 0) {
+    observe_((uint8_t)b);
+  }
+  return b;
+}
+
+int MqttSocket::read(uint8_t* buf, size_t size) {
+  size_t n = 0;
+  while (n < size && replayPos_ < replayLength_) {
+    buf[n++] = replay_[replayPos_++];
+  }
+  if (n < size) {
+    const int rest = inner_->read(buf + n, size - n);
+    if (rest > 0) {
+      n += rest;
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    observe_(buf[i]);
+  }
+  return (int)n;
+}
+
+// Every byte PubSubClient consumes passes through here in order.
+void MqttSocket::observe_(uint8_t b) {
+  switch (rxStage_) {
+    case RxStage::Header:
+      rxType_ = b & 0xF0;
+      rxRemaining_ = 0;
+      rxLengthShift_ = 0;
+      rxBodyPos_ = 0;
+      rxPacketId_ = 0;
+      rxStage_ = RxStage::Length;
+      break;
+
+    case RxStage::Length:
+      rxRemaining_ |= (uint32_t)(b & 0x7F) << rxLengthShift_;
+      rxLengthShift_ += 7;
+      if ((b & 0x80) == 0) {
+        rxStage_ = rxRemaining_ > 0 ? RxStage::Body : RxStage::Header;
+      }
+      break;
+
+    case RxStage::Body:
+      if (rxBodyPos_ < 2) {
+        rxPacketId_ = (uint16_t)((rxPacketId_ << 8) | b);
+        ++rxBodyPos_;
+      }
+      if (--rxRemaining_ == 0) {
+        if (rxType_ == 0x40 && rxBodyPos_ == 2 && pubackHandler_ != nullptr) {
+          pubackHandler_(rxPacketId_);  // PUBACK
+        }
+        rxStage_ = RxStage::Header;
+      }
+      break;
+  }
+}
+
+int MqttSocket::peek() {
+  if (replayPos_ < replayLength_) {
+    return replay_[replayPos_];
+  }
+  return inner_->peek();
+}
+
+void MqttSocket::flush() {
+  inner_->flush();
+}
+
+void MqttSocket::stop() {
+  clearHandshake();
+  inner_->stop();
+}
+
+uint8_t MqttSocket::connected() {
+  return inner_->connected();
+}
+
+MqttSocket::operator bool() {
+  return (bool)*inner_;
+}
+
+}  // namespace tb
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+namespace tb {
+
+// Client decorator between PubSubClient and the transport (plain TCP
+// WiFiClient or TlsSocket).
+//
+// PubSubClient::connect() writes CONNECT and then busy-waits (up to the
+// socket timeout) for CONNACK. ThingsBoardClient performs that exchange
+// itself, one non-blocking step per loop, and then primes this socket so
+// PubSubClient's connect() completes at once: the CONNECT it writes is
+// swallowed (already sent) and the CONNACK that was already received is
+// replayed to it. Outside of that handshake every call is forwarded.
+//
+// It also follows the MQTT framing of everything PubSubClient reads and
+// reports PUBACKs, which PubSubClient itself silently discards.
+class MqttSocket : public Client {
+ public:
+  using PubackHandler = void (*)(uint16_t packetId);
+
+  explicit MqttSocket(Client& inner) : inner_(&inner) {}
+
+  void setPubackHandler(PubackHandler handler) { pubackHandler_ = handler; }
+
+  Client& inner() { return *inner_; }
+  void setInner(Client& inner) { inner_ = &inner; }
+
+  // Arm for the next PubSubClient::connect() call.
+  void primeHandshake(const uint8_t* connack, uint8_t length);
+  void clearHandshake();
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  // Pure virtual in newer Arduino-ESP32 cores; plain overloads otherwise.
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+ private:
+  static constexpr uint8_t kMaxReplay = 4;  // CONNACK is 4 bytes
+
+  Client* inner_;
+  bool swallowNextWrite_ = false;
+  uint8_t replay_[kMaxReplay];
+  uint8_t replayLength_ = 0;
+  uint8_t replayPos_ = 0;
+
+  // Inbound frame tracker (fixed header, remaining length, body).
+  enum class RxStage : uint8_t { Header, Length, Body };
+  RxStage rxStage_ = RxStage::Header;
+  uint8_t rxType_ = 0;
+  uint8_t rxLengthShift_ = 0;
+  uint32_t rxRemaining_ = 0;
+  uint8_t rxBodyPos_ = 0;
+  uint16_t rxPacketId_ = 0;
+  PubackHandler pubackHandler_ = nullptr;
+
+  void observe_(uint8_t b);
+};
+
+}  // namespace tb
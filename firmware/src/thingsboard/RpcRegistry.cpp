@@ -0,0 +1,54 @@
+#include "thingsboard/RpcRegistry.h"
+
+namespace tb {
+
+const RpcMethod* findRpcMethod(const RpcMethod* table, size_t count, const char* name) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp = strcmp(name, table[mid].name);
+    if (cmp == 0) {
+      return &table[mid];
+    }
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return nullptr;
+}
+
+const char* extractRpcArgs(RpcParam type, JsonVariantConst params, RpcArgs& args) {
+  args.raw = params;
+  switch (type) {
+    case RpcParam::None:
+      return nullptr;
+
+    case RpcParam::Bool:
+      if (!params.is<bool>()) {
+        return "params: expected true/false";
+      }
+      args.flag = params.as<bool>();
+      return nullptr;
+
+    case RpcParam::Number:
+      // Integers are accepted as numbers too.
+      if (!params.is<float>()) {
+        return "params: expected a number";
+      }
+      args.number = params.as<float>();
+      return nullptr;
+
+    case RpcParam::Integer:
+      if (!params.is<int32_t>()) {
+        return "params: expected an integer";
+      }
+      args.integer = params.as<int32_t>();
+      return nullptr;
+  }
+  return "params: unsupported type";
+}
+
+}  // namespace tb
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "util/JsonWriter.h"
+
+namespace tb {
+
+// Parameter type an RPC method expects in "params".
+enum class RpcParam : uint8_t { None, Bool, Number, Integer };
+
+// Typed "params", extracted and checked before the handler runs.
+struct RpcArgs {
+  bool flag = false;      // RpcParam::Bool
+  float number = 0.0f;    // RpcParam::Number
+  int32_t integer = 0;    // RpcParam::Integer
+  JsonVariantConst raw;   // Always set
+};
+
+// Fills `reply` (an open JSON object, "ok" already written) with result
+// fields. Returns nullptr on success or a static error message, which is
+// sent back as {"ok":false,"error":...}.
+using RpcMethodHandler = const char* (*)(const RpcArgs& args, util::JsonWriter& reply);
+
+struct RpcMethod {
+  const char* name;
+  RpcParam param;
+  RpcMethodHandler handler;
+};
+
+// Method tables are looked up by binary search (O(log n) string compares,
+// no hashing or allocation), so they must be sorted by name, in strcmp()
+// order. Check it at compile time:
+//
+//   constexpr tb::RpcMethod kRpcMethods[] = {...};
+//   static_assert(tb::rpcTableSorted(kRpcMethods), "...");
+constexpr int rpcNameCompare(const char* a, const char* b) {
+  return (*a != *b || *a == '\0') ? (int)(unsigned char)*a - (int)(unsigned char)*b
+                                  : rpcNameCompare(a + 1, b + 1);
+}
+
+constexpr bool rpcTableSorted(const RpcMethod* table, size_t count) {
+  return count < 2 ||
+         (rpcNameCompare(table[0].name, table[1].name) < 0 && rpcTableSorted(table + 1, count - 1));
+}
+
+template <size_t N>
+constexpr bool rpcTableSorted(const RpcMethod (&table)[N]) {
+  return rpcTableSorted(table, N);
+}
+
+const RpcMethod* findRpcMethod(const RpcMethod* table, size_t count, const char* name);
+
+// Checks `params` against `type`; returns nullptr or an error message.
+const char* extractRpcArgs(RpcParam type, JsonVariantConst params, RpcArgs& args);
+
+}  // namespace tb
@@ -1,11 +1,20 @@
 #include "thingsboard/ThingsBoardClient.h"
 
+#include <esp_system.h>
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+#include <lwip/tcpip.h>
+
+#include "util/JsonWriter.h"
+#include "util/Log.h"
+#include "util/PerfMonitor.h"
+
 namespace tb {
 
 ThingsBoardClient *ThingsBoardClient::active_ = nullptr;
 
-ThingsBoardClient::ThingsBoardClient(Client &networkClient)
-    : mqtt_(networkClient) {}
+ThingsBoardClient::ThingsBoardClient(WiFiClient &socket)
+    : tcp_(socket), socket_(socket), mqtt_(socket_) {}
 
 void ThingsBoardClient::begin(const char *host, uint16_t port,
                               const char *accessToken) {
@@ -14,45 +23,586 @@ void ThingsBoardClient::begin(const char *host, uint16_t port,
   accessToken_ = accessToken;
 
   mqtt_.setServer(host_, port_);
-  mqtt_.setBufferSize(512);
-  mqtt_.setKeepAlive(60);
-  mqtt_.setSocketTimeout(15);  // Increase socket timeout for Wokwi gateway
+  // Only inbound messages and outbound headers go through this buffer;
+  // outbound payloads are streamed (see flushOutbound_()).
+  mqtt_.setBufferSize(kMaxInboundPayload + 128);
+  mqtt_.setKeepAlive(kKeepAliveSec_);
+  // Only bounds reads of a partially received packet in loop(); the connect
+  // handshake has its own non-blocking timeouts (see stepConnect_()).
+  mqtt_.setSocketTimeout(15);
+
+  rpcFilter_["method"] = true;
+  rpcFilter_["params"] = true;
 
   active_ = this;
   mqtt_.setCallback(mqttCallback_);
+  socket_.setPubackHandler(pubackCallback_);
+}
+
+bool ThingsBoardClient::setTls(const char *caPem) {
+  if (!tls_.configure(caPem)) {
+    SG_LOGE("ThingsBoard TLS disabled (configuration failed)");
+    return false;
+  }
+  useTls_ = true;
+  socket_.setInner(tls_);
+  return true;
 }
 
-void ThingsBoardClient::loop() { mqtt_.loop(); }
+void ThingsBoardClient::setTelemetryQos1(bool enabled, uint8_t window) {
+  qos1Enabled_ = enabled;
+  qos1Window_ = window > 0 ? window : 1;
+}
 
-bool ThingsBoardClient::isConnected() { return mqtt_.connected(); }
+uint32_t ThingsBoardClient::ackLatencyAvgMs() const {
+  const uint32_t acked = qos1Acked_.load(std::memory_order_relaxed);
+  return acked > 0 ? ackLatencySumMs_.load(std::memory_order_relaxed) / acked : 0;
+}
 
-void ThingsBoardClient::setRpcHandler(RpcHandler handler) {
-  rpcHandler_ = handler;
+void ThingsBoardClient::loop() {
+  mqtt_.loop();
+  flushOutbound_();
+  connected_.store(connectState_ == ConnectState::Connected && mqtt_.connected(),
+                   std::memory_order_release);
+}
+
+bool ThingsBoardClient::isConnected() const {
+  return connected_.load(std::memory_order_acquire);
+}
+
+uint32_t ThingsBoardClient::connectionCount() const {
+  return connectionCount_.load(std::memory_order_acquire);
+}
+
+void ThingsBoardClient::setRpcMethods(const RpcMethod *table, size_t count) {
+  rpcMethods_ = table;
+  rpcMethodCount_ = count;
 }
 
 void ThingsBoardClient::setAttributesHandler(AttributesHandler handler) {
   attributesHandler_ = handler;
 }
 
-bool ThingsBoardClient::requestSharedAttributes(uint32_t requestId,
-                                                const char *keysCsv) {
-  if (!mqtt_.connected()) {
+bool ThingsBoardClient::setAttributeKeys(const char *keysCsv) {
+  attrFilter_.clear();
+  attrFiltered_ = false;
+  if (keysCsv == nullptr || keysCsv[0] == '\0') {
+    return true;
+  }
+
+  // Responses nest the keys under "shared"/"client"; updates are flat.
+  JsonObject shared = attrFilter_["shared"].to<JsonObject>();
+  JsonObject client = attrFilter_["client"].to<JsonObject>();
+  const char *start = keysCsv;
+  while (*start != '\0') {
+    const char *end = strchr(start, ',');
+    const size_t length = end != nullptr ? (size_t)(end - start) : strlen(start);
+    char key[48];
+    if (length > 0 && length < sizeof(key)) {
+      memcpy(key, start, length);
+      key[length] = '\0';
+      attrFilter_[key] = true;
+      shared[key] = true;
+      client[key] = true;
+    }
+    start += length;
+    if (*start == ',') {
+      ++start;
+    }
+  }
+
+  if (attrFilter_.overflowed()) {
+    // Fail open: an incomplete filter would silently drop settings.
+    SG_LOGW("Attribute filter does not fit; parsing unfiltered");
+    attrFilter_.clear();
     return false;
   }
+  attrFiltered_ = true;
+  SG_LOGI("Attribute filter: %u bytes", (unsigned)filterAllocator_.used());
+  return true;
+}
+
+void ThingsBoardClient::setAttributeRequestPolicy(uint32_t timeoutMs, uint32_t backoffMinMs,
+                                                  uint32_t backoffMaxMs, uint8_t maxAttempts) {
+  attrTimeoutMs_ = timeoutMs > 0 ? timeoutMs : 1;
+  attrBackoffMinMs_ = backoffMinMs > 0 ? backoffMinMs : 1;
+  attrBackoffMaxMs_ = backoffMaxMs > attrBackoffMinMs_ ? backoffMaxMs : attrBackoffMinMs_;
+  attrMaxAttempts_ = maxAttempts;
+}
+
+bool ThingsBoardClient::requestSharedAttributes(const char *keysCsv) {
   if (keysCsv == nullptr || keysCsv[0] == '\0') {
     return false;
   }
 
-  char topic[96];
-  snprintf(topic, sizeof(topic), "v1/devices/me/attributes/request/%lu",
-           (unsigned long)requestId);
+  PendingAttrRequest *freeEntry = nullptr;
+  for (PendingAttrRequest &request : attrRequests_) {
+    if (request.state == PendingAttrRequest::State::Free) {
+      if (freeEntry == nullptr) {
+        freeEntry = &request;
+      }
+    } else if (request.keysCsv == keysCsv || strcmp(request.keysCsv, keysCsv) == 0) {
+      // Same keys already outstanding: send again now, same id.
+      request.state = PendingAttrRequest::State::Send;
+      request.sendAtMs = millis();
+      return true;
+    }
+  }
+  if (freeEntry == nullptr) {
+    return false;
+  }
 
-  JsonDocument doc;
-  doc["sharedKeys"] = keysCsv;
+  freeEntry->state = PendingAttrRequest::State::Send;
+  freeEntry->attempts = 0;
+  freeEntry->requestId = nextAttrRequestId_++;
+  freeEntry->keysCsv = keysCsv;
+  freeEntry->sendAtMs = millis();
+  freeEntry->backoffMs = attrBackoffMinMs_;
+  serviceAttrRequests_(freeEntry->sendAtMs);
+  return true;
+}
 
-  String payload;
-  serializeJson(doc, payload);
-  return mqtt_.publish(topic, payload.c_str());
+bool ThingsBoardClient::attributeRequestPending(const char *keysCsv) const {
+  for (const PendingAttrRequest &request : attrRequests_) {
+    if (request.state != PendingAttrRequest::State::Free &&
+        (request.keysCsv == keysCsv || strcmp(request.keysCsv, keysCsv) == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThingsBoardClient::sendAttrRequest_(const PendingAttrRequest &request) {
+  if (!beginOutbound_(OutboundMessage::Kind::AttributeRequest, request.requestId)) {
+    return false;
+  }
+  util::JsonWriter json(stream_);
+  json.beginObject();
+  json.addString("sharedKeys", request.keysCsv);
+  json.endObject();
+  if (!json.ok()) {
+    abortPublish();
+    return false;
+  }
+  return endOutbound_();
+}
+
+// App side: sends due requests and turns missing responses into retries.
+void ThingsBoardClient::serviceAttrRequests_(uint32_t nowMs) {
+  const bool online = isConnected();
+  const uint32_t connection = connectionCount();
+
+  for (PendingAttrRequest &request : attrRequests_) {
+    switch (request.state) {
+      case PendingAttrRequest::State::Free:
+        break;
+
+      case PendingAttrRequest::State::AwaitResponse:
+        // The link dropped since the send: the response is lost with the
+        // old session, so re-send once reconnected (not a timeout).
+        if (request.connection != connection) {
+          request.state = PendingAttrRequest::State::Send;
+          request.sendAtMs = nowMs;
+          break;
+        }
+        if ((nowMs - request.sentMs) < attrTimeoutMs_) {
+          break;
+        }
+        ++attrTimeouts_;
+        ++request.attempts;
+        if (attrMaxAttempts_ > 0 && request.attempts >= attrMaxAttempts_) {
+          ++attrFailed_;
+          SG_LOGW("Attribute request %u abandoned: no response", request.requestId);
+          request.state = PendingAttrRequest::State::Free;
+          break;
+        }
+        // Equal jitter, as for WiFi reconnects.
+        {
+          const uint32_t half = request.backoffMs / 2;
+          request.sendAtMs = nowMs + half + (half > 0 ? esp_random() % (half + 1) : 0);
+          request.backoffMs =
+              request.backoffMs >= attrBackoffMaxMs_ / 2 ? attrBackoffMaxMs_ : request.backoffMs * 2;
+        }
+        request.state = PendingAttrRequest::State::Send;
+        SG_LOGW("Attribute request %u timed out; retrying", request.requestId);
+        break;
+
+      case PendingAttrRequest::State::Send:
+        if (!online || (int32_t)(nowMs - request.sendAtMs) < 0) {
+          break;
+        }
+        // Outbound ring full: try again on the next call.
+        if (sendAttrRequest_(request)) {
+          request.state = PendingAttrRequest::State::AwaitResponse;
+          request.sentMs = nowMs;
+          request.connection = connection;
+        }
+        break;
+    }
+  }
+}
+
+bool ThingsBoardClient::completeAttrRequest_(uint32_t requestId, uint32_t nowMs) {
+  for (PendingAttrRequest &request : attrRequests_) {
+    if (request.state == PendingAttrRequest::State::Free || request.requestId != requestId) {
+      continue;
+    }
+    // Measured from the latest send; an answer to an earlier send of
+    // the same id arrives "early" and reads short, never too long.
+    if (request.state == PendingAttrRequest::State::AwaitResponse) {
+      attrRttLastMs_ = nowMs - request.sentMs;
+      if (attrRttLastMs_ > attrRttMaxMs_) {
+        attrRttMaxMs_ = attrRttLastMs_;
+      }
+    }
+    request.state = PendingAttrRequest::State::Free;
+    return true;
+  }
+  ++attrUnmatched_;
+  return false;
+}
+
+bool ThingsBoardClient::sendTelemetryJson(const char *json) {
+  if (!isConnected()) {
+    return false;
+  }
+  if (json == nullptr || json[0] == '\0') {
+    return false;
+  }
+  return enqueueOutbound_(OutboundMessage::Kind::Telemetry, 0, json);
+}
+
+Print *ThingsBoardClient::beginTelemetryPublish() {
+  if (!isConnected()) {
+    return nullptr;
+  }
+  if (!beginOutbound_(OutboundMessage::Kind::Telemetry, 0)) {
+    return nullptr;
+  }
+  return &stream_;
+}
+
+bool ThingsBoardClient::endPublish(bool trackDelivery) { return endOutbound_(trackDelivery); }
+
+void ThingsBoardClient::abortPublish() { streamActive_ = false; }
+
+size_t ThingsBoardClient::OutboundStream::write(uint8_t c) {
+  return owner_.writeOutbound_(&c, 1);
+}
+
+size_t ThingsBoardClient::OutboundStream::write(const uint8_t *data,
+                                                size_t size) {
+  return owner_.writeOutbound_(data, size);
+}
+
+bool ThingsBoardClient::enqueueOutbound_(OutboundMessage::Kind kind,
+                                         uint32_t requestId,
+                                         const char *payload) {
+  if (!beginOutbound_(kind, requestId)) {
+    return false;
+  }
+  writeOutbound_((const uint8_t *)payload, strlen(payload));
+  return endOutbound_();
+}
+
+bool ThingsBoardClient::beginOutbound_(OutboundMessage::Kind kind,
+                                       uint32_t requestId) {
+  if (streamActive_) {
+    SG_LOGW("MQTT outbound publish already open; dropped");
+    outbound_.noteDropped();
+    return false;
+  }
+  streamActive_ = true;
+  streamOverflow_ = false;
+  streamKind_ = kind;
+  streamRequestId_ = requestId;
+  streamLength_ = 0;
+  return true;
+}
+
+// Fills slots past the ring head without committing them; the network side
+// only sees the message once endOutbound_() commits every fragment at once.
+size_t ThingsBoardClient::writeOutbound_(const uint8_t *data, size_t size) {
+  if (!streamActive_ || streamOverflow_) {
+    return 0;
+  }
+
+  size_t written = 0;
+  while (written < size) {
+    const uint32_t fragment = streamLength_ / kOutboundFragmentBytes;
+    const uint32_t offset = streamLength_ % kOutboundFragmentBytes;
+    OutboundMessage *slot = outbound_.producerSlotAt(fragment);
+    if (slot == nullptr) {
+      // Payload larger than the ring, or the network side is behind.
+      streamOverflow_ = true;
+      break;
+    }
+
+    size_t chunk = size - written;
+    if (chunk > kOutboundFragmentBytes - offset) {
+      chunk = kOutboundFragmentBytes - offset;
+    }
+    memcpy(slot->payload + offset, data + written, chunk);
+    slot->length = (uint16_t)(offset + chunk);
+    written += chunk;
+    streamLength_ += chunk;
+  }
+  return written;
+}
+
+bool ThingsBoardClient::endOutbound_(bool tracked) {
+  if (!streamActive_) {
+    return false;
+  }
+  streamActive_ = false;
+
+  if (streamOverflow_ || streamLength_ == 0) {
+    SG_LOGW("MQTT outbound payload %s; dropped",
+            streamOverflow_ ? "too large or queue full" : "empty");
+    outbound_.noteDropped();
+    return false;
+  }
+
+  const uint32_t fragments =
+      (streamLength_ + kOutboundFragmentBytes - 1) / kOutboundFragmentBytes;
+  OutboundMessage *first = outbound_.producerSlot();
+  first->kind = streamKind_;
+  first->requestId = streamRequestId_;
+  first->fragmentCount = (uint8_t)fragments;
+  first->totalLength = streamLength_;
+  first->tracked = tracked;
+  if (tracked) {
+    trackedDelivery_.store(Delivery::Pending, std::memory_order_relaxed);
+  }
+  outbound_.commitPush(fragments);
+  return true;
+}
+
+void ThingsBoardClient::flushOutbound_() {
+  const bool online = connectState_ == ConnectState::Connected && mqtt_.connected();
+  const uint32_t nowMs = millis();
+
+  if (online && resendPending_) {
+    resendPending_ = false;
+    resendUnacked_();
+  }
+
+  // Send queued messages past the ones already in flight.
+  OutboundMessage *msg = outbound_.consumerSlotAt(sentSlots_);
+  while (msg != nullptr && inFlightCount_ < kOutboundDepth) {
+    const bool qos1 = qos1Enabled_ && msg->kind == OutboundMessage::Kind::Telemetry;
+    if (qos1 && (!online || qos1Pending_ >= qos1Window_)) {
+      break;  // Keep it (and everything behind it) for later
+    }
+
+    InFlight &entry = inFlight_[(inFlightHead_ + inFlightCount_) % kOutboundDepth];
+    entry.packetId = 0;
+    entry.fragments = msg->fragmentCount;
+    entry.acked = false;
+    entry.tracked = msg->tracked;
+    entry.delivered = false;
+    entry.totalLength = msg->totalLength;
+    entry.firstSentMs = nowMs;
+    entry.lastSentMs = nowMs;
+
+    if (qos1) {
+      entry.packetId = nextPacketId_();
+      ++qos1Pending_;
+      // A failed write is retried after the reconnect it causes.
+      publishQos1_(sentSlots_, entry, false);
+    } else {
+      char topic[96];
+      switch (msg->kind) {
+        case OutboundMessage::Kind::Telemetry:
+          snprintf(topic, sizeof(topic), "%s", kTelemetryTopic_);
+          break;
+        case OutboundMessage::Kind::RpcResponse:
+          snprintf(topic, sizeof(topic), "v1/devices/me/rpc/response/%lu",
+                   (unsigned long)msg->requestId);
+          break;
+        case OutboundMessage::Kind::AttributeRequest:
+          snprintf(topic, sizeof(topic), "v1/devices/me/attributes/request/%lu",
+                   (unsigned long)msg->requestId);
+          break;
+      }
+      entry.delivered = publishFragments_(topic, sentSlots_, entry.fragments, entry.totalLength);
+      if (!entry.delivered && online) {
+        SG_LOGW("MQTT publish failed: %s", topic);
+      }
+    }
+
+    sentSlots_ += entry.fragments;
+    ++inFlightCount_;
+    msg = outbound_.consumerSlotAt(sentSlots_);
+  }
+
+  releaseSent_(online, nowMs);
+  qos1InFlightReport_.store(qos1Pending_, std::memory_order_relaxed);
+}
+
+// Hands ring slots back to the producer, oldest first, up to the first
+// QoS1 publish still waiting for its PUBACK.
+void ThingsBoardClient::releaseSent_(bool online, uint32_t nowMs) {
+  while (inFlightCount_ > 0) {
+    const InFlight &front = inFlight_[inFlightHead_];
+    if (front.packetId != 0 && !front.acked) {
+      if (online && nowMs - front.lastSentMs >= kPubackTimeoutMs_) {
+        SG_LOGW("MQTT PUBACK timeout; reconnecting");
+        socket_.stop();
+      }
+      return;
+    }
+    if (front.tracked) {
+      const bool delivered = front.packetId != 0 || front.delivered;  // QoS1: acked
+      trackedDelivery_.store(delivered ? Delivery::Delivered : Delivery::Lost,
+                             std::memory_order_release);
+    }
+    outbound_.commitPop(front.fragments);
+    sentSlots_ -= front.fragments;
+    inFlightHead_ = (inFlightHead_ + 1) % kOutboundDepth;
+    --inFlightCount_;
+  }
+}
+
+// After a reconnect: publishes the broker may never have received are
+// sent again, same packet id, DUP set. QoS0 entries are not repeated.
+void ThingsBoardClient::resendUnacked_() {
+  const uint32_t nowMs = millis();
+  uint32_t slot = 0;
+  for (uint32_t i = 0; i < inFlightCount_; ++i) {
+    InFlight &entry = inFlight_[(inFlightHead_ + i) % kOutboundDepth];
+    if (entry.packetId != 0 && !entry.acked) {
+      entry.lastSentMs = nowMs;
+      publishQos1_(slot, entry, true);
+      qos1Retransmits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot += entry.fragments;
+  }
+}
+
+// QoS1 PUBLISH written by hand (PubSubClient only publishes at QoS0):
+// fixed header, remaining length, topic, packet id, then the fragments.
+bool ThingsBoardClient::publishQos1_(uint32_t firstSlot, const InFlight &entry, bool dup) {
+  if (!mqtt_.connected()) {
+    return false;
+  }
+  const size_t topicLength = strlen(kTelemetryTopic_);
+  uint32_t remaining = 2 + topicLength + 2 + entry.totalLength;
+
+  uint8_t header[5 + 2 + 64 + 2];
+  size_t n = 0;
+  header[n++] = 0x30 | 0x02 | (dup ? 0x08 : 0x00);  // PUBLISH, QoS1
+  do {
+    uint8_t digit = remaining & 0x7F;
+    remaining >>= 7;
+    header[n++] = remaining > 0 ? (digit | 0x80) : digit;
+  } while (remaining > 0);
+  static_assert(sizeof("v1/devices/me/telemetry") - 1 <= 64, "header buffer");
+  header[n++] = (uint8_t)(topicLength >> 8);
+  header[n++] = (uint8_t)(topicLength & 0xFF);
+  memcpy(header + n, kTelemetryTopic_, topicLength);
+  n += topicLength;
+  header[n++] = (uint8_t)(entry.packetId >> 8);
+  header[n++] = (uint8_t)(entry.packetId & 0xFF);
+
+  if (mqtt_.write(header, n) != n) {
+    return false;
+  }
+  return writeFragments_(firstSlot, entry.fragments, entry.totalLength);
+}
+
+// Streams a QoS0 message (PUBLISH header via the PubSubClient buffer,
+// payload written directly). While disconnected nothing is written and the
+// message is released unsent, rather than sending stale responses later.
+bool ThingsBoardClient::publishFragments_(const char *topic, uint32_t firstSlot,
+                                          uint8_t fragmentCount,
+                                          uint32_t totalLength) {
+  if (!mqtt_.connected() || !mqtt_.beginPublish(topic, totalLength, false)) {
+    return false;
+  }
+  const bool ok = writeFragments_(firstSlot, fragmentCount, totalLength);
+  return mqtt_.endPublish() == 1 && ok;
+}
+
+bool ThingsBoardClient::writeFragments_(uint32_t firstSlot, uint8_t fragmentCount,
+                                        uint32_t totalLength) {
+  size_t written = 0;
+  for (uint8_t i = 0; i < fragmentCount; ++i) {
+    const OutboundMessage *fragment = outbound_.consumerSlotAt(firstSlot + i);
+    if (fragment == nullptr) {
+      break;  // Not reachable: fragments are committed together.
+    }
+    written += mqtt_.write((const uint8_t *)fragment->payload, fragment->length);
+  }
+  return written == totalLength;
+}
+
+// The only packet id source: QoS1 publishes and SUBSCRIBE both draw from
+// it, and ids of publishes still waiting for a PUBACK (kept across
+// reconnects) are skipped, so no two in-flight packets share an id.
+uint16_t ThingsBoardClient::nextPacketId_() {
+  for (;;) {
+    if (++lastPacketId_ == 0) {
+      lastPacketId_ = 1;  // 0 is not a valid packet id
+    }
+    bool inUse = false;
+    for (uint32_t i = 0; i < inFlightCount_ && !inUse; ++i) {
+      const InFlight &entry = inFlight_[(inFlightHead_ + i) % kOutboundDepth];
+      inUse = entry.packetId == lastPacketId_ && !entry.acked;
+    }
+    if (!inUse) {
+      return lastPacketId_;
+    }
+  }
+}
+
+// SUBSCRIBE (QoS0) written by hand so its packet id comes from
+// nextPacketId_() rather than PubSubClient's own counter. The SUBACK is
+// read and dropped by PubSubClient.
+bool ThingsBoardClient::sendSubscribe_(const char *topic) {
+  const size_t topicLength = strlen(topic);
+  uint8_t packet[2 + 2 + 2 + 64 + 1];
+  if (topicLength > 64) {
+    return false;
+  }
+  const uint16_t packetId = nextPacketId_();
+  size_t n = 0;
+  packet[n++] = 0x82;  // SUBSCRIBE (reserved flags 0b0010)
+  packet[n++] = (uint8_t)(2 + 2 + topicLength + 1);
+  packet[n++] = (uint8_t)(packetId >> 8);
+  packet[n++] = (uint8_t)(packetId & 0xFF);
+  packet[n++] = (uint8_t)(topicLength >> 8);
+  packet[n++] = (uint8_t)(topicLength & 0xFF);
+  memcpy(packet + n, topic, topicLength);
+  n += topicLength;
+  packet[n++] = 0;  // Requested QoS
+  return mqtt_.connected() && mqtt_.write(packet, n) == n;
+}
+
+void ThingsBoardClient::pubackCallback_(uint16_t packetId) {
+  if (active_ != nullptr) {
+    active_->onPuback_(packetId);
+  }
+}
+
+// Runs on the network side, inside mqtt_.loop().
+void ThingsBoardClient::onPuback_(uint16_t packetId) {
+  for (uint32_t i = 0; i < inFlightCount_; ++i) {
+    InFlight &entry = inFlight_[(inFlightHead_ + i) % kOutboundDepth];
+    if (entry.packetId != packetId || entry.acked) {
+      continue;
+    }
+    entry.acked = true;
+    --qos1Pending_;
+
+    const uint32_t latencyMs = millis() - entry.firstSentMs;
+    qos1Acked_.fetch_add(1, std::memory_order_relaxed);
+    ackLatencySumMs_.fetch_add(latencyMs, std::memory_order_relaxed);
+    if (latencyMs > ackLatencyMaxMs_.load(std::memory_order_relaxed)) {
+      ackLatencyMaxMs_.store(latencyMs, std::memory_order_relaxed);
+    }
+    return;
+  }
 }
 
 void ThingsBoardClient::mqttCallback_(char *topic, uint8_t *payload,
@@ -63,6 +613,53 @@ void ThingsBoardClient::mqttCallback_(char *topic, uint8_t *payload,
   active_->onMqttMessage_(topic, payload, length);
 }
 
+namespace {
+
+constexpr size_t constLength(const char *s) { return *s ? 1 + constLength(s + 1) : 0; }
+
+}  // namespace
+
+// Matches `topic` against a fixed prefix table and parses the request id in
+// place (no String, no allocation). Longer prefixes come first.
+bool ThingsBoardClient::routeTopic_(const char *topic, InboundMessage::Kind &kind,
+                                    uint32_t &requestId) {
+  static constexpr TopicRoute kRoutes[] = {
+      {kRpcRequestPrefix_, constLength(kRpcRequestPrefix_), InboundMessage::Kind::Rpc, true},
+      {kAttrResponsePrefix_, constLength(kAttrResponsePrefix_), InboundMessage::Kind::Attributes,
+       true},
+      {kAttrUpdateTopic_, constLength(kAttrUpdateTopic_), InboundMessage::Kind::Attributes, false},
+  };
+
+  for (const TopicRoute &route : kRoutes) {
+    if (strncmp(topic, route.prefix, route.length) != 0) {
+      continue;
+    }
+    const char *suffix = topic + route.length;
+    if (!route.idSuffix) {
+      if (*suffix != '\0') {
+        continue;
+      }
+      kind = route.kind;
+      requestId = 0;
+      return true;
+    }
+
+    uint32_t id = 0;
+    const char *p = suffix;
+    for (; *p >= '0' && *p <= '9'; ++p) {
+      id = id * 10 + (uint32_t)(*p - '0');
+    }
+    if (p == suffix || *p != '\0') {
+      return false;  // Missing or malformed id
+    }
+    kind = route.kind;
+    requestId = id;
+    return true;
+  }
+  return false;
+}
+
+// Runs on the network side (inside mqtt_.loop()): classify and queue only.
 void ThingsBoardClient::onMqttMessage_(const char *topic,
                                        const uint8_t *payload,
                                        unsigned int length) {
@@ -70,147 +667,492 @@ void ThingsBoardClient::onMqttMessage_(const char *topic,
     return;
   }
 
-  const String topicStr(topic);
+  InboundMessage::Kind kind;
+  uint32_t requestId = 0;
+  if (!routeTopic_(topic, kind, requestId)) {
+    return;
+  }
 
-  if (topicStr.startsWith(kRpcRequestPrefix_)) {
-    const String requestIdStr = topicStr.substring(strlen(kRpcRequestPrefix_));
-    const int requestId = requestIdStr.toInt();
+  if (length > kMaxInboundPayload) {
+    SG_LOGW("MQTT inbound payload too large; dropped");
+    inbound_.noteDropped();
+    return;
+  }
 
-    JsonDocument doc;
-    const auto err = deserializeJson(doc, payload, length);
-    if (err) {
-      Serial.print("RPC JSON parse failed: ");
-      Serial.println(err.c_str());
-      return;
-    }
+  InboundMessage *slot = inbound_.producerSlot();
+  if (slot == nullptr) {
+    SG_LOGW("MQTT inbound queue full; dropped");
+    inbound_.noteDropped();
+    return;
+  }
+  slot->kind = kind;
+  slot->requestId = requestId;
+  slot->receivedUs = micros();
+  slot->length = (uint16_t)length;
+  memcpy(slot->payload, payload, length);
+  inbound_.commitPush();
+}
 
-    const char *method = doc["method"] | "";
-    const JsonVariantConst params = doc["params"];
+void ThingsBoardClient::processInbound() {
+  InboundMessage *msg = inbound_.consumerSlot();
+  while (msg != nullptr) {
+    dispatching_ = msg;
+    dispatchInbound_(*msg);
+    dispatching_ = nullptr;
+    inbound_.commitPop();
+    msg = inbound_.consumerSlot();
+  }
+  serviceAttrRequests_(millis());
+}
 
-    if (rpcHandler_ != nullptr && method != nullptr && method[0] != '\0') {
-      rpcHandler_(method, params);
-    }
+uint32_t ThingsBoardClient::inboundAgeUs() const {
+  return dispatching_ != nullptr ? micros() - dispatching_->receivedUs : 0;
+}
+
+// Looks the method up, checks its params, runs it and replies with
+// {"ok":true,...result} or {"ok":false,"error":"..."}.
+void ThingsBoardClient::dispatchRpc_(uint32_t requestId, const char *method,
+                                     JsonVariantConst params) {
+  char reply[kMaxRpcReplyBytes];
+  util::JsonWriter json(reply, sizeof(reply));
+  json.beginObject();
+  json.addBool("ok", true);
 
-    // Reply to the RPC request so ThingsBoard doesn't keep it pending.
-    if (requestId > 0) {
-      char responseTopic[96];
-      snprintf(responseTopic, sizeof(responseTopic),
-               "v1/devices/me/rpc/response/%d", requestId);
-      mqtt_.publish(responseTopic, "{\"ok\":true}");
+  const char *error = nullptr;
+  const RpcMethod *entry = nullptr;
+  if (method == nullptr) {
+    error = "invalid JSON";
+  } else if ((entry = findRpcMethod(rpcMethods_, rpcMethodCount_, method)) == nullptr) {
+    error = "unknown method";
+  } else {
+    RpcArgs args;
+    error = extractRpcArgs(entry->param, params, args);
+    if (error == nullptr) {
+      error = entry->handler(args, json);
     }
-    return;
+  }
+  json.endObject();
+  if (error == nullptr && !json.ok()) {
+    error = "reply too large";
   }
 
-  if (topicStr == kAttrUpdateTopic_ ||
-      topicStr.startsWith(kAttrResponsePrefix_)) {
-    if (attributesHandler_ == nullptr) {
-      return;
-    }
+  if (error != nullptr) {
+    SG_LOGW("RPC %s failed: %s", method != nullptr ? method : "?", error);
+
+    // Rebuilt from scratch: a handler may have written fields already.
+    util::JsonWriter failure(reply, sizeof(reply));
+    failure.beginObject();
+    failure.addBool("ok", false);
+    failure.addString("error", error);
+    failure.endObject();
+  }
+
+  // ThingsBoard keeps a two-way RPC pending until it gets a reply.
+  if (requestId > 0) {
+    enqueueOutbound_(OutboundMessage::Kind::RpcResponse, requestId, reply);
+  }
+}
+
+void ThingsBoardClient::dispatchInbound_(const InboundMessage &msg) {
+  SG_PERF_SCOPE(MqttInbound);
+
+  // The arena is rewound only once the document released everything.
+  inboundDoc_.clear();
+  inboundAllocator_.reset();
+  JsonDocument &doc = inboundDoc_;
+  // Only known fields are stored, so memory and time stay bounded by the
+  // payload size whatever the server sends.
+  const bool rpc = msg.kind == InboundMessage::Kind::Rpc;
+  DeserializationError err;
+  if (rpc || attrFiltered_) {
+    err = deserializeJson(doc, msg.payload, msg.length,
+                          DeserializationOption::Filter(rpc ? rpcFilter_ : attrFilter_),
+                          DeserializationOption::NestingLimit(kMaxInboundJsonNesting));
+  } else {
+    err = deserializeJson(doc, msg.payload, msg.length,
+                          DeserializationOption::NestingLimit(kMaxInboundJsonNesting));
+  }
 
-    JsonDocument doc;
-    const auto err = deserializeJson(doc, payload, length);
+  if (rpc) {
     if (err) {
-      Serial.print("Attributes JSON parse failed: ");
-      Serial.println(err.c_str());
+      SG_LOGW("RPC JSON parse failed: %s", err.c_str());
+      dispatchRpc_(msg.requestId, nullptr, JsonVariantConst());
       return;
     }
-    attributesHandler_(doc.as<JsonVariantConst>());
+    dispatchRpc_(msg.requestId, doc["method"] | "", doc["params"]);
     return;
   }
-}
 
-bool ThingsBoardClient::ensureConnected(const char *deviceName) {
-  if (mqtt_.connected()) {
-    return true;
+  if (err) {
+    // A failed response stays pending and is retried after the timeout.
+    SG_LOGW("Attributes JSON parse failed: %s", err.c_str());
+    return;
   }
-
-  const uint32_t nowMs = millis();
-  if (nowMs - lastConnectAttemptMs_ < kReconnectIntervalMs_) {
-    return false;
+  // attributes/response/{id}: only answers to a pending request are applied.
+  if (msg.requestId > 0 && !completeAttrRequest_(msg.requestId, millis())) {
+    SG_LOGW("Ignoring unmatched attribute response %u", msg.requestId);
+    return;
+  }
+  if (attributesHandler_ != nullptr) {
+    attributesHandler_(doc.as<JsonVariantConst>());
   }
-  lastConnectAttemptMs_ = nowMs;
-
-  return connect_(deviceName);
 }
 
-bool ThingsBoardClient::sendTelemetryJson(const char *json) {
-  if (!mqtt_.connected()) {
-    return false;
+bool ThingsBoardClient::ensureConnected(const char *deviceName) {
+  const uint32_t nowMs = millis();
+
+  if (connectState_ == ConnectState::Connected) {
+    if (mqtt_.connected()) {
+      return true;
+    }
+    SG_LOGW("ThingsBoard MQTT connection lost");
+    connected_.store(false, std::memory_order_release);
+    connectState_ = ConnectState::Idle;
   }
-  if (json == nullptr || json[0] == '\0') {
-    return false;
+
+  if (connectState_ == ConnectState::Idle) {
+    if (nowMs - lastConnectAttemptMs_ < kReconnectIntervalMs_) {
+      return false;
+    }
+    lastConnectAttemptMs_ = nowMs;
+    if (!startAttempt_(deviceName, nowMs)) {
+      return false;
+    }
   }
 
-  const bool ok = mqtt_.publish(kTelemetryTopic_, json);
-  if (!ok) {
-    Serial.println("MQTT publish failed (telemetry)");
+  // Every step is bounded (no network waits); track the worst one so the
+  // reconnect cost on the network task is visible in perf telemetry.
+  const uint32_t startUs = micros();
+  const bool ok = stepConnect_(nowMs);
+  const uint32_t stepUs = micros() - startUs;
+  if (stepUs > worstConnectStepUs_.load(std::memory_order_relaxed)) {
+    worstConnectStepUs_.store(stepUs, std::memory_order_relaxed);
   }
   return ok;
 }
 
-bool ThingsBoardClient::connect_(const char *deviceName) {
+bool ThingsBoardClient::startAttempt_(const char *deviceName, uint32_t nowMs) {
   if (host_ == nullptr || host_[0] == '\0') {
-    Serial.println("ThingsBoard host is empty. Check include/Secrets.h");
+    SG_LOGE("ThingsBoard host is empty. Check include/Secrets.h");
     return false;
   }
   if (accessToken_ == nullptr || accessToken_[0] == '\0') {
-    Serial.println(
-        "ThingsBoard access token is empty. Check include/Secrets.h");
+    SG_LOGE("ThingsBoard access token is empty. Check include/Secrets.h");
     return false;
   }
 
-  char clientId[96];
-  snprintf(clientId, sizeof(clientId), "%s-%06X", deviceName,
+  snprintf(clientId_, sizeof(clientId_), "%s-%06X", deviceName,
            (uint32_t)ESP.getEfuseMac());
 
-  Serial.print("Connecting to ThingsBoard MQTT ");
-  Serial.print(host_);
-  Serial.print(':');
-  Serial.print(port_);
-  Serial.print(" as clientId=");
-  Serial.print(clientId);
-  Serial.print(" token=");
-  Serial.println(accessToken_);
+  SG_LOGI("Connecting to ThingsBoard MQTT %s:%u as clientId=%s token=%s", host_, port_,
+          clientId_, accessToken_);
+
+  attemptStartMs_ = nowMs;
+  if (serverIp_.fromString(host_)) {
+    enter_(ConnectState::TcpConnect, nowMs);
+    return true;
+  }
+
+  // Resolve on the lwIP thread; the answer arrives via dnsFound_().
+  const uint32_t generation = dnsGeneration_.fetch_add(1, std::memory_order_acq_rel) + 1;
+  dnsState_.store(kDnsPending, std::memory_order_release);
+  if (tcpip_callback(dnsStart_, (void *)(uintptr_t)generation) != ERR_OK) {
+    failConnect_("DNS request not queued");
+    return false;
+  }
+  enter_(ConnectState::Resolve, nowMs);
+  return true;
+}
+
+void ThingsBoardClient::enter_(ConnectState state, uint32_t nowMs) {
+  connectState_ = state;
+  stateStartMs_ = nowMs;
+}
+
+bool ThingsBoardClient::stepConnect_(uint32_t nowMs) {
+  const uint32_t inStateMs = nowMs - stateStartMs_;
+
+  switch (connectState_) {
+    case ConnectState::Idle:
+    case ConnectState::Connected:
+      break;
 
-  // ThingsBoard access token is used as MQTT username; password is empty.
-  const bool ok = mqtt_.connect(clientId, accessToken_, nullptr);
-  if (ok) {
-    Serial.println("ThingsBoard MQTT connected!");
+    case ConnectState::Resolve: {
+      const uint8_t dns = dnsState_.load(std::memory_order_acquire);
+      if (dns == kDnsDone) {
+        serverIp_ = IPAddress(dnsAddr_.load(std::memory_order_relaxed));
+        enter_(ConnectState::TcpConnect, nowMs);
+      } else if (dns == kDnsFailed) {
+        failConnect_("DNS lookup failed");
+      } else if (inStateMs >= kDnsTimeoutMs_) {
+        failConnect_("DNS timeout");
+      }
+      break;
+    }
 
-    // Subscribe to RPC requests (used for schedule & dashboard control).
-    if (!mqtt_.subscribe(kRpcRequestTopic_)) {
-      Serial.println("MQTT subscribe failed (RPC)");
+    case ConnectState::TcpConnect: {
+      if (connectingFd_ < 0) {
+        if (!startTcp_()) {
+          failConnect_("TCP socket error");
+        }
+        break;
+      }
+      bool done = false;
+      if (!pollTcp_(done)) {
+        failConnect_("TCP connect refused");
+      } else if (done) {
+        enter_(useTls_ ? ConnectState::TlsHandshake : ConnectState::SendConnect, nowMs);
+      } else if (inStateMs >= kTcpTimeoutMs_) {
+        failConnect_("TCP connect timeout");
+      }
+      break;
     }
 
-    // Subscribe to shared attributes updates and responses.
-    if (!mqtt_.subscribe(kAttrUpdateTopic_)) {
-      Serial.println("MQTT subscribe failed (attributes update)");
+    case ConnectState::TlsHandshake:
+      // One handshake message per step; crypto-heavy steps still take CPU
+      // time but never wait for the server.
+      switch (tls_.handshakeStep()) {
+        case TlsSocket::Handshake::Done:
+          enter_(ConnectState::SendConnect, nowMs);
+          break;
+        case TlsSocket::Handshake::Failed:
+          failConnect_("TLS handshake failed");
+          break;
+        case TlsSocket::Handshake::InProgress:
+          if (inStateMs >= kTlsTimeoutMs_) {
+            failConnect_("TLS handshake timeout");
+          }
+          break;
+      }
+      break;
+
+    case ConnectState::SendConnect:
+      if (sendConnectPacket_()) {
+        enter_(ConnectState::AwaitConnack, nowMs);
+      } else {
+        failConnect_("CONNECT write failed");
+      }
+      break;
+
+    case ConnectState::AwaitConnack: {
+      Client &transport = socket_.inner();
+      if (transport.available() < 4) {
+        if (!transport.connected()) {
+          failConnect_("connection closed before CONNACK");
+        } else if (inStateMs >= kConnackTimeoutMs_) {
+          failConnect_("MQTT_CONNECTION_TIMEOUT");
+        }
+        break;
+      }
+
+      uint8_t connack[4];
+      transport.read(connack, sizeof(connack));
+      if (connack[0] != 0x20 || connack[1] != 0x02) {
+        failConnect_("malformed CONNACK");
+        break;
+      }
+      if (connack[3] != 0) {
+        failConnect_(connackReason_(connack[3]));
+        break;
+      }
+
+      // Hand the finished handshake to PubSubClient: its CONNECT is
+      // swallowed and it reads the CONNACK we already received.
+      socket_.primeHandshake(connack, sizeof(connack));
+      const bool ok = mqtt_.connect(clientId_, accessToken_, nullptr);
+      socket_.clearHandshake();
+      if (!ok) {
+        failConnect_("PubSubClient handshake rejected");
+        break;
+      }
+      SG_LOGI("ThingsBoard MQTT connected!");
+      subscribeIndex_ = 0;
+      enter_(ConnectState::Subscribe, nowMs);
+      break;
     }
-    if (!mqtt_.subscribe(kAttrResponseTopic_)) {
-      Serial.println("MQTT subscribe failed (attributes response)");
+
+    case ConnectState::Subscribe: {
+      // RPC requests (schedule & dashboard control), shared attribute
+      // updates and attribute responses.
+      static const char *const kTopics[] = {kRpcRequestTopic_, kAttrUpdateTopic_,
+                                            kAttrResponseTopic_};
+      static const char *const kNames[] = {"RPC", "attributes update",
+                                           "attributes response"};
+      if (!sendSubscribe_(kTopics[subscribeIndex_])) {
+        SG_LOGW("MQTT subscribe failed (%s)", kNames[subscribeIndex_]);
+      }
+      if (++subscribeIndex_ < sizeof(kTopics) / sizeof(kTopics[0])) {
+        break;
+      }
+
+      const uint32_t durationMs = nowMs - attemptStartMs_;
+      lastConnectDurationMs_.store(durationMs, std::memory_order_relaxed);
+      SG_LOGI("ThingsBoard MQTT ready in %u ms (worst step %u us)", durationMs,
+              worstConnectStepUs_.load(std::memory_order_relaxed));
+
+      enter_(ConnectState::Connected, nowMs);
+      resendPending_ = true;
+      connectionCount_.fetch_add(1, std::memory_order_release);
+      connected_.store(true, std::memory_order_release);
+      return true;
     }
+  }
+  return false;
+}
+
+bool ThingsBoardClient::startTcp_() {
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = (uint32_t)serverIp_;
+  addr.sin_port = htons(port_);
+
+  const int rc = ::connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+  if (rc != 0 && errno != EINPROGRESS) {
+    close(fd);
+    return false;
+  }
+  connectingFd_ = fd;
+  return true;
+}
+
+// Zero-timeout select(): never waits. On success the socket gets the same
+// options WiFiClient::connect() would set and is handed to the TLS layer
+// (which keeps it non-blocking) or to the WiFiClient.
+bool ThingsBoardClient::pollTcp_(bool &done) {
+  done = false;
+
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(connectingFd_, &writable);
+  struct timeval noWait = {0, 0};
+  const int ready = select(connectingFd_ + 1, nullptr, &writable, nullptr, &noWait);
+  if (ready < 0) {
+    return false;
+  }
+  if (ready == 0) {
+    return true;  // Still in progress
+  }
+
+  int err = 0;
+  socklen_t len = sizeof(err);
+  getsockopt(connectingFd_, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err != 0) {
+    return false;
+  }
+
+  const int fd = connectingFd_;
+  connectingFd_ = -1;
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  if (useTls_) {
+    done = tls_.start(fd, host_);
+    return done;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+  tcp_ = WiFiClient(fd);
+  done = true;
+  return true;
+}
+
+// Same CONNECT that PubSubClient::connect(clientId, token, nullptr) builds
+// (MQTT 3.1.1, clean session, username = access token, no password).
+bool ThingsBoardClient::sendConnectPacket_() {
+  uint8_t packet[192];
+  const size_t idLen = strlen(clientId_);
+  const size_t userLen = strlen(accessToken_);
+  const size_t remaining = 10 + 2 + idLen + 2 + userLen;
+  if (remaining + 3 > sizeof(packet)) {
+    return false;
+  }
+
+  size_t n = 0;
+  packet[n++] = 0x10;  // CONNECT
+  if (remaining >= 128) {
+    packet[n++] = (uint8_t)(0x80 | (remaining & 0x7F));
+    packet[n++] = (uint8_t)(remaining >> 7);
   } else {
-    const int state = mqtt_.state();
-    Serial.print("ThingsBoard MQTT connect FAILED. state=");
-    Serial.print(state);
-    Serial.print(" (");
-    // Decode PubSubClient state codes
-    switch (state) {
-      case -4: Serial.print("MQTT_CONNECTION_TIMEOUT"); break;
-      case -3: Serial.print("MQTT_CONNECTION_LOST"); break;
-      case -2: Serial.print("MQTT_CONNECT_FAILED"); break;
-      case -1: Serial.print("MQTT_DISCONNECTED"); break;
-      case 0: Serial.print("MQTT_CONNECTED"); break;
-      case 1: Serial.print("MQTT_CONNECT_BAD_PROTOCOL"); break;
-      case 2: Serial.print("MQTT_CONNECT_BAD_CLIENT_ID"); break;
-      case 3: Serial.print("MQTT_CONNECT_UNAVAILABLE"); break;
-      case 4: Serial.print("MQTT_CONNECT_BAD_CREDENTIALS"); break;
-      case 5: Serial.print("MQTT_CONNECT_UNAUTHORIZED"); break;
-      default: Serial.print("UNKNOWN"); break;
-    }
-    Serial.println(")");
+    packet[n++] = (uint8_t)remaining;
   }
-  return ok;
+  static const uint8_t kVariableHeader[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+  memcpy(packet + n, kVariableHeader, sizeof(kVariableHeader));
+  n += sizeof(kVariableHeader);
+  packet[n++] = 0x80 | 0x02;  // Username, clean session
+  packet[n++] = (uint8_t)(kKeepAliveSec_ >> 8);
+  packet[n++] = (uint8_t)(kKeepAliveSec_ & 0xFF);
+  packet[n++] = (uint8_t)(idLen >> 8);
+  packet[n++] = (uint8_t)(idLen & 0xFF);
+  memcpy(packet + n, clientId_, idLen);
+  n += idLen;
+  packet[n++] = (uint8_t)(userLen >> 8);
+  packet[n++] = (uint8_t)(userLen & 0xFF);
+  memcpy(packet + n, accessToken_, userLen);
+  n += userLen;
+
+  return socket_.inner().write(packet, n) == n;
+}
+
+void ThingsBoardClient::failConnect_(const char *reason) {
+  if (connectingFd_ >= 0) {
+    close(connectingFd_);
+    connectingFd_ = -1;
+  }
+  socket_.stop();
+
+  SG_LOGW("ThingsBoard MQTT connect FAILED: %s", reason);
+  connectState_ = ConnectState::Idle;
+}
+
+const char *ThingsBoardClient::connackReason_(uint8_t code) {
+  switch (code) {
+    case 1: return "MQTT_CONNECT_BAD_PROTOCOL";
+    case 2: return "MQTT_CONNECT_BAD_CLIENT_ID";
+    case 3: return "MQTT_CONNECT_UNAVAILABLE";
+    case 4: return "MQTT_CONNECT_BAD_CREDENTIALS";
+    case 5: return "MQTT_CONNECT_UNAUTHORIZED";
+    default: return "UNKNOWN";
+  }
+}
+
+// Runs on the lwIP thread (tcpip_callback).
+void ThingsBoardClient::dnsStart_(void *arg) {
+  ThingsBoardClient *self = active_;
+  if (self == nullptr) {
+    return;
+  }
+  ip_addr_t addr;
+  const err_t err = dns_gethostbyname(self->host_, &addr, dnsFound_, arg);
+  if (err == ERR_OK) {
+    dnsStore_((uint32_t)(uintptr_t)arg, &addr);  // Answered from the DNS cache
+  } else if (err != ERR_INPROGRESS) {
+    dnsStore_((uint32_t)(uintptr_t)arg, nullptr);
+  }
+}
+
+void ThingsBoardClient::dnsFound_(const char *name, const ip_addr *addr, void *arg) {
+  (void)name;
+  dnsStore_((uint32_t)(uintptr_t)arg, addr);
+}
+
+void ThingsBoardClient::dnsStore_(uint32_t generation, const ip_addr *addr) {
+  ThingsBoardClient *self = active_;
+  if (self == nullptr ||
+      generation != self->dnsGeneration_.load(std::memory_order_acquire)) {
+    return;  // Answer to an abandoned attempt
+  }
+  if (addr == nullptr || !IP_IS_V4(addr)) {
+    self->dnsState_.store(kDnsFailed, std::memory_order_release);
+    return;
+  }
+  self->dnsAddr_.store(ip4_addr_get_u32(ip_2_ip4(addr)), std::memory_order_relaxed);
+  self->dnsState_.store(kDnsDone, std::memory_order_release);
 }
 
 } // namespace tb
@@ -3,46 +3,404 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
+#include <WiFi.h>
+
+#include <atomic>
+
+#include "thingsboard/MqttSocket.h"
+#include "thingsboard/RpcRegistry.h"
+#include "thingsboard/TlsSocket.h"
+#include "util/ArenaAllocator.h"
+#include "util/SpscRing.h"
+
+struct ip_addr;  // lwIP (DNS callback signature)
 
 namespace tb {
 
+// ThingsBoard MQTT client split across two tasks:
+//
+// - Network side (net::NetworkTask, core 0): ensureConnected(), loop().
+//   Owns the socket and PubSubClient. Connecting is an incremental state
+//   machine (DNS, TCP, optional TLS, CONNECT, CONNACK, subscribes); each
+//   ensureConnected() call does one short non-blocking step.
+// - App side (Arduino loop task, core 1): processInbound(),
+//   sendTelemetryJson(), requestSharedAttributes(), isConnected().
+//
+// The two sides only share two SPSC rings (inbound RPC/attribute messages,
+// outbound publishes) and a few atomics, so no locks are needed. Handlers
+// always run on the app side, next to the settings/controllers they touch.
+//
+// QoS1 telemetry: the outbound ring doubles as the retransmit buffer. The
+// network side reads ahead of the ring tail to send up to `window` QoS1
+// publishes, and only releases slots once their PUBACK arrives (the broker
+// acks in order). Unacked publishes are re-sent with DUP after reconnect.
+//
+// Shared attribute requests are tracked app side in a small pending table
+// until the matching attributes/response/{id} arrives: a request that gets
+// no answer within the timeout is re-sent with exponential backoff, and one
+// interrupted by a reconnect is re-sent as soon as the link is back.
 class ThingsBoardClient {
  public:
-  using RpcHandler = void (*)(const char* method, JsonVariantConst params);
   using AttributesHandler = void (*)(JsonVariantConst root);
 
-  explicit ThingsBoardClient(Client& networkClient);
+  // Bounded by the PubSubClient buffer (see begin()).
+  static constexpr uint16_t kMaxInboundPayload = 512;
+  // Fixed buffer behind the inbound JsonDocument (no heap per message).
+  static constexpr size_t kInboundJsonArenaBytes = 4096;
+  // Fixed buffer behind the parse filters (built once).
+  static constexpr size_t kFilterArenaBytes = 2048;
+  // Deeper payloads are rejected (TooDeep) before they cost memory.
+  static constexpr uint8_t kMaxInboundJsonNesting = 6;
+
+  // Outbound payloads are split across ring slots of kOutboundFragmentBytes
+  // and streamed to the socket, so they are bounded by the ring, not by the
+  // PubSubClient buffer.
+  static constexpr uint16_t kOutboundFragmentBytes = 512;
+  static constexpr uint32_t kOutboundDepth = 16;
+  static constexpr size_t kMaxOutboundPayload = (size_t)kOutboundFragmentBytes * kOutboundDepth;
+  static_assert(kOutboundDepth <= 255, "fragmentCount is a uint8_t");
+
+  // `socket` is driven directly for the non-blocking TCP connect.
+  explicit ThingsBoardClient(WiFiClient& socket);
 
   void begin(const char* host, uint16_t port, const char* accessToken);
+  // Switch the transport to TLS (MQTTS; the port passed to begin() must
+  // be the broker's TLS port). `caPem` must stay valid. Call before the
+  // network task starts; false keeps plain TCP.
+  bool setTls(const char* caPem);
+  // Telemetry at QoS1 with up to `window` unacknowledged publishes (others
+  // stay QoS0). Call before the network task starts.
+  void setTelemetryQos1(bool enabled, uint8_t window);
+
+  // ---- Network side ----
   void loop();
+  // Advances the connect state machine by at most one short step (no step
+  // waits on the network). True once connected and subscribed.
+  bool ensureConnected(const char* deviceName);
 
-  bool isConnected();
+  // ---- App side ----
 
-  bool ensureConnected(const char* deviceName);
+  // Dispatch queued RPC/attribute messages to the handlers.
+  void processInbound();
+  // Inside a handler: microseconds since the network task received the
+  // message being dispatched (MQTT-to-handler latency). 0 elsewhere.
+  uint32_t inboundAgeUs() const;
+
+  // Queue for publishing. False if disconnected or the outbound ring is full.
   bool sendTelemetryJson(const char* json);
 
-  // Request shared attributes once connected.
-  bool requestSharedAttributes(uint32_t requestId, const char* keysCsv);
+  // Streaming telemetry publish, mirroring PubSubClient's
+  // beginPublish()/write()/endPublish():
+  //
+  //   Print* out = tb.beginTelemetryPublish();
+  //   util::JsonWriter json(*out);  ...
+  //   tb.endPublish();
+  //
+  // Bytes are written straight into outbound ring slots; nothing becomes
+  // visible to the network side until endPublish(). Returns nullptr if
+  // disconnected or another publish is open.
+  Print* beginTelemetryPublish();
+  // False (and nothing is sent) if the payload was empty or did not fit.
+  // With trackDelivery the outcome is reported by publishDelivery(); one
+  // tracked publish at a time.
+  bool endPublish(bool trackDelivery = false);
+  void abortPublish();
+
+  // Outcome of the last tracked publish, set when it leaves the outbound
+  // ring: a QoS1 publish is Delivered on its PUBACK (it survives
+  // reconnects), a QoS0 one once fully written to the socket. Lost if it
+  // was released unsent (link down).
+  enum class Delivery : uint8_t { Pending, Delivered, Lost };
+  Delivery publishDelivery() const { return trackedDelivery_.load(std::memory_order_acquire); }
 
-  void setRpcHandler(RpcHandler handler);
+  // Request shared attributes and keep retrying until the response arrives
+  // (it goes to the attributes handler). `keysCsv` must stay valid. Asking
+  // again for keys that are still pending just re-sends now. False if the
+  // pending table is full.
+  bool requestSharedAttributes(const char* keysCsv);
+  // Response timeout, retry backoff bounds and attempts per request
+  // (0 = retry until answered).
+  void setAttributeRequestPolicy(uint32_t timeoutMs, uint32_t backoffMinMs, uint32_t backoffMaxMs,
+                                 uint8_t maxAttempts);
+  // True while a request for `keysCsv` is waiting for its response.
+  bool attributeRequestPending(const char* keysCsv) const;
+
+  bool isConnected() const;
+  // Incremented on every successful (re)connect.
+  uint32_t connectionCount() const;
+
+  // Last successful connect (attempt start to subscribed), and the longest
+  // single ensureConnected() step seen while connecting since boot.
+  uint32_t lastConnectDurationMs() const { return lastConnectDurationMs_.load(std::memory_order_relaxed); }
+  uint32_t worstConnectStepUs() const { return worstConnectStepUs_.load(std::memory_order_relaxed); }
+
+  // TLS handshake instrumentation (see TlsSocket).
+  uint32_t tlsHandshakeMs() const { return tls_.lastHandshakeMs(); }
+  uint32_t tlsHandshakeHeapBytes() const { return tls_.lastHandshakeHeapBytes(); }
+  uint32_t tlsResumedCount() const { return tls_.resumedCount(); }
+  uint32_t tlsFullHandshakeCount() const { return tls_.fullHandshakeCount(); }
+
+  // Inbound JSON arena (app side): high-water mark and failed allocations
+  // (payloads too complex for kInboundJsonArenaBytes).
+  size_t inboundJsonPeakBytes() const { return inboundAllocator_.peak(); }
+  uint32_t inboundJsonFailures() const { return inboundAllocator_.failures(); }
+
+  // Attribute request statistics since boot (app side): request to
+  // response latency, timed-out sends, abandoned requests, and responses
+  // that matched no pending request (late or duplicate).
+  uint32_t attrRttLastMs() const { return attrRttLastMs_; }
+  uint32_t attrRttMaxMs() const { return attrRttMaxMs_; }
+  uint32_t attrTimeoutCount() const { return attrTimeouts_; }
+  uint32_t attrFailedCount() const { return attrFailed_; }
+  uint32_t attrUnmatchedCount() const { return attrUnmatched_; }
+
+  // QoS1 delivery statistics since boot (publish to PUBACK latency).
+  uint32_t qos1AckedCount() const { return qos1Acked_.load(std::memory_order_relaxed); }
+  uint32_t qos1RetransmitCount() const { return qos1Retransmits_.load(std::memory_order_relaxed); }
+  uint32_t qos1InFlight() const { return qos1InFlightReport_.load(std::memory_order_relaxed); }
+  uint32_t ackLatencyAvgMs() const;
+  uint32_t ackLatencyMaxMs() const { return ackLatencyMaxMs_.load(std::memory_order_relaxed); }
+
+  // RPC methods, sorted by name (see RpcRegistry.h). Every request with an
+  // id gets a reply: the handler's result, or {"ok":false,"error":...} for
+  // unknown methods, bad params and handler failures.
+  template <size_t N>
+  void setRpcMethods(const RpcMethod (&table)[N]) {
+    setRpcMethods(table, N);
+  }
+  void setRpcMethods(const RpcMethod* table, size_t count);
   void setAttributesHandler(AttributesHandler handler);
+  // Attribute keys the handler cares about (comma-separated, must stay
+  // valid). Payloads are parsed through a filter built from them, plain or
+  // under "shared"/"client", so other keys never reach the arena. Without
+  // it every key is kept. App side.
+  bool setAttributeKeys(const char* keysCsv);
 
  private:
+  struct InboundMessage {
+    enum class Kind : uint8_t { Rpc, Attributes };
+    Kind kind = Kind::Rpc;
+    uint32_t requestId = 0;
+    uint32_t receivedUs = 0;  // micros() on the network side
+    uint16_t length = 0;
+    uint8_t payload[kMaxInboundPayload];
+  };
+
+  // One fragment of an outbound publish. kind / requestId / fragmentCount /
+  // totalLength are only meaningful in the first fragment.
+  struct OutboundMessage {
+    enum class Kind : uint8_t { Telemetry, RpcResponse, AttributeRequest };
+    Kind kind = Kind::Telemetry;
+    uint8_t fragmentCount = 1;
+    bool tracked = false;  // Report the outcome (publishDelivery())
+    uint16_t length = 0;  // Bytes used in this fragment
+    uint32_t requestId = 0;
+    uint32_t totalLength = 0;
+    char payload[kOutboundFragmentBytes];
+  };
+
+  // App-side Print that appends into the open outbound publish.
+  class OutboundStream : public Print {
+   public:
+    explicit OutboundStream(ThingsBoardClient& owner) : owner_(owner) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* data, size_t size) override;
+
+   private:
+    ThingsBoardClient& owner_;
+  };
+
+  // A message read from the outbound ring but not yet released. Entries
+  // mirror the ring order; packetId 0 means QoS0 (release once sent).
+  struct InFlight {
+    uint16_t packetId;
+    uint8_t fragments;
+    bool acked;
+    bool tracked;
+    bool delivered;  // QoS0: fully written to the socket
+    uint32_t totalLength;
+    uint32_t firstSentMs;  // Latency reference
+    uint32_t lastSentMs;   // PUBACK timeout reference
+  };
+
+  // Outstanding shared attribute request (app side). Retries reuse the id,
+  // so a late answer to an earlier send still completes it.
+  struct PendingAttrRequest {
+    enum class State : uint8_t { Free, Send, AwaitResponse };
+    State state = State::Free;
+    uint8_t attempts = 0;  // Sends that timed out
+    uint32_t requestId = 0;
+    const char* keysCsv = nullptr;
+    uint32_t sentMs = 0;
+    uint32_t sendAtMs = 0;
+    uint32_t connection = 0;  // connectionCount() at the last send
+    uint32_t backoffMs = 0;
+  };
+
+  // Static topic table entry; `length` is the prefix length.
+  struct TopicRoute {
+    const char* prefix;
+    uint8_t length;
+    InboundMessage::Kind kind;
+    bool idSuffix;  // Prefix is followed by a decimal request id
+  };
+
+  static constexpr uint32_t kInboundDepth = 4;
+  static constexpr size_t kMaxRpcReplyBytes = 256;
+  static constexpr size_t kMaxPendingAttrRequests = 2;
+
+  WiFiClient& tcp_;
+  TlsSocket tls_;
+  bool useTls_ = false;
+  MqttSocket socket_;
   PubSubClient mqtt_;
 
+  // Producer: network side (MQTT callback). Consumer: app side.
+  util::SpscRing<InboundMessage, kInboundDepth> inbound_;
+  // Producer: app side. Consumer: network side.
+  util::SpscRing<OutboundMessage, kOutboundDepth> outbound_;
+
+  // Reused for every inbound message (app side only).
+  uint8_t inboundArena_[kInboundJsonArenaBytes];
+  util::ArenaAllocator inboundAllocator_{inboundArena_, sizeof(inboundArena_)};
+  JsonDocument inboundDoc_{&inboundAllocator_};
+
+  // Parse filters: RPC {"method","params"}, attributes from setAttributeKeys().
+  uint8_t filterArena_[kFilterArenaBytes];
+  util::ArenaAllocator filterAllocator_{filterArena_, sizeof(filterArena_)};
+  JsonDocument rpcFilter_{&filterAllocator_};
+  JsonDocument attrFilter_{&filterAllocator_};
+  bool attrFiltered_ = false;
+  const InboundMessage* dispatching_ = nullptr;
+
+  // Open outbound publish (app side only).
+  OutboundStream stream_{*this};
+  bool streamActive_ = false;
+  bool streamOverflow_ = false;
+  OutboundMessage::Kind streamKind_ = OutboundMessage::Kind::Telemetry;
+  uint32_t streamRequestId_ = 0;
+  uint32_t streamLength_ = 0;
+
+  // ---- Attribute requests (app side) ----
+  PendingAttrRequest attrRequests_[kMaxPendingAttrRequests];
+  uint32_t nextAttrRequestId_ = 1;
+  uint32_t attrTimeoutMs_ = 5000;
+  uint32_t attrBackoffMinMs_ = 2000;
+  uint32_t attrBackoffMaxMs_ = 60000;
+  uint8_t attrMaxAttempts_ = 0;
+  uint32_t attrRttLastMs_ = 0;
+  uint32_t attrRttMaxMs_ = 0;
+  uint32_t attrTimeouts_ = 0;
+  uint32_t attrFailed_ = 0;
+  uint32_t attrUnmatched_ = 0;
+
+  std::atomic<bool> connected_{false};
+  std::atomic<uint32_t> connectionCount_{0};
+  std::atomic<uint32_t> lastConnectDurationMs_{0};
+  std::atomic<uint32_t> worstConnectStepUs_{0};
+
+  // ---- QoS1 window (network side) ----
+  bool qos1Enabled_ = false;
+  uint8_t qos1Window_ = 1;
+  InFlight inFlight_[kOutboundDepth];  // Each message uses >= 1 ring slot
+  uint32_t inFlightHead_ = 0;
+  uint32_t inFlightCount_ = 0;
+  uint32_t sentSlots_ = 0;  // Ring slots past the tail already sent
+  uint8_t qos1Pending_ = 0;
+  uint16_t lastPacketId_ = 0;
+  bool resendPending_ = false;
+
+  std::atomic<Delivery> trackedDelivery_{Delivery::Lost};
+
+  std::atomic<uint32_t> qos1Acked_{0};
+  std::atomic<uint32_t> qos1Retransmits_{0};
+  std::atomic<uint32_t> qos1InFlightReport_{0};
+  std::atomic<uint32_t> ackLatencySumMs_{0};
+  std::atomic<uint32_t> ackLatencyMaxMs_{0};
+
+  // ---- Connect state machine (network side) ----
+  enum class ConnectState : uint8_t {
+    Idle,          // Waiting for the retry interval
+    Resolve,       // DNS query in flight on the lwIP thread
+    TcpConnect,    // Non-blocking connect() in progress
+    TlsHandshake,  // One TLS handshake message per step (TLS only)
+    SendConnect,   // Write MQTT CONNECT
+    AwaitConnack,  // Poll for the 4-byte CONNACK
+    Subscribe,     // One SUBSCRIBE per step
+    Connected,
+  };
+
+  ConnectState connectState_ = ConnectState::Idle;
+  uint32_t stateStartMs_ = 0;
+  uint32_t attemptStartMs_ = 0;
+  IPAddress serverIp_;
+  int connectingFd_ = -1;
+  uint8_t subscribeIndex_ = 0;
+  char clientId_[96] = {0};
+
+  // DNS answer, written on the lwIP thread. The generation tags a query so
+  // a late answer to an abandoned attempt is ignored.
+  enum : uint8_t { kDnsPending, kDnsDone, kDnsFailed };
+  std::atomic<uint8_t> dnsState_{kDnsPending};
+  std::atomic<uint32_t> dnsAddr_{0};
+  std::atomic<uint32_t> dnsGeneration_{0};
+  static void dnsStart_(void* arg);
+  static void dnsFound_(const char* name, const ip_addr* addr, void* arg);
+  static void dnsStore_(uint32_t generation, const ip_addr* addr);
+
+  bool stepConnect_(uint32_t nowMs);
+  bool startAttempt_(const char* deviceName, uint32_t nowMs);
+  void enter_(ConnectState state, uint32_t nowMs);
+  bool startTcp_();
+  bool pollTcp_(bool& done);
+  bool sendConnectPacket_();
+  void failConnect_(const char* reason);
+  static const char* connackReason_(uint8_t code);
+
   static ThingsBoardClient* active_;
   static void mqttCallback_(char* topic, uint8_t* payload, unsigned int length);
   void onMqttMessage_(const char* topic, const uint8_t* payload, unsigned int length);
+  static bool routeTopic_(const char* topic, InboundMessage::Kind& kind, uint32_t& requestId);
+
+  bool enqueueOutbound_(OutboundMessage::Kind kind, uint32_t requestId, const char* payload);
+  bool beginOutbound_(OutboundMessage::Kind kind, uint32_t requestId);
+  size_t writeOutbound_(const uint8_t* data, size_t size);
+  bool endOutbound_(bool tracked = false);
+  void flushOutbound_();
+  bool publishFragments_(const char* topic, uint32_t firstSlot, uint8_t fragmentCount,
+                         uint32_t totalLength);
+  bool publishQos1_(uint32_t firstSlot, const InFlight& entry, bool dup);
+  bool writeFragments_(uint32_t firstSlot, uint8_t fragmentCount, uint32_t totalLength);
+  void resendUnacked_();
+  void releaseSent_(bool online, uint32_t nowMs);
+  uint16_t nextPacketId_();
+  bool sendSubscribe_(const char* topic);
+  static void pubackCallback_(uint16_t packetId);
+  void onPuback_(uint16_t packetId);
+  void serviceAttrRequests_(uint32_t nowMs);
+  bool sendAttrRequest_(const PendingAttrRequest& request);
+  // False if `requestId` matched no pending request.
+  bool completeAttrRequest_(uint32_t requestId, uint32_t nowMs);
+  void dispatchInbound_(const InboundMessage& msg);
+  void dispatchRpc_(uint32_t requestId, const char* method, JsonVariantConst params);
 
   const char* host_ = nullptr;
   uint16_t port_ = 1883;
   const char* accessToken_ = nullptr;
 
-  RpcHandler rpcHandler_ = nullptr;
+  const RpcMethod* rpcMethods_ = nullptr;
+  size_t rpcMethodCount_ = 0;
   AttributesHandler attributesHandler_ = nullptr;
 
   uint32_t lastConnectAttemptMs_ = 0;
   static constexpr uint32_t kReconnectIntervalMs_ = 5000;
+  static constexpr uint32_t kDnsTimeoutMs_ = 5000;
+  static constexpr uint32_t kTcpTimeoutMs_ = 5000;
+  static constexpr uint32_t kTlsTimeoutMs_ = 20000;
+  static constexpr uint32_t kConnackTimeoutMs_ = 15000;
+  static constexpr uint16_t kKeepAliveSec_ = 60;
+  // No PUBACK for this long on a live connection: reconnect and resend.
+  static constexpr uint32_t kPubackTimeoutMs_ = 20000;
 
   static constexpr const char* kTelemetryTopic_ = "v1/devices/me/telemetry";
   static constexpr const char* kRpcRequestPrefix_ = "v1/devices/me/rpc/request/";
@@ -51,8 +409,6 @@ class ThingsBoardClient {
   static constexpr const char* kAttrUpdateTopic_ = "v1/devices/me/attributes";
   static constexpr const char* kAttrResponsePrefix_ = "v1/devices/me/attributes/response/";
   static constexpr const char* kAttrResponseTopic_ = "v1/devices/me/attributes/response/+";
-
-  bool connect_(const char* deviceName);
 };
 
 }  // namespace tb
@@ -0,0 +1,359 @@
+#include "thingsboard/TlsSocket.h"
+
+#include <esp_attr.h>
+#include <mbedtls/version.h>
+
+#include "util/Crc32.h"
+
+namespace tb {
+
+namespace {
+
+constexpr uint32_t kSessionMagic = 0x544C5353;  // "TLSS"
+// A serialized session carries the server certificate when mbedTLS keeps
+// peer certificates (IDF default), hence the size.
+constexpr size_t kMaxSessionBytes = 2048;
+
+struct SessionCache {
+  uint32_t magic;
+  uint32_t hostHash;
+  uint32_t length;
+  uint32_t crc;  // Over data[0..length)
+  uint8_t data[kMaxSessionBytes];
+};
+
+// Survives software, watchdog and brownout resets (not power loss).
+RTC_NOINIT_ATTR SessionCache rtcSession;
+
+// The handshake state is a private field from mbedTLS 3 (IDF 5) on.
+int handshakeState(const mbedtls_ssl_context& ssl) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  return ssl.MBEDTLS_PRIVATE(state);
+#else
+  return ssl.state;
+#endif
+}
+
+bool handshakeOver(mbedtls_ssl_context& ssl) {
+#if MBEDTLS_VERSION_NUMBER >= 0x03020000
+  return mbedtls_ssl_is_handshake_over(&ssl) != 0;
+#else
+  return handshakeState(ssl) == MBEDTLS_SSL_HANDSHAKE_OVER;
+#endif
+}
+
+}  // namespace
+
+TlsSocket::TlsSocket() {
+  mbedtls_entropy_init(&entropy_);
+  mbedtls_ctr_drbg_init(&drbg_);
+  mbedtls_x509_crt_init(&ca_);
+  mbedtls_ssl_config_init(&conf_);
+  mbedtls_ssl_init(&ssl_);
+  mbedtls_net_init(&net_);
+}
+
+TlsSocket::~TlsSocket() {
+  close_();
+  mbedtls_ssl_free(&ssl_);
+  mbedtls_ssl_config_free(&conf_);
+  mbedtls_x509_crt_free(&ca_);
+  mbedtls_ctr_drbg_free(&drbg_);
+  mbedtls_entropy_free(&entropy_);
+}
+
+bool TlsSocket::configure(const char* caPem) {
+  if (configured_) {
+    return true;
+  }
+  if (caPem == nullptr) {
+    Serial.println("TLS: no CA certificate");
+    return false;
+  }
+
+  int rc = mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_, nullptr, 0);
+  if (rc == 0) {
+    // PEM parsing needs the terminating NUL in the length.
+    rc = mbedtls_x509_crt_parse(&ca_, (const unsigned char*)caPem, strlen(caPem) + 1);
+  }
+  if (rc == 0) {
+    rc = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                     MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (rc != 0) {
+    Serial.print("TLS: setup failed, mbedtls error -0x");
+    Serial.println(-rc, HEX);
+    return false;
+  }
+
+  mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+  mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  rc = mbedtls_ssl_setup(&ssl_, &conf_);
+  if (rc != 0) {
+    Serial.print("TLS: ssl setup failed, mbedtls error -0x");
+    Serial.println(-rc, HEX);
+    return false;
+  }
+  configured_ = true;
+  return true;
+}
+
+bool TlsSocket::start(int fd, const char* host) {
+  close_();
+  if (!configured_ || fd < 0) {
+    return false;
+  }
+
+  net_.fd = fd;
+  mbedtls_net_set_nonblock(&net_);
+  if (mbedtls_ssl_session_reset(&ssl_) != 0 || mbedtls_ssl_set_hostname(&ssl_, host) != 0) {
+    close_();
+    return false;
+  }
+  mbedtls_ssl_set_bio(&ssl_, &net_, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  hostHash_ = util::crc32(host, strlen(host));
+  offeredSession_ = loadSession_();
+  sawCertificate_ = false;
+  handshaking_ = true;
+  handshakeStartMs_ = millis();
+  heapBefore_ = ESP.getFreeHeap();
+  heapLowest_ = heapBefore_;
+  minEverAtStart_ = ESP.getMinFreeHeap();
+  return true;
+}
+
+// Heap is sampled between steps, so a peak inside one step is only seen if
+// it is also a new all-time low (ESP.getMinFreeHeap()).
+void TlsSocket::sampleHeap_() {
+  uint32_t low = ESP.getFreeHeap();
+  const uint32_t lowestEver = ESP.getMinFreeHeap();
+  if (lowestEver < minEverAtStart_ && lowestEver < low) {
+    low = lowestEver;  // New all-time low, set inside this step
+  }
+  if (low < heapLowest_) {
+    heapLowest_ = low;
+  }
+}
+
+TlsSocket::Handshake TlsSocket::handshakeStep() {
+  if (!handshaking_) {
+    return open_ ? Handshake::Done : Handshake::Failed;
+  }
+
+  // A resumed handshake jumps from ServerHello straight to ChangeCipherSpec.
+  if (handshakeState(ssl_) == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+    sawCertificate_ = true;
+  }
+  const int rc = mbedtls_ssl_handshake_step(&ssl_);
+  sampleHeap_();
+
+  if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+    return Handshake::InProgress;
+  }
+  if (rc != 0) {
+    Serial.print("TLS handshake failed, mbedtls error -0x");
+    Serial.println(-rc, HEX);
+    if (offeredSession_) {
+      clearSession_();  // Do not offer a session the server rejected twice
+    }
+    close_();
+    return Handshake::Failed;
+  }
+  if (!handshakeOver(ssl_)) {
+    return Handshake::InProgress;
+  }
+
+  handshaking_ = false;
+  open_ = true;
+  const uint32_t durationMs = millis() - handshakeStartMs_;
+  const bool resumed = !sawCertificate_;
+  handshakeMs_.store(durationMs, std::memory_order_relaxed);
+  handshakeHeap_.store(heapBefore_ - heapLowest_, std::memory_order_relaxed);
+  (resumed ? resumed_ : full_).fetch_add(1, std::memory_order_relaxed);
+  saveSession_();
+
+  Serial.print("TLS handshake ");
+  Serial.print(durationMs);
+  Serial.print(resumed ? " ms (resumed), heap " : " ms (full), heap ");
+  Serial.print(heapBefore_ - heapLowest_);
+  Serial.println(" B");
+  return Handshake::Done;
+}
+
+bool TlsSocket::loadSession_() {
+  const SessionCache& cache = rtcSession;
+  if (cache.magic != kSessionMagic || cache.hostHash != hostHash_ || cache.length == 0 ||
+      cache.length > kMaxSessionBytes || util::crc32(cache.data, cache.length) != cache.crc) {
+    return false;
+  }
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  bool ok = mbedtls_ssl_session_load(&session, cache.data, cache.length) == 0 &&
+            mbedtls_ssl_set_session(&ssl_, &session) == 0;
+  mbedtls_ssl_session_free(&session);
+  if (!ok) {
+    clearSession_();
+  }
+  return ok;
+}
+
+void TlsSocket::saveSession_() {
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  size_t length = 0;
+  SessionCache& cache = rtcSession;
+  if (mbedtls_ssl_get_session(&ssl_, &session) == 0 &&
+      mbedtls_ssl_session_save(&session, cache.data, kMaxSessionBytes, &length) == 0) {
+    cache.hostHash = hostHash_;
+    cache.length = (uint32_t)length;
+    cache.crc = util::crc32(cache.data, length);
+    cache.magic = kSessionMagic;
+  } else {
+    clearSession_();
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+void TlsSocket::clearSession_() {
+  rtcSession.magic = 0;
+}
+
+void TlsSocket::close_() {
+  if (net_.fd >= 0) {
+    mbedtls_net_free(&net_);  // Closes the socket
+  }
+  handshaking_ = false;
+  open_ = false;
+  peeked_ = -1;
+}
+
+int TlsSocket::connect(IPAddress ip, uint16_t port) {
+  (void)ip;
+  (void)port;
+  return 0;
+}
+
+int TlsSocket::connect(const char* host, uint16_t port) {
+  (void)host;
+  (void)port;
+  return 0;
+}
+
+int TlsSocket::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  (void)timeoutMs;
+  return connect(ip, port);
+}
+
+int TlsSocket::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  (void)timeoutMs;
+  return connect(host, port);
+}
+
+size_t TlsSocket::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+// The socket stays non-blocking; a full TCP window is retried briefly.
+size_t TlsSocket::write(const uint8_t* buf, size_t size) {
+  if (!open_) {
+    return 0;
+  }
+  size_t sent = 0;
+  const uint32_t startMs = millis();
+  while (sent < size) {
+    const int rc = mbedtls_ssl_write(&ssl_, buf + sent, size - sent);
+    if (rc > 0) {
+      sent += (size_t)rc;
+    } else if (rc == MBEDTLS_ERR_SSL_WANT_WRITE || rc == MBEDTLS_ERR_SSL_WANT_READ) {
+      if (millis() - startMs >= kWriteTimeoutMs) {
+        close_();
+        break;
+      }
+      delay(1);
+    } else {
+      close_();
+      break;
+    }
+  }
+  return sent;
+}
+
+int TlsSocket::available() {
+  if (!open_) {
+    return 0;
+  }
+  const int extra = peeked_ >= 0 ? 1 : 0;
+  if (mbedtls_ssl_get_bytes_avail(&ssl_) == 0) {
+    // Zero-length read: processes one pending record, if any.
+    const int rc = mbedtls_ssl_read(&ssl_, nullptr, 0);
+    if (rc < 0 && rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      close_();  // Peer closed or fatal alert
+      return extra;
+    }
+  }
+  return (int)mbedtls_ssl_get_bytes_avail(&ssl_) + extra;
+}
+
+int TlsSocket::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsSocket::read(uint8_t* buf, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  size_t n = 0;
+  if (peeked_ >= 0) {
+    buf[n++] = (uint8_t)peeked_;
+    peeked_ = -1;
+  }
+  if (n < size && open_) {
+    const int rc = mbedtls_ssl_read(&ssl_, buf + n, size - n);
+    if (rc > 0) {
+      n += (size_t)rc;
+    } else if (rc != MBEDTLS_ERR_SSL_WANT_READ && rc != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      close_();
+    }
+  }
+  return n > 0 ? (int)n : -1;
+}
+
+int TlsSocket::peek() {
+  if (peeked_ < 0) {
+    uint8_t b;
+    if (read(&b, 1) == 1) {
+      peeked_ = b;
+    }
+  }
+  return peeked_;
+}
+
+void TlsSocket::flush() {}
+
+void TlsSocket::stop() {
+  if (open_) {
+    mbedtls_ssl_close_notify(&ssl_);  // Best effort
+  }
+  close_();
+}
+
+uint8_t TlsSocket::connected() {
+  if (open_) {
+    available();  // Notices a closed peer
+  }
+  return open_ || peeked_ >= 0;
+}
+
+TlsSocket::operator bool() {
+  return connected();
+}
+
+}  // namespace tb
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+#include <atomic>
+
+namespace tb {
+
+// TLS client over a socket that is already TCP-connected, built on mbedTLS
+// directly instead of WiFiClientSecure:
+//
+// - The handshake is advanced one message at a time (handshakeStep()) on a
+//   non-blocking socket, so it fits the MQTT connect state machine. Steps
+//   with crypto still cost CPU, but none of them waits on the network.
+// - The negotiated session (session ID / ticket) is saved to RTC memory and
+//   offered on the next handshake, including after a warm reboot, so a
+//   reconnect normally skips certificate verification and the key exchange.
+//
+// The SSL context and its record buffers are allocated once in configure()
+// and reused by every connection (no per-reconnect heap churn).
+class TlsSocket : public Client {
+ public:
+  enum class Handshake : uint8_t { InProgress, Done, Failed };
+
+  TlsSocket();
+  ~TlsSocket();
+
+  // Once at boot. `caPem` must stay valid (null-terminated PEM).
+  bool configure(const char* caPem);
+  bool configured() const { return configured_; }
+
+  // Takes ownership of the connected socket `fd` and begins a handshake.
+  bool start(int fd, const char* host);
+  Handshake handshakeStep();
+
+  // Statistics of the last completed handshake (readable from any task).
+  uint32_t lastHandshakeMs() const { return handshakeMs_.load(std::memory_order_relaxed); }
+  // Free heap before the handshake minus the lowest value seen during it.
+  uint32_t lastHandshakeHeapBytes() const { return handshakeHeap_.load(std::memory_order_relaxed); }
+  uint32_t resumedCount() const { return resumed_.load(std::memory_order_relaxed); }
+  uint32_t fullHandshakeCount() const { return full_.load(std::memory_order_relaxed); }
+
+  // Client. The TCP connect is done by the caller, so connect() fails.
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+ private:
+  static constexpr uint32_t kWriteTimeoutMs = 5000;
+
+  mbedtls_entropy_context entropy_;
+  mbedtls_ctr_drbg_context drbg_;
+  mbedtls_x509_crt ca_;
+  mbedtls_ssl_config conf_;
+  mbedtls_ssl_context ssl_;
+  mbedtls_net_context net_;
+
+  bool configured_ = false;
+  bool handshaking_ = false;
+  bool open_ = false;
+  int peeked_ = -1;
+  uint32_t hostHash_ = 0;
+
+  uint32_t handshakeStartMs_ = 0;
+  uint32_t heapBefore_ = 0;
+  uint32_t heapLowest_ = 0;
+  uint32_t minEverAtStart_ = 0;
+  bool sawCertificate_ = false;
+  bool offeredSession_ = false;
+
+  std::atomic<uint32_t> handshakeMs_{0};
+  std::atomic<uint32_t> handshakeHeap_{0};
+  std::atomic<uint32_t> resumed_{0};
+  std::atomic<uint32_t> full_{0};
+
+  void sampleHeap_();
+  bool loadSession_();
+  void saveSession_();
+  static void clearSession_();
+  void close_();
+};
+
+}  // namespace tb
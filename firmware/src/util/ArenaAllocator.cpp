@@ -0,0 +1,87 @@
+#include "util/ArenaAllocator.h"
+
+namespace util {
+
+namespace {
+
+// Each block is preceded by its size; 8 bytes keeps doubles aligned.
+struct BlockHeader {
+  uint32_t size;
+  uint32_t prev;  // Offset of the previous block's header
+};
+
+constexpr size_t kAlign = 8;
+static_assert(sizeof(BlockHeader) % kAlign == 0, "header keeps blocks aligned");
+
+}  // namespace
+
+ArenaAllocator::ArenaAllocator(uint8_t* buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+size_t ArenaAllocator::align_(size_t n) {
+  return (n + kAlign - 1) & ~(kAlign - 1);
+}
+
+void* ArenaAllocator::allocate(size_t size) {
+  const size_t need = sizeof(BlockHeader) + align_(size);
+  if (need > size_ - top_) {
+    ++failures_;
+    return nullptr;
+  }
+
+  BlockHeader* header = reinterpret_cast<BlockHeader*>(buffer_ + top_);
+  header->size = (uint32_t)align_(size);
+  header->prev = (uint32_t)last_;
+  last_ = top_;
+  top_ += need;
+  if (top_ > peak_) {
+    peak_ = top_;
+  }
+  return header + 1;
+}
+
+// Only the newest block is actually returned to the arena; anything else
+// is reclaimed by reset().
+void ArenaAllocator::deallocate(void* ptr) {
+  if (ptr == nullptr || top_ == 0) {
+    return;
+  }
+  BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+  if ((uint8_t*)header == buffer_ + last_) {
+    top_ = last_;
+    last_ = header->prev;
+  }
+}
+
+void* ArenaAllocator::reallocate(void* ptr, size_t newSize) {
+  if (ptr == nullptr) {
+    return allocate(newSize);
+  }
+  BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+
+  // Newest block: grow or shrink in place.
+  if ((uint8_t*)header == buffer_ + last_) {
+    const size_t need = sizeof(BlockHeader) + align_(newSize);
+    if (need > size_ - last_) {
+      ++failures_;
+      return nullptr;
+    }
+    header->size = (uint32_t)align_(newSize);
+    top_ = last_ + need;
+    if (top_ > peak_) {
+      peak_ = top_;
+    }
+    return ptr;
+  }
+
+  const size_t oldSize = header->size;
+  if (align_(newSize) <= oldSize) {
+    return ptr;
+  }
+  void* moved = allocate(newSize);
+  if (moved != nullptr) {
+    memcpy(moved, ptr, oldSize);
+  }
+  return moved;
+}
+
+}  // namespace util
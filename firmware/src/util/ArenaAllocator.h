@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+namespace util {
+
+// ArduinoJson v7 allocator carving blocks out of a caller-owned buffer.
+//
+// JsonDocument normally mallocs its variant pools and strings on every
+// deserializeJson(). With this allocator a document reuses the same fixed
+// buffer: blocks are bump-allocated, freeing or growing the newest block
+// works in place, and reset() makes the whole buffer free again. When the
+// buffer is exhausted allocate() fails, so ArduinoJson reports NoMemory
+// instead of touching the heap.
+class ArenaAllocator : public ArduinoJson::Allocator {
+ public:
+  ArenaAllocator(uint8_t* buffer, size_t size);
+
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t newSize) override;
+
+  // Only while no document holds memory from it (call doc.clear() first).
+  void reset() { top_ = 0; }
+
+  size_t capacity() const { return size_; }
+  size_t used() const { return top_; }
+  size_t peak() const { return peak_; }
+  uint32_t failures() const { return failures_; }
+
+ private:
+  uint8_t* buffer_;
+  size_t size_;
+  size_t top_ = 0;
+  size_t last_ = 0;  // Offset of the newest block's header (valid if top_ > 0)
+  size_t peak_ = 0;
+  uint32_t failures_ = 0;
+
+  static size_t align_(size_t n);
+};
+
+}  // namespace util
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace util {
+
+// Boxcar decimator: averages `factor` consecutive samples into one output.
+// Averaging N uncorrelated samples cuts noise by ~sqrt(N); for ADC noise
+// that is the cheapest useful filter (one add per sample, no history).
+class Decimator {
+ public:
+  explicit Decimator(uint32_t factor = 1) : factor_(factor > 0 ? factor : 1) {}
+
+  void setFactor(uint32_t factor) {
+    factor_ = factor > 0 ? factor : 1;
+    reset();
+  }
+
+  // Returns true when this sample completes a block; read it with output().
+  bool add(uint16_t sample) {
+    sum_ += sample;
+    if (++count_ < factor_) {
+      return false;
+    }
+    // Rounded mean.
+    output_ = (uint16_t)((sum_ + factor_ / 2) / factor_);
+    sum_ = 0;
+    count_ = 0;
+    return true;
+  }
+
+  uint16_t output() const { return output_; }
+
+  void reset() {
+    sum_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  uint32_t factor_;
+  uint32_t sum_ = 0;
+  uint32_t count_ = 0;
+  uint16_t output_ = 0;
+};
+
+}  // namespace util
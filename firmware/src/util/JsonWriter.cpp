@@ -0,0 +1,216 @@
+#include "util/JsonWriter.h"
+
+namespace util {
+
+namespace {
+
+const uint32_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+}  // namespace
+
+JsonWriter::JsonWriter(char* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity) {
+  if (capacity_ == 0) {
+    ok_ = false;
+    return;
+  }
+  buffer_[0] = '\0';
+}
+
+JsonWriter::JsonWriter(Print& out) : out_(&out) {}
+
+void JsonWriter::put_(char c) {
+  if (!ok_) {
+    return;
+  }
+  if (out_ != nullptr) {
+    if (out_->write((uint8_t)c) != 1) {
+      ok_ = false;
+      return;
+    }
+    ++length_;
+    return;
+  }
+  if (length_ + 1 >= capacity_) {
+    ok_ = false;
+    return;
+  }
+  buffer_[length_++] = c;
+  buffer_[length_] = '\0';
+}
+
+void JsonWriter::putRaw_(const char* text) {
+  while (*text != '\0' && ok_) {
+    put_(*text++);
+  }
+}
+
+void JsonWriter::putString_(const char* text) {
+  put_('"');
+  for (; *text != '\0' && ok_; ++text) {
+    const char c = *text;
+    if (c == '"' || c == '\\') {
+      put_('\\');
+      put_(c);
+    } else if ((uint8_t)c < 0x20) {
+      // Control characters are not expected in telemetry; keep JSON valid.
+      put_(' ');
+    } else {
+      put_(c);
+    }
+  }
+  put_('"');
+}
+
+void JsonWriter::putUnsigned_(uint32_t value) {
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0) {
+    put_(digits[--count]);
+  }
+}
+
+void JsonWriter::putUnsigned64_(uint64_t value) {
+  if (value <= UINT32_MAX) {
+    putUnsigned_((uint32_t)value);
+    return;
+  }
+  char digits[20];
+  uint8_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0) {
+    put_(digits[--count]);
+  }
+}
+
+void JsonWriter::key_(const char* key) {
+  if (needComma_) {
+    put_(',');
+  }
+  needComma_ = true;
+  putString_(key);
+  put_(':');
+}
+
+// needComma_ tracks the innermost open container only: after a nested
+// container closes, its parent always holds at least one entry.
+void JsonWriter::open_(char bracket) {
+  put_(bracket);
+  needComma_ = false;
+}
+
+void JsonWriter::close_(char bracket) {
+  put_(bracket);
+  needComma_ = true;
+}
+
+void JsonWriter::beginObject() {
+  if (needComma_) {
+    put_(',');
+  }
+  open_('{');
+}
+
+void JsonWriter::beginObject(const char* key) {
+  key_(key);
+  open_('{');
+}
+
+void JsonWriter::endObject() {
+  close_('}');
+}
+
+void JsonWriter::beginArray() {
+  if (needComma_) {
+    put_(',');
+  }
+  open_('[');
+}
+
+void JsonWriter::endArray() {
+  close_(']');
+}
+
+void JsonWriter::addBool(const char* key, bool value) {
+  key_(key);
+  putRaw_(value ? "true" : "false");
+}
+
+void JsonWriter::addInt(const char* key, int32_t value) {
+  key_(key);
+  if (value < 0) {
+    put_('-');
+    putUnsigned_((uint32_t)0 - (uint32_t)value);
+  } else {
+    putUnsigned_((uint32_t)value);
+  }
+}
+
+void JsonWriter::addUint(const char* key, uint32_t value) {
+  key_(key);
+  putUnsigned_(value);
+}
+
+void JsonWriter::addUint64(const char* key, uint64_t value) {
+  key_(key);
+  putUnsigned64_(value);
+}
+
+void JsonWriter::addFloat(const char* key, float value, uint8_t decimals) {
+  key_(key);
+  if (isnan(value) || isinf(value) || fabsf(value) >= 2147483647.0f) {
+    putRaw_("null");
+    return;
+  }
+  if (decimals > 6) {
+    decimals = 6;
+  }
+
+  const uint32_t scale = kPow10[decimals];
+  const bool negative = value < 0;
+  const double magnitude = negative ? -(double)value : (double)value;
+  const uint64_t scaled = (uint64_t)(magnitude * scale + 0.5);
+  uint32_t whole = (uint32_t)(scaled / scale);
+  uint32_t frac = (uint32_t)(scaled % scale);
+
+  if (negative && (whole != 0 || frac != 0)) {
+    put_('-');
+  }
+  putUnsigned_(whole);
+
+  // Trim trailing zeros (23.40 -> 23.4, 5.00 -> 5).
+  while (decimals > 0 && frac % 10 == 0) {
+    frac /= 10;
+    --decimals;
+  }
+  if (decimals == 0) {
+    return;
+  }
+  put_('.');
+  for (uint8_t i = decimals; i > 0; --i) {
+    put_((char)('0' + (frac / kPow10[i - 1]) % 10));
+  }
+}
+
+void JsonWriter::addString(const char* key, const char* value) {
+  if (value == nullptr) {
+    addNull(key);
+    return;
+  }
+  key_(key);
+  putString_(value);
+}
+
+void JsonWriter::addNull(const char* key) {
+  key_(key);
+  putRaw_("null");
+}
+
+}  // namespace util
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace util {
+
+// Minimal JSON object writer into a caller-provided buffer or a Print sink.
+//
+// No heap, no String, no intermediate document: each field is appended
+// straight into `buffer` (kept NUL-terminated) or written to `out` (e.g. a
+// streaming MQTT publish, or Serial). On overflow / short write the writer
+// stops appending and ok() turns false.
+class JsonWriter {
+ public:
+  JsonWriter(char* buffer, size_t capacity);
+  explicit JsonWriter(Print& out);
+
+  // Top-level value or array element.
+  void beginObject();
+  // Nested object member: "key":{...}
+  void beginObject(const char* key);
+  void endObject();
+  void beginArray();
+  void endArray();
+
+  // Distinct names (not overloads): int32_t is `int` on some toolchains
+  // and `long` on others, which would make overloads ambiguous.
+  void addBool(const char* key, bool value);
+  void addInt(const char* key, int32_t value);
+  void addUint(const char* key, uint32_t value);
+  void addUint64(const char* key, uint64_t value);
+  // NaN / inf are written as null. Trailing fractional zeros are trimmed.
+  void addFloat(const char* key, float value, uint8_t decimals = 2);
+  void addString(const char* key, const char* value);
+  void addNull(const char* key);
+
+  bool ok() const { return ok_; }
+  size_t length() const { return length_; }
+  // Buffer mode only (empty string when writing to a Print).
+  const char* c_str() const { return buffer_ != nullptr ? buffer_ : ""; }
+
+ private:
+  char* buffer_ = nullptr;
+  size_t capacity_ = 0;
+  Print* out_ = nullptr;
+  size_t length_ = 0;
+  bool ok_ = true;
+  bool needComma_ = false;
+
+  void put_(char c);
+  void putRaw_(const char* text);
+  void putString_(const char* text);
+  void putUnsigned_(uint32_t value);
+  void putUnsigned64_(uint64_t value);
+  void key_(const char* key);
+  void open_(char bracket);
+  void close_(char bracket);
+};
+
+// Worst-case bytes for one `"key":value,` field, for compile-time payload
+// bounds (see app::Telemetry::kMaxJsonBytes).
+template <size_t N>
+constexpr size_t jsonFieldBound(const char (&)[N], size_t valueMaxChars) {
+  return (N - 1) + 2 /* quotes */ + 1 /* colon */ + valueMaxChars + 1 /* comma */;
+}
+
+constexpr size_t kJsonBoolMaxChars = 5;     // false
+constexpr size_t kJsonUint32MaxChars = 10;  // 4294967295
+constexpr size_t kJsonUint64MaxChars = 20;  // 18446744073709551615
+constexpr size_t kJsonInt32MaxChars = 11;   // -2147483648
+constexpr size_t kJsonFloatMaxChars = 14;   // -2147483647.99 (or null)
+
+}  // namespace util
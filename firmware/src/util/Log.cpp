@@ -0,0 +1,328 @@
+#include "util/Log.h"
+
+#include <freertos/task.h>
+#include <stdarg.h>
+
+namespace util {
+
+namespace {
+
+constexpr size_t kHeaderBytes = 12;
+
+void putWord(uint8_t* dst, uint32_t word) {
+  dst[0] = (uint8_t)word;
+  dst[1] = (uint8_t)(word >> 8);
+  dst[2] = (uint8_t)(word >> 16);
+  dst[3] = (uint8_t)(word >> 24);
+}
+
+uint32_t getWord(const uint8_t* src) {
+  return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) |
+         ((uint32_t)src[3] << 24);
+}
+
+// One text line; longer lines are cut (the end of line is kept).
+class LineBuffer {
+ public:
+  void append(const char* s, size_t length) {
+    const size_t room = kBytes - 2 - length_;
+    if (length > room) {
+      length = room;
+    }
+    memcpy(buf_ + length_, s, length);
+    length_ += length;
+  }
+
+  void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    const size_t room = kBytes - 2 - length_;
+    va_list args;
+    va_start(args, fmt);
+    // vsnprintf() always terminates, so one byte of room is lost to it.
+    const int n = vsnprintf(buf_ + length_, room + 1, fmt, args);
+    va_end(args);
+    if (n > 0) {
+      length_ += (size_t)n < room ? (size_t)n : room;
+    }
+  }
+
+  void send(Print& out) {
+    buf_[length_++] = '\r';
+    buf_[length_++] = '\n';
+    out.write(reinterpret_cast<const uint8_t*>(buf_), length_);
+  }
+
+ private:
+  static constexpr size_t kBytes = 160;
+  char buf_[kBytes + 1];
+  size_t length_ = 0;
+};
+
+}  // namespace
+
+// ---- Record ----
+
+Log::Record::Record(uint8_t level, const char* fmt) {
+  buf_[0] = kHeaderBytes;
+  buf_[1] = (uint8_t)((level & 0x07) | ((xPortGetCoreID() & 0x01) << 3));
+  buf_[2] = 0;
+  buf_[3] = 0;
+  putWord(buf_ + 4, millis());
+  putWord(buf_ + 8, (uint32_t)(uintptr_t)fmt);
+}
+
+void Log::Record::setType_(ArgType type) {
+  buf_[2] |= (uint8_t)(type << (2 * argc_));
+  ++argc_;
+  buf_[1] = (uint8_t)((buf_[1] & 0x0F) | (argc_ << 4));
+}
+
+void Log::Record::addWord_(ArgType type, uint32_t word) {
+  if (argc_ >= kMaxArgs || (size_t)buf_[0] + 4 > kMaxRecordBytes) {
+    return;
+  }
+  putWord(buf_ + buf_[0], word);
+  buf_[0] += 4;
+  setType_(type);
+}
+
+void Log::Record::add(int v) { addWord_(kArgInt, (uint32_t)v); }
+void Log::Record::add(unsigned v) { addWord_(kArgUInt, (uint32_t)v); }
+void Log::Record::add(long v) { addWord_(kArgInt, (uint32_t)v); }
+void Log::Record::add(unsigned long v) { addWord_(kArgUInt, (uint32_t)v); }
+
+void Log::Record::add(double v) {
+  const float f = (float)v;
+  uint32_t word;
+  memcpy(&word, &f, sizeof(word));
+  addWord_(kArgFloat, word);
+}
+
+// Copied, not referenced: the caller's buffer is gone by drain time.
+// Truncated to what is left of the record.
+void Log::Record::add(const char* s) {
+  if (argc_ >= kMaxArgs || (size_t)buf_[0] + 1 > kMaxRecordBytes) {
+    return;
+  }
+  if (s == nullptr) {
+    s = "(null)";
+  }
+  const size_t room = kMaxRecordBytes - buf_[0] - 1;
+  size_t length = strlen(s);
+  if (length > room) {
+    length = room;
+  }
+  buf_[buf_[0]] = (uint8_t)length;
+  memcpy(buf_ + buf_[0] + 1, s, length);
+  buf_[0] += (uint8_t)(1 + length);
+  setType_(kArgString);
+}
+
+// ---- Ring ----
+
+Log& Log::instance() {
+  static Log log;
+  return log;
+}
+
+void Log::push(const Record& record) {
+  const uint8_t* data = record.data();
+  const uint32_t length = record.length();
+
+  portENTER_CRITICAL(&mux_);
+  const uint32_t used = head_ - tail_;
+  if (used + length > kRingBytes) {
+    ++stats_.dropped;
+    portEXIT_CRITICAL(&mux_);
+    return;
+  }
+  const uint32_t start = head_ % kRingBytes;
+  const uint32_t first = length < kRingBytes - start ? length : kRingBytes - start;
+  memcpy(ring_ + start, data, first);
+  memcpy(ring_, data + first, length - first);
+  head_ += length;
+  ++stats_.written;
+  if (used + length > stats_.peakBytes) {
+    stats_.peakBytes = used + length;
+  }
+  portEXIT_CRITICAL(&mux_);
+}
+
+bool Log::pop_(uint8_t* record) {
+  portENTER_CRITICAL(&mux_);
+  if (head_ == tail_) {
+    portEXIT_CRITICAL(&mux_);
+    return false;
+  }
+  const uint32_t start = tail_ % kRingBytes;
+  const uint32_t length = ring_[start];
+  const uint32_t first = length < kRingBytes - start ? length : kRingBytes - start;
+  memcpy(record, ring_ + start, first);
+  memcpy(record + first, ring_, length - first);
+  tail_ += length;
+  portEXIT_CRITICAL(&mux_);
+  return true;
+}
+
+Log::Stats Log::stats() const {
+  portENTER_CRITICAL(&mux_);
+  const Stats copy = stats_;
+  portEXIT_CRITICAL(&mux_);
+  return copy;
+}
+
+size_t Log::drain(Print& out, bool binary, size_t maxRecords) {
+  uint8_t record[kMaxRecordBytes];
+  size_t count = 0;
+  while (count < maxRecords && pop_(record)) {
+    emit_(out, binary, record);
+    ++count;
+  }
+
+  const uint32_t dropped = stats().dropped;
+  if (dropped != droppedReported_) {
+    Record notice(SG_LOG_LEVEL_WARN, nullptr);
+    notice.add((unsigned long)(dropped - droppedReported_));
+    droppedReported_ = dropped;
+    emit_(out, binary, notice.data());
+  }
+  return count;
+}
+
+void Log::emit_(Print& out, bool binary, const uint8_t* record) {
+  if (!binary) {
+    formatText_(out, record);
+    return;
+  }
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < record[0]; ++i) {
+    sum += record[i];
+  }
+  out.write(kFrameMarker);
+  out.write(record, record[0]);
+  out.write(sum);
+}
+
+// Text mode: each conversion is handed to snprintf() on its own, with the
+// stored argument cast to what the conversion expects. The line is built
+// in a buffer and sent with one write(), so prints from other tasks cannot
+// land in the middle of it.
+void Log::formatText_(Print& out, const uint8_t* record) {
+  static const char kLevels[] = "?EWID";
+  const uint8_t level = record[1] & 0x07;
+  const uint8_t argc = record[1] >> 4;
+  const uint8_t types = record[2];
+  const char* fmt = reinterpret_cast<const char*>((uintptr_t)getWord(record + 8));
+
+  LineBuffer line;
+  line.printf("[%lu] %c: ", (unsigned long)getWord(record + 4), kLevels[level < 5 ? level : 0]);
+  if (fmt == nullptr) {
+    line.printf("%lu log records dropped", (unsigned long)getWord(record + 12));
+    line.send(out);
+    return;
+  }
+
+  size_t offset = kHeaderBytes;
+  uint8_t arg = 0;
+  const char* p = fmt;
+  while (*p != '\0') {
+    if (*p != '%') {
+      const char* end = strchr(p, '%');
+      const size_t length = end != nullptr ? (size_t)(end - p) : strlen(p);
+      line.append(p, length);
+      p += length;
+      continue;
+    }
+    if (p[1] == '%') {
+      line.append("%", 1);
+      p += 2;
+      continue;
+    }
+
+    // Copy "%[flags][width][.precision]", skip length modifiers.
+    char spec[16];
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && n < sizeof(spec) - 3) {
+      spec[n++] = *p++;
+    }
+    while (*p != '\0' && strchr("hlzjtL", *p) != nullptr) {
+      ++p;
+    }
+    const char conv = *p;
+    if (conv == '\0') {
+      break;
+    }
+    ++p;
+    spec[n++] = conv;
+    spec[n] = '\0';
+
+    if (arg >= argc) {
+      line.append(spec, n);
+      continue;
+    }
+    const uint8_t type = (types >> (2 * arg)) & 0x03;
+    ++arg;
+
+    if (type == kArgString) {
+      const uint8_t length = record[offset];
+      char s[kMaxRecordBytes];
+      memcpy(s, record + offset + 1, length);
+      s[length] = '\0';
+      offset += 1 + length;
+      if (conv == 's') {
+        line.printf(spec, s);
+      } else {
+        line.append(s, length);
+      }
+      continue;
+    }
+
+    const uint32_t word = getWord(record + offset);
+    offset += 4;
+    float f;
+    memcpy(&f, &word, sizeof(f));
+    if (strchr("feEgGaA", conv) != nullptr) {
+      const double d = type == kArgFloat ? (double)f
+                                         : (type == kArgInt ? (double)(int32_t)word : (double)word);
+      line.printf(spec, d);
+    } else if (strchr("di", conv) != nullptr) {
+      line.printf(spec, type == kArgFloat ? (int)f : (int)(int32_t)word);
+    } else if (strchr("uxXoc", conv) != nullptr) {
+      line.printf(spec, type == kArgFloat ? (unsigned)f : (unsigned)word);
+    } else {
+      line.printf("%lu", (unsigned long)word);
+    }
+  }
+  line.send(out);
+}
+
+// ---- Drain task ----
+
+bool Log::startDrainTask(Print& out, bool binary, uint8_t core, uint32_t stackBytes,
+                         uint8_t priority, uint32_t intervalMs) {
+  if (handle_ != nullptr) {
+    return true;
+  }
+  out_ = &out;
+  binary_ = binary;
+  intervalMs_ = intervalMs > 0 ? intervalMs : 1;
+
+  const BaseType_t ok =
+      xTaskCreatePinnedToCore(taskEntry_, "log", stackBytes, this, priority, &handle_, core);
+  if (ok != pdPASS) {
+    handle_ = nullptr;
+    Serial.println("Failed to start log task");
+    return false;
+  }
+  return true;
+}
+
+void Log::taskEntry_(void* arg) {
+  Log* log = static_cast<Log*>(arg);
+  for (;;) {
+    log->drain(*log->out_, log->binary_);
+    vTaskDelay(pdMS_TO_TICKS(log->intervalMs_));
+  }
+}
+
+}  // namespace util
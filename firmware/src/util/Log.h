@@ -0,0 +1,163 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Compile-time log level: build with -D SG_LOG_LEVEL=<n> to change it.
+// Statements above the level compile to dead code (arguments are not
+// evaluated), so disabled debug logging costs neither flash nor time.
+#define SG_LOG_LEVEL_NONE 0
+#define SG_LOG_LEVEL_ERROR 1
+#define SG_LOG_LEVEL_WARN 2
+#define SG_LOG_LEVEL_INFO 3
+#define SG_LOG_LEVEL_DEBUG 4
+
+#ifndef SG_LOG_LEVEL
+#define SG_LOG_LEVEL SG_LOG_LEVEL_INFO
+#endif
+
+// For work that only feeds a log statement: if (SG_LOG_ENABLED(...)) {...}
+#define SG_LOG_ENABLED(level) (SG_LOG_LEVEL >= (level))
+
+namespace util {
+
+// Deferred logger. SG_LOGx("fmt %d", x) does not format or touch the UART:
+// it copies the format string's address, a timestamp and the raw arguments
+// (4 bytes per number, strings copied inline) into a RAM ring, which takes
+// a few microseconds. A low-priority task drains the ring to Serial, either
+// formatted on the device (text mode) or as compact binary frames that
+// scripts/log_decode.py turns back into text using firmware.elf.
+//
+// Callable from any task on either core (not from ISRs). When the ring is
+// full new records are dropped and counted.
+//
+// Formats are printf-style: %d %i %u %x %X %o %c %f %e %g %s, with flags,
+// width and precision; length modifiers (l, h, z) are ignored since every
+// number is stored as 32 bits. Format strings must be literals.
+class Log {
+ public:
+  static constexpr uint8_t kMaxArgs = 4;
+  static constexpr size_t kMaxRecordBytes = 96;
+  static constexpr size_t kRingBytes = 4096;
+
+  // Argument types, 2 bits each in the record header.
+  enum ArgType : uint8_t { kArgInt = 0, kArgUInt = 1, kArgFloat = 2, kArgString = 3 };
+
+  // One record, built on the caller's stack:
+  //   [0] length  [1] level | core << 3 | argc << 4  [2] arg types  [3] 0
+  //   [4..7] millis()  [8..11] format address  [12..] arguments
+  // Numbers are 4 bytes little-endian; strings are a length byte + bytes.
+  class Record {
+   public:
+    Record(uint8_t level, const char* fmt);
+
+    void add(int v);
+    void add(unsigned v);
+    void add(long v);
+    void add(unsigned long v);
+    void add(bool v) { add((int)v); }
+    void add(double v);
+    void add(const char* s);
+    void add(const String& s) { add(s.c_str()); }
+
+    const uint8_t* data() const { return buf_; }
+    uint8_t length() const { return buf_[0]; }
+
+   private:
+    uint8_t buf_[kMaxRecordBytes];
+    uint8_t argc_ = 0;
+
+    void addWord_(ArgType type, uint32_t word);
+    void setType_(ArgType type);
+  };
+
+  struct Stats {
+    uint32_t written = 0;
+    uint32_t dropped = 0;
+    uint32_t peakBytes = 0;  // Ring high-water mark
+  };
+
+  static Log& instance();
+
+  template <typename... Args>
+  static void discard(const char*, const Args&...) {}
+
+  template <typename... Args>
+  void write(uint8_t level, const char* fmt, const Args&... args) {
+    static_assert(sizeof...(Args) <= kMaxArgs, "at most 4 log arguments");
+    Record record(level, fmt);
+    const int expand[] = {0, (record.add(args), 0)...};
+    (void)expand;
+    push(record);
+  }
+
+  void push(const Record& record);
+
+  // Writes queued records to `out`; returns how many. Called by the drain
+  // task, or directly (e.g. before a restart).
+  size_t drain(Print& out, bool binary, size_t maxRecords = SIZE_MAX);
+
+  // Returns false if the task could not be created.
+  bool startDrainTask(Print& out, bool binary, uint8_t core, uint32_t stackBytes,
+                      uint8_t priority, uint32_t intervalMs);
+
+  Stats stats() const;
+
+  // Binary frame: kFrameMarker, record bytes, 8-bit sum of the record.
+  // A record with format address 0 reports dropped records (one UInt).
+  static constexpr uint8_t kFrameMarker = 0xA5;
+
+ private:
+  uint8_t ring_[kRingBytes];
+  uint32_t head_ = 0;  // Free-running byte counters
+  uint32_t tail_ = 0;
+  Stats stats_;
+  uint32_t droppedReported_ = 0;
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  Print* out_ = nullptr;
+  bool binary_ = false;
+  uint32_t intervalMs_ = 20;
+  TaskHandle_t handle_ = nullptr;
+
+  Log() = default;
+
+  bool pop_(uint8_t* record);
+  void emit_(Print& out, bool binary, const uint8_t* record);
+  static void formatText_(Print& out, const uint8_t* record);
+  static void taskEntry_(void* arg);
+};
+
+}  // namespace util
+
+// Disabled levels: the call sits in dead code, so arguments still count as
+// used (no warnings) but nothing is evaluated or emitted.
+#define SG_LOG_DISCARD_(...)                  \
+  do {                                        \
+    if (false) {                              \
+      ::util::Log::discard(__VA_ARGS__);      \
+    }                                         \
+  } while (0)
+
+#if SG_LOG_LEVEL >= SG_LOG_LEVEL_ERROR
+#define SG_LOGE(...) ::util::Log::instance().write(SG_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define SG_LOGE(...) SG_LOG_DISCARD_(__VA_ARGS__)
+#endif
+
+#if SG_LOG_LEVEL >= SG_LOG_LEVEL_WARN
+#define SG_LOGW(...) ::util::Log::instance().write(SG_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define SG_LOGW(...) SG_LOG_DISCARD_(__VA_ARGS__)
+#endif
+
+#if SG_LOG_LEVEL >= SG_LOG_LEVEL_INFO
+#define SG_LOGI(...) ::util::Log::instance().write(SG_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define SG_LOGI(...) SG_LOG_DISCARD_(__VA_ARGS__)
+#endif
+
+#if SG_LOG_LEVEL >= SG_LOG_LEVEL_DEBUG
+#define SG_LOGD(...) ::util::Log::instance().write(SG_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define SG_LOGD(...) SG_LOG_DISCARD_(__VA_ARGS__)
+#endif
@@ -0,0 +1,154 @@
+#include "util/PerfMonitor.h"
+
+#if SG_PERF_ENABLED
+
+namespace util {
+
+namespace {
+
+const char* const kStageNames[] = {
+    "wifi", "mqtt_conn", "mqtt_loop", "dht", "lux", "adc", "rtc", "json", "flash", "mqtt_rx",
+};
+
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) == (size_t)PerfStage::kCount,
+              "kStageNames must match PerfStage");
+
+}  // namespace
+
+PerfMonitor& PerfMonitor::instance() {
+  static PerfMonitor monitor;
+  return monitor;
+}
+
+PerfMonitor::PerfMonitor() {
+  const uint32_t mhz = ESP.getCpuFreqMHz();
+  cyclesPerUs_ = mhz > 0 ? mhz : 240;
+  reset();
+}
+
+const char* PerfMonitor::stageName(PerfStage stage) {
+  const uint8_t index = (uint8_t)stage;
+  return index < (uint8_t)PerfStage::kCount ? kStageNames[index] : "?";
+}
+
+// Values 0..3 map 1:1; above that, 4 sub-buckets per power of two.
+uint8_t PerfMonitor::bucketFor_(uint32_t us) {
+  if (us < 4) {
+    return (uint8_t)us;
+  }
+  const uint8_t msb = (uint8_t)(31 - __builtin_clz(us));
+  const uint8_t sub = (uint8_t)((us >> (msb - 2)) & 0x3);
+  const uint16_t bucket = (uint16_t)((msb - 1) * 4 + sub);
+  return bucket < kBuckets ? (uint8_t)bucket : (uint8_t)(kBuckets - 1);
+}
+
+uint32_t PerfMonitor::bucketUpperUs_(uint8_t bucket) {
+  if (bucket < 4) {
+    return bucket;
+  }
+  const uint8_t msb = (uint8_t)(bucket / 4 + 1);
+  const uint32_t sub = bucket % 4;
+  const uint32_t width = 1UL << (msb - 2);
+  return ((4 + sub) << (msb - 2)) + width - 1;
+}
+
+void PerfMonitor::record(PerfStage stage, uint32_t cycles) {
+  const uint8_t index = (uint8_t)stage;
+  if (index >= (uint8_t)PerfStage::kCount) {
+    return;
+  }
+  const uint32_t us = cycles / cyclesPerUs_;
+  const uint8_t bucket = bucketFor_(us);
+
+  portENTER_CRITICAL(&mux_);
+  StageData& data = stages_[index];
+  if (data.count == 0 || us < data.minUs) {
+    data.minUs = us;
+  }
+  if (us > data.maxUs) {
+    data.maxUs = us;
+  }
+  ++data.count;
+  if (data.buckets[bucket] != UINT16_MAX) {
+    ++data.buckets[bucket];
+  }
+  portEXIT_CRITICAL(&mux_);
+}
+
+uint32_t PerfMonitor::percentile_(const StageData& data, uint32_t pct) {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < kBuckets; ++i) {
+    total += data.buckets[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  const uint32_t target = (total * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < kBuckets; ++i) {
+    seen += data.buckets[i];
+    if (seen >= target) {
+      const uint32_t upper = bucketUpperUs_(i);
+      return upper < data.maxUs ? upper : data.maxUs;
+    }
+  }
+  return data.maxUs;
+}
+
+PerfMonitor::StageSummary PerfMonitor::summary(PerfStage stage) const {
+  StageSummary out;
+  const uint8_t index = (uint8_t)stage;
+  if (index >= (uint8_t)PerfStage::kCount) {
+    return out;
+  }
+
+  StageData snapshot;
+  portENTER_CRITICAL(&mux_);
+  snapshot = stages_[index];
+  portEXIT_CRITICAL(&mux_);
+
+  out.count = snapshot.count;
+  out.minUs = snapshot.minUs;
+  out.maxUs = snapshot.maxUs;
+  out.p50Us = percentile_(snapshot, 50);
+  out.p99Us = percentile_(snapshot, 99);
+  return out;
+}
+
+uint8_t PerfMonitor::writeTelemetryJson(JsonWriter& json, uint8_t firstStage,
+                                        uint8_t stageCount) const {
+  uint8_t written = 0;
+  json.beginObject();
+  for (uint8_t i = firstStage; i < firstStage + stageCount && i < (uint8_t)PerfStage::kCount; ++i) {
+    const StageSummary s = summary((PerfStage)i);
+    if (s.count == 0) {
+      continue;
+    }
+    char key[32];
+    const char* name = kStageNames[i];
+    snprintf(key, sizeof(key), "perf_%s_n", name);
+    json.addUint(key, s.count);
+    snprintf(key, sizeof(key), "perf_%s_min_us", name);
+    json.addUint(key, s.minUs);
+    snprintf(key, sizeof(key), "perf_%s_max_us", name);
+    json.addUint(key, s.maxUs);
+    snprintf(key, sizeof(key), "perf_%s_p50_us", name);
+    json.addUint(key, s.p50Us);
+    snprintf(key, sizeof(key), "perf_%s_p99_us", name);
+    json.addUint(key, s.p99Us);
+    ++written;
+  }
+  json.endObject();
+  return json.ok() ? written : 0;
+}
+
+void PerfMonitor::reset() {
+  portENTER_CRITICAL(&mux_);
+  memset(stages_, 0, sizeof(stages_));
+  portEXIT_CRITICAL(&mux_);
+}
+
+}  // namespace util
+
+#endif  // SG_PERF_ENABLED
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "util/JsonWriter.h"
+
+// Compile-time switch: build with -D SG_PERF_ENABLED=0 to remove all
+// instrumentation (SG_PERF_SCOPE expands to nothing, no tables in RAM).
+#ifndef SG_PERF_ENABLED
+#define SG_PERF_ENABLED 1
+#endif
+
+namespace util {
+
+// Stages timed with SG_PERF_SCOPE. Keys in telemetry are perf_<name>_*.
+enum class PerfStage : uint8_t {
+  WifiEnsure,     // WiFiManager::ensureConnected (network task)
+  MqttConnect,    // ThingsBoardClient::ensureConnected (network task)
+  MqttLoop,       // ThingsBoardClient::loop (network task)
+  DhtRead,
+  LuxRead,
+  AdcDrain,       // AdcScanner::update (MQ-135 and other analog channels)
+  RtcLog,
+  TelemetryBuild,
+  FlashLog,       // storage::FlashRingLog append / replay (telemetry backlog)
+  MqttInbound,    // Inbound RPC / attribute parse + handler (app side)
+  kCount
+};
+
+}  // namespace util
+
+#if SG_PERF_ENABLED
+
+namespace util {
+
+// Per-stage latency histograms fed from the CPU cycle counter.
+//
+// Each stage keeps exact min/max plus a fixed log-linear histogram
+// (4 sub-buckets per power of two, ~19% resolution) from which p50/p99 are
+// estimated. Memory is fixed: no allocation after boot. Stages may be
+// recorded from either core; a spinlock keeps updates and snapshots atomic.
+class PerfMonitor {
+ public:
+  struct StageSummary {
+    uint32_t count = 0;
+    uint32_t minUs = 0;
+    uint32_t maxUs = 0;
+    uint32_t p50Us = 0;
+    uint32_t p99Us = 0;
+  };
+
+  static PerfMonitor& instance();
+
+  void record(PerfStage stage, uint32_t cycles);
+
+  StageSummary summary(PerfStage stage) const;
+  static const char* stageName(PerfStage stage);
+
+  // Writes one JSON object with perf_<stage>_{n,min_us,max_us,p50_us,p99_us}
+  // for stages [firstStage, firstStage + stageCount). Split across several
+  // publishes so each fits the MQTT buffer. Returns the number of stages
+  // written (stages without samples are left out; 0 = nothing to publish).
+  uint8_t writeTelemetryJson(JsonWriter& json, uint8_t firstStage, uint8_t stageCount) const;
+
+  // Start a new reporting window.
+  void reset();
+
+ private:
+  static constexpr uint8_t kBuckets = 96;  // Covers up to 2^24 us (~16 s)
+
+  struct StageData {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint16_t buckets[kBuckets];
+  };
+
+  StageData stages_[(uint8_t)PerfStage::kCount];
+  uint32_t cyclesPerUs_ = 240;
+  mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+
+  PerfMonitor();
+
+  static uint8_t bucketFor_(uint32_t us);
+  static uint32_t bucketUpperUs_(uint8_t bucket);
+  static uint32_t percentile_(const StageData& data, uint32_t pct);
+};
+
+// RAII timer: records the cycles spent in the enclosing scope.
+class PerfScope {
+ public:
+  explicit PerfScope(PerfStage stage) : stage_(stage), start_(ESP.getCycleCount()) {}
+  ~PerfScope() { PerfMonitor::instance().record(stage_, ESP.getCycleCount() - start_); }
+
+ private:
+  const PerfStage stage_;
+  const uint32_t start_;
+};
+
+}  // namespace util
+
+#define SG_PERF_CONCAT_(a, b) a##b
+#define SG_PERF_CONCAT(a, b) SG_PERF_CONCAT_(a, b)
+#define SG_PERF_SCOPE(stage) \
+  ::util::PerfScope SG_PERF_CONCAT(sgPerfScope_, __LINE__)(::util::PerfStage::stage)
+
+#else
+
+#define SG_PERF_SCOPE(stage) \
+  do {                       \
+  } while (0)
+
+#endif  // SG_PERF_ENABLED
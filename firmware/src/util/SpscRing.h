@@ -0,0 +1,126 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+// Producer-side methods are force-inlined so an IRAM_ATTR ISR that pushes
+// into a ring never calls out to flash-resident code.
+#define SG_RING_INLINE inline __attribute__((always_inline))
+
+namespace util {
+
+// Lock-free single-producer / single-consumer ring buffer.
+//
+// Exactly one task (or ISR) may push and exactly one task may pop; the two
+// sides may run on different cores. Capacity must be a power of two. Indices
+// are free-running 32-bit counters, so full/empty need no spare slot.
+//
+// Besides copying push()/pop(), the ring offers in-place access
+// (producerSlot()/commitPush(), consumerSlot()/commitPop()) so large
+// messages are filled and consumed without an extra copy on the stack.
+template <typename T, uint32_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+ public:
+  // ---- Producer side ----
+
+  // Returns a free slot to fill, or nullptr if the ring is full.
+  SG_RING_INLINE T* producerSlot() { return producerSlotAt(0); }
+
+  // Like producerSlot(), but `offset` slots past the next free one, so a
+  // multi-slot message can be filled before any of it becomes visible.
+  SG_RING_INLINE T* producerSlotAt(uint32_t offset) {
+    const uint32_t head = head_.load(std::memory_order_relaxed) + offset;
+    const uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= Capacity) {
+      return nullptr;
+    }
+    return &slots_[head & kMask];
+  }
+
+  // Publish the next `count` slots filled via producerSlot()/producerSlotAt().
+  // The consumer sees all of them at once.
+  SG_RING_INLINE void commitPush(uint32_t count = 1) {
+    head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  SG_RING_INLINE bool push(const T& item) {
+    T* slot = producerSlot();
+    if (slot == nullptr) {
+      ++dropped_;
+      return false;
+    }
+    *slot = item;
+    commitPush();
+    return true;
+  }
+
+  // Count a message the producer had to discard (full ring).
+  SG_RING_INLINE void noteDropped() { ++dropped_; }
+
+  // Only meaningful on the producer side.
+  uint32_t dropped() const { return dropped_; }
+
+  // ---- Consumer side ----
+
+  // Returns the oldest item, or nullptr if the ring is empty.
+  T* consumerSlot() {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    const uint32_t head = head_.load(std::memory_order_acquire);
+    if (head == tail) {
+      return nullptr;
+    }
+    return &slots_[tail & kMask];
+  }
+
+  // Like consumerSlot(), but `offset` items past the oldest one (nullptr if
+  // fewer are queued), so the consumer can read ahead of what it releases.
+  T* consumerSlotAt(uint32_t offset) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed) + offset;
+    const uint32_t head = head_.load(std::memory_order_acquire);
+    if (head - tail == 0 || head - tail > Capacity) {
+      return nullptr;
+    }
+    return &slots_[tail & kMask];
+  }
+
+  // Release the oldest `count` slots (consumerSlot()/consumerSlotAt()).
+  void commitPop(uint32_t count = 1) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  bool pop(T& out) {
+    T* slot = consumerSlot();
+    if (slot == nullptr) {
+      return false;
+    }
+    out = *slot;
+    commitPop();
+    return true;
+  }
+
+  // ---- Either side (approximate while the other side is active) ----
+
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr uint32_t capacity() { return Capacity; }
+
+ private:
+  static constexpr uint32_t kMask = Capacity - 1;
+
+  T slots_[Capacity];
+
+  // Written by producer only.
+  std::atomic<uint32_t> head_{0};
+  // Written by consumer only.
+  std::atomic<uint32_t> tail_{0};
+
+  uint32_t dropped_ = 0;
+};
+
+}  // namespace util
@@ -0,0 +1,94 @@
+#pragma once
+
+// Host stand-in for the few Arduino APIs used by the modules under test
+// ([env:native] only). Time is simulated: millis() returns host::nowMs(),
+// which tests set directly; delay() advances it. digitalWrite() records
+// the level and time per pin (host::pin()); other GPIO calls do nothing.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define CHANGE 0x03
+
+namespace host {
+
+inline uint32_t& nowMs() {
+  static uint32_t ms = 0;
+  return ms;
+}
+
+// Last digitalWrite() per pin.
+struct Pin {
+  uint8_t level = 0;
+  uint32_t writeMs = 0;
+  uint32_t writes = 0;
+};
+
+inline Pin& pin(uint8_t number) {
+  static Pin pins[64];
+  return pins[number % 64];
+}
+
+}  // namespace host
+
+inline unsigned long millis() { return host::nowMs(); }
+inline unsigned long micros() { return (unsigned long)host::nowMs() * 1000UL; }
+inline void delay(uint32_t ms) { host::nowMs() += ms; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  host::Pin& p = host::pin(pin);
+  p.level = level;
+  p.writeMs = host::nowMs();
+  ++p.writes;
+}
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+inline void detachInterrupt(uint8_t) {}
+
+class Print {
+ public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n]) == 1) {
+      ++n;
+    }
+    return n;
+  }
+
+  size_t print(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+  size_t print(double value, int digits = 2) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+  }
+  size_t println(const char* s = "") { return print(s) + print("\r\n"); }
+};
+
+class HardwareSerial : public Print {
+ public:
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+};
+
+inline HardwareSerial& hostSerial() {
+  static HardwareSerial serial;
+  return serial;
+}
+
+#define Serial hostSerial()
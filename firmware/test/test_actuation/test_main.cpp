@@ -0,0 +1,199 @@
+#include <unity.h>
+
+#include <chrono>
+
+#include "actuators/RelayActuator.h"
+#include "app/Scheduler.h"
+#include "app/Settings.h"
+#include "controllers/LightController.h"
+#include "controllers/WateringController.h"
+
+// Command-to-GPIO latency on the simulated clock: a remote command applied
+// from the network task reaches the relay pin through the Settings change
+// handler (as in main.cpp) in the same scheduler pass, where polling the
+// settings from the controller tick waits for that tick.
+
+namespace {
+
+constexpr uint8_t kPinLight = 26;
+constexpr uint8_t kPinValve = 27;
+constexpr uint32_t kNetworkPeriodMs = 20;
+constexpr uint32_t kControllerPeriodMs = 50;
+// Applied at the first network tick from here (1020); the controller tick
+// after it is at 1050.
+constexpr uint32_t kCommandAtMs = 1010;
+
+uint32_t fakeNow() { return host::nowMs(); }
+void fakeSleep(uint32_t ms) { host::nowMs() += ms; }
+
+struct Rig {
+  app::Settings settings;
+  actuators::RelayActuator lightRelay{kPinLight, false};
+  actuators::RelayActuator valveRelay{kPinValve, false};
+  controllers::LightController light{lightRelay, 0.5f};
+  controllers::WateringController watering{valveRelay};
+  sensors::DhtReading dht;
+  app::Scheduler scheduler;
+};
+
+Rig* gRig = nullptr;
+bool gPolling = false;  // Controllers follow Settings only from their tick
+
+enum class Command : uint8_t { None, ValveAttribute, ManualOffRpc };
+Command gCommand = Command::None;
+uint32_t gCommandAppliedMs = 0;
+bool gCommandApplied = false;
+
+// main.cpp's onSettingsChanged().
+void onSettingsChanged(app::Settings::Change change) {
+  const uint32_t nowMs = millis();
+  switch (change) {
+    case app::Settings::Change::Light:
+      gRig->light.update(nowMs, false, gRig->dht, gRig->settings);
+      break;
+    case app::Settings::Change::Valve:
+      gRig->watering.setSelfValveEnable(gRig->settings.selfValveEnable());
+      gRig->watering.update(nowMs);
+      break;
+  }
+}
+
+// Stands in for processInbound(): what the attribute and RPC handlers do
+// to Settings.
+void taskNetwork(uint32_t nowMs) {
+  if (gCommand == Command::None || gCommandApplied || (int32_t)(nowMs - kCommandAtMs) < 0) {
+    return;
+  }
+  switch (gCommand) {
+    case Command::ValveAttribute:
+      gRig->settings.setSelfValveEnable(true);  // self_valve_enable = true
+      break;
+    case Command::ManualOffRpc:
+      gRig->settings.setManualOff(true);  // setManualOff(true)
+      break;
+    case Command::None:
+      break;
+  }
+  gCommandApplied = true;
+  gCommandAppliedMs = nowMs;
+}
+
+void taskControllers(uint32_t nowMs) {
+  if (gPolling) {
+    gRig->watering.setSelfValveEnable(gRig->settings.selfValveEnable());
+  }
+  gRig->light.update(nowMs, false, gRig->dht, gRig->settings);
+  gRig->watering.update(nowMs);
+}
+
+void setUpRig(Rig& rig, bool polling, Command command) {
+  host::nowMs() = 0;
+  gRig = &rig;
+  gPolling = polling;
+  gCommand = command;
+  gCommandApplied = false;
+  gCommandAppliedMs = 0;
+
+  rig.lightRelay.begin();
+  rig.valveRelay.begin();
+  if (!polling) {
+    rig.settings.setChangeHandler(onSettingsChanged);
+  }
+  rig.scheduler.setClock(fakeNow, fakeSleep);
+  rig.scheduler.begin(host::nowMs());
+  rig.scheduler.addTask("network", taskNetwork, kNetworkPeriodMs, 40);
+  rig.scheduler.addTask("controllers", taskControllers, kControllerPeriodMs, 30);
+}
+
+// Runs scheduler passes until the command was applied and `pin` is at
+// `level`. Returns the command-to-GPIO latency (ms) and the passes it took
+// after the one that applied the command.
+uint32_t runUntilActuated(Rig& rig, uint8_t pin, uint8_t level, uint32_t& extraPasses) {
+  extraPasses = 0;
+  while (host::nowMs() < 10000) {
+    const bool appliedBefore = gCommandApplied;
+    rig.scheduler.runDue(host::nowMs());
+    if (gCommandApplied && appliedBefore) {
+      ++extraPasses;
+    }
+    if (gCommandApplied && host::pin(pin).level == level) {
+      return host::pin(pin).writeMs - gCommandAppliedMs;
+    }
+    rig.scheduler.sleepUntilNextDeadline(100);
+  }
+  TEST_FAIL_MESSAGE("relay never actuated");
+  return 0;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {
+  gRig = nullptr;
+}
+
+void test_attribute_opens_valve_in_the_same_pass() {
+  Rig rig;
+  setUpRig(rig, false, Command::ValveAttribute);
+
+  uint32_t extraPasses = 0;
+  const uint32_t latencyMs = runUntilActuated(rig, kPinValve, HIGH, extraPasses);
+  TEST_ASSERT_EQUAL_UINT32(0, latencyMs);
+  TEST_ASSERT_EQUAL_UINT32(0, extraPasses);
+  TEST_ASSERT_EQUAL_UINT32(1020, gCommandAppliedMs);
+  TEST_ASSERT_TRUE(rig.watering.state().valveOn);
+}
+
+void test_rpc_switches_light_in_the_same_pass() {
+  Rig rig;
+  setUpRig(rig, false, Command::ManualOffRpc);
+
+  uint32_t extraPasses = 0;
+  const uint32_t latencyMs = runUntilActuated(rig, kPinLight, LOW, extraPasses);
+  TEST_ASSERT_EQUAL_UINT32(0, latencyMs);
+  TEST_ASSERT_EQUAL_UINT32(0, extraPasses);
+  TEST_ASSERT_FALSE(rig.light.state().lightOn);
+}
+
+// Without the change handler the valve waits for the next controller tick.
+void test_polling_waits_for_the_controller_tick() {
+  Rig rig;
+  setUpRig(rig, true, Command::ValveAttribute);
+
+  uint32_t extraPasses = 0;
+  const uint32_t latencyMs = runUntilActuated(rig, kPinValve, HIGH, extraPasses);
+  TEST_ASSERT_EQUAL_UINT32(1050 - 1020, latencyMs);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, extraPasses);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kControllerPeriodMs, latencyMs);
+}
+
+// Host cost of the handler path itself (setter -> handler -> controller ->
+// digitalWrite), reported per command.
+void test_handler_path_cost() {
+  Rig rig;
+  setUpRig(rig, false, Command::None);
+
+  constexpr uint32_t kCommands = 100000;
+  const uint32_t writesBefore = host::pin(kPinLight).writes;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kCommands; ++i) {
+    rig.settings.setManualOff(i % 2 == 0);
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  TEST_ASSERT_EQUAL_UINT32(kCommands, host::pin(kPinLight).writes - writesBefore);
+  const double nsPerCommand =
+      (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / kCommands;
+  char message[64];
+  snprintf(message, sizeof(message), "command-to-GPIO: %.1f ns per command", nsPerCommand);
+  TEST_MESSAGE(message);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_attribute_opens_valve_in_the_same_pass);
+  RUN_TEST(test_rpc_switches_light_in_the_same_pass);
+  RUN_TEST(test_polling_waits_for_the_controller_tick);
+  RUN_TEST(test_handler_path_cost);
+  return UNITY_END();
+}
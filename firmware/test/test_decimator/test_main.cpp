@@ -0,0 +1,118 @@
+#include <unity.h>
+
+#include "util/Decimator.h"
+
+namespace {
+
+// Deterministic noise source (LCG), uniform in [-amplitude, amplitude].
+class Noise {
+ public:
+  explicit Noise(uint32_t seed) : state_(seed) {}
+
+  int next(int amplitude) {
+    state_ = state_ * 1664525u + 1013904223u;
+    return (int)((state_ >> 8) % (uint32_t)(2 * amplitude + 1)) - amplitude;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+struct Moments {
+  double mean;
+  double variance;
+};
+
+Moments moments(const double* values, size_t count) {
+  double sum = 0;
+  for (size_t i = 0; i < count; ++i) {
+    sum += values[i];
+  }
+  const double mean = sum / count;
+  double squares = 0;
+  for (size_t i = 0; i < count; ++i) {
+    squares += (values[i] - mean) * (values[i] - mean);
+  }
+  return Moments{mean, squares / count};
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_rounded_block_mean() {
+  util::Decimator decimator(4);
+  TEST_ASSERT_FALSE(decimator.add(1));
+  TEST_ASSERT_FALSE(decimator.add(2));
+  TEST_ASSERT_FALSE(decimator.add(2));
+  TEST_ASSERT_TRUE(decimator.add(2));
+  TEST_ASSERT_EQUAL_UINT16(2, decimator.output());  // 7 / 4 = 1.75 -> 2
+
+  // The next block starts from scratch.
+  for (int i = 0; i < 3; ++i) {
+    TEST_ASSERT_FALSE(decimator.add(4095));
+  }
+  TEST_ASSERT_TRUE(decimator.add(4095));
+  TEST_ASSERT_EQUAL_UINT16(4095, decimator.output());
+}
+
+void test_factor_zero_passes_through() {
+  util::Decimator decimator(0);
+  TEST_ASSERT_TRUE(decimator.add(123));
+  TEST_ASSERT_EQUAL_UINT16(123, decimator.output());
+}
+
+void test_set_factor_discards_partial_block() {
+  util::Decimator decimator(4);
+  decimator.add(4000);
+  decimator.add(4000);
+  decimator.setFactor(2);
+  TEST_ASSERT_FALSE(decimator.add(10));
+  TEST_ASSERT_TRUE(decimator.add(20));
+  TEST_ASSERT_EQUAL_UINT16(15, decimator.output());
+}
+
+// A 12-bit level plus uniform noise: the block mean keeps the level and
+// cuts the noise variance by about the decimation factor.
+void test_noise_reduction() {
+  constexpr uint32_t kFactor = 64;
+  constexpr size_t kOutputs = 500;
+  constexpr int kLevel = 2048;
+  constexpr int kNoise = 200;
+
+  static double input[kOutputs * kFactor];
+  static double output[kOutputs];
+  util::Decimator decimator(kFactor);
+  Noise noise(12345);
+
+  size_t outputs = 0;
+  for (size_t i = 0; i < kOutputs * kFactor; ++i) {
+    const int sample = kLevel + noise.next(kNoise);
+    input[i] = sample;
+    if (decimator.add((uint16_t)sample)) {
+      output[outputs++] = decimator.output();
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(kOutputs, outputs);
+
+  const Moments in = moments(input, kOutputs * kFactor);
+  const Moments out = moments(output, kOutputs);
+  TEST_ASSERT_FLOAT_WITHIN(2.0, kLevel, in.mean);
+  TEST_ASSERT_FLOAT_WITHIN(2.0, kLevel, out.mean);
+
+  // Ideal reduction is kFactor (64x); allow for the finite sample and the
+  // output rounding to integers.
+  const double reduction = in.variance / out.variance;
+  TEST_ASSERT_TRUE(reduction > kFactor * 0.6);
+  TEST_ASSERT_TRUE(reduction < kFactor * 1.6);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rounded_block_mean);
+  RUN_TEST(test_factor_zero_passes_through);
+  RUN_TEST(test_set_factor_discards_partial_block);
+  RUN_TEST(test_noise_reduction);
+  return UNITY_END();
+}
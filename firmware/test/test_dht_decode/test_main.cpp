@@ -0,0 +1,151 @@
+#include <unity.h>
+
+#include "sensors/DhtSensor.h"
+
+// DhtSensor::decode() on synthetic edge traces, shaped like the ISR's
+// capture of a DHT22 reply: response low/high, 40 bits (50 us low, then a
+// 26 us "0" or 70 us "1" high), release.
+
+namespace {
+
+struct Trace {
+  uint32_t edgeUs[sensors::DhtSensor::kMaxEdges];
+  uint8_t levels[sensors::DhtSensor::kMaxEdges];
+  uint8_t count = 0;
+
+  void edge(uint32_t atUs, uint8_t level) {
+    edgeUs[count] = atUs;
+    levels[count] = level;
+    ++count;
+  }
+
+  void removeEdge(uint8_t index) {
+    for (uint8_t i = index; i + 1 < count; ++i) {
+      edgeUs[i] = edgeUs[i + 1];
+      levels[i] = levels[i + 1];
+    }
+    --count;
+  }
+};
+
+// Bytes as sent: humidity hi/lo, temperature hi/lo (bit 7 = sign), checksum.
+Trace makeTrace(const uint8_t (&bytes)[5]) {
+  Trace trace;
+  uint32_t t = 1000;
+  trace.edge(t, LOW);  // Sensor response: 80 us low, 80 us high
+  t += 80;
+  trace.edge(t, HIGH);
+  t += 80;
+  trace.edge(t, LOW);
+  for (uint8_t bit = 0; bit < 40; ++bit) {
+    t += 50;
+    trace.edge(t, HIGH);
+    t += (bytes[bit / 8] & (0x80 >> (bit % 8))) != 0 ? 70 : 26;
+    trace.edge(t, LOW);
+  }
+  t += 50;
+  trace.edge(t, HIGH);  // Line released
+  return trace;
+}
+
+Trace makeReading(uint16_t humidityTenths, uint16_t tempTenths, bool negative) {
+  uint8_t bytes[5];
+  bytes[0] = (uint8_t)(humidityTenths >> 8);
+  bytes[1] = (uint8_t)humidityTenths;
+  bytes[2] = (uint8_t)((tempTenths >> 8) | (negative ? 0x80 : 0));
+  bytes[3] = (uint8_t)tempTenths;
+  bytes[4] = (uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]);
+  return makeTrace(bytes);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_valid_trace() {
+  const Trace trace = makeReading(652, 351, false);
+  TEST_ASSERT_EQUAL_UINT8(84, trace.count);
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_TRUE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+  TEST_ASSERT_TRUE(reading.ok);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 65.2f, reading.humidityPct);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 35.1f, reading.temperatureC);
+}
+
+void test_negative_temperature() {
+  const Trace trace = makeReading(800, 101, true);
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_TRUE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -10.1f, reading.temperatureC);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 80.0f, reading.humidityPct);
+}
+
+void test_checksum_failure() {
+  const uint8_t bytes[5] = {0x02, 0x8C, 0x01, 0x5F, 0xEF};  // Sum is 0xEE
+  const Trace trace = makeTrace(bytes);
+
+  sensors::DhtReading reading;
+  reading.ok = true;
+  TEST_ASSERT_FALSE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+  TEST_ASSERT_FALSE(reading.ok);
+}
+
+// A bit flipped by noise (a "0" high stretched past the threshold) is
+// caught by the checksum.
+void test_corrupted_bit_fails_checksum() {
+  Trace trace = makeReading(652, 351, false);
+  // Bit 0 is a "0": its high spans edges 3 -> 4. Stretch it to 70 us.
+  const uint32_t shift = 70 - (trace.edgeUs[4] - trace.edgeUs[3]);
+  for (uint8_t i = 4; i < trace.count; ++i) {
+    trace.edgeUs[i] += shift;
+  }
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_FALSE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+}
+
+// A lost falling edge merges two data highs: the response high slides
+// into the 40-bit window and the checksum no longer matches.
+void test_missing_data_edge() {
+  Trace trace = makeReading(652, 351, false);
+  TEST_ASSERT_EQUAL_UINT8(LOW, trace.levels[20]);  // End of bit 8's high
+  trace.removeEdge(20);
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_FALSE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+  TEST_ASSERT_FALSE(reading.ok);
+}
+
+// The first response edge can be missed (the ISR attaches late); only the
+// last 40 highs carry data.
+void test_missing_first_edge_is_harmless() {
+  Trace trace = makeReading(652, 351, false);
+  trace.removeEdge(0);
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_TRUE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, trace.count, reading));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 35.1f, reading.temperatureC);
+}
+
+void test_truncated_trace() {
+  const Trace trace = makeReading(652, 351, false);
+
+  sensors::DhtReading reading;
+  TEST_ASSERT_FALSE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, 40, reading));
+  TEST_ASSERT_FALSE(sensors::DhtSensor::decode(trace.edgeUs, trace.levels, 0, reading));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_valid_trace);
+  RUN_TEST(test_negative_temperature);
+  RUN_TEST(test_checksum_failure);
+  RUN_TEST(test_corrupted_bit_fails_checksum);
+  RUN_TEST(test_missing_data_edge);
+  RUN_TEST(test_missing_first_edge_is_harmless);
+  RUN_TEST(test_truncated_trace);
+  return UNITY_END();
+}
@@ -0,0 +1,370 @@
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <chrono>
+
+#include "app/Telemetry.h"
+#include "util/JsonWriter.h"
+
+// util::JsonWriter against ArduinoJson (the serializer it replaced) for
+// values whose text is unambiguous, plus its own rules: float trimming,
+// NaN -> null, no "-0", overflow, and its size/time per telemetry record.
+
+namespace {
+
+char gBuffer[512];
+char gReference[512];
+
+// {"v":<value>} as written by JsonWriter::addFloat().
+const char* floatJson(float value, uint8_t decimals = 2) {
+  util::JsonWriter json(gBuffer, sizeof(gBuffer));
+  json.beginObject();
+  json.addFloat("v", value, decimals);
+  json.endObject();
+  return json.c_str();
+}
+
+// Accepts `limit` bytes, then fails every write (a full socket buffer).
+class LimitedPrint : public Print {
+ public:
+  explicit LimitedPrint(size_t limit) : limit_(limit) {}
+
+  size_t write(uint8_t) override {
+    if (written_ == limit_) {
+      return 0;
+    }
+    ++written_;
+    return 1;
+  }
+
+  size_t written() const { return written_; }
+
+ private:
+  size_t limit_;
+  size_t written_ = 0;
+};
+
+// One batch record the way Telemetry wrote it with ArduinoJson (same keys,
+// same order).
+size_t serializeRecordArduinoJson(const app::Telemetry::Sample& sample, char* out, size_t size) {
+  using namespace app::telemetry_keys;
+
+  JsonDocument doc;
+  JsonObject record = doc.to<JsonObject>();
+  record[kTs] = sample.tsMs;
+  JsonObject values = record[kValues].to<JsonObject>();
+  if (sample.dht.ok) {
+    values[kTemperatureC] = sample.dht.temperatureC;
+    values[kHumidityPct] = sample.dht.humidityPct;
+  } else {
+    values[kTemperatureC] = nullptr;
+    values[kHumidityPct] = nullptr;
+  }
+  values[kMotion] = sample.motion.motionCount > 0 || sample.motion.activeNow;
+  values[kMotionCount] = sample.motion.motionCount;
+  values[kOccupancyPct] = sample.motion.occupancyPct();
+  if (sample.motion.hasEvent) {
+    values[kMotionFirstMs] = sample.motion.firstEventOffsetMs;
+    values[kMotionLastMs] = sample.motion.lastEventOffsetMs;
+  }
+  values[kAirQualityRaw] = sample.mq135Raw;
+  values[kAirQualityMv] = sample.mq135MilliVolts;
+  if (sample.lightLux >= 0) {
+    values[kLightLux] = sample.lightLux;
+  } else {
+    values[kLightLux] = nullptr;
+  }
+  values[kLightOn] = sample.lightOn;
+  values[kManualOff] = sample.manualOff;
+  values[kSelfLightEnable] = sample.selfLightEnable;
+  values[kValveOn] = sample.valveOn;
+  values[kSelfValveEnable] = sample.selfValveEnable;
+  return serializeJson(doc, out, size);
+}
+
+// A typical sample; floats with an exact short text so both serializers
+// print the same digits.
+app::Telemetry::Sample typicalSample() {
+  sensors::DhtReading dht;
+  dht.ok = true;
+  dht.temperatureC = 23.5f;
+  dht.humidityPct = 61.25f;
+
+  sensors::MotionWindow motion;
+  motion.windowMs = 10000;
+  motion.motionCount = 3;
+  motion.hasEvent = true;
+  motion.firstEventOffsetMs = 1250;
+  motion.lastEventOffsetMs = 8700;
+  motion.occupiedMs = 4000;
+
+  app::Telemetry telemetry;
+  telemetry.updateDht(dht);
+  telemetry.updateMotion(motion);
+  telemetry.updateSensors(1834, 1478, 312.5f);
+  controllers::LightState light;
+  light.lightOn = true;
+  telemetry.captureSample(0, light, controllers::WateringState(), true, false);
+
+  app::Telemetry::Sample sample;
+  telemetry.popOldest(sample);
+  sample.tsMs = 1700000000123ULL;
+  return sample;
+}
+
+template <typename Fn>
+double nsPerCall(uint32_t calls, Fn fn) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < calls; ++i) {
+    fn();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / calls;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_object_matches_arduinojson() {
+  util::JsonWriter json(gBuffer, sizeof(gBuffer));
+  json.beginObject();
+  json.addInt("i", -42);
+  json.addInt("min", INT32_MIN);
+  json.addUint("u", UINT32_MAX);
+  json.addUint64("big", UINT64_MAX);
+  json.addBool("t", true);
+  json.addBool("f", false);
+  json.addString("s", "a \"quoted\" \\ path");
+  json.addString("none", nullptr);
+  json.addFloat("x", 23.5f);
+  json.addFloat("neg", -0.25f);
+  json.addFloat("p", 1013.25f);
+  json.addFloat("w", 5.0f);
+  json.beginObject("n");
+  json.beginObject("empty");
+  json.endObject();
+  json.addUint("after", 1);
+  json.endObject();
+  json.addNull("z");
+  json.endObject();
+  TEST_ASSERT_TRUE(json.ok());
+
+  JsonDocument doc;
+  JsonObject root = doc.to<JsonObject>();
+  root["i"] = -42;
+  root["min"] = INT32_MIN;
+  root["u"] = UINT32_MAX;
+  root["big"] = UINT64_MAX;
+  root["t"] = true;
+  root["f"] = false;
+  root["s"] = "a \"quoted\" \\ path";
+  root["none"] = nullptr;
+  root["x"] = 23.5f;
+  root["neg"] = -0.25f;
+  root["p"] = 1013.25f;
+  root["w"] = 5.0f;
+  JsonObject nested = root["n"].to<JsonObject>();
+  nested["empty"].to<JsonObject>();
+  nested["after"] = 1;
+  root["z"] = nullptr;
+  serializeJson(doc, gReference, sizeof(gReference));
+
+  TEST_ASSERT_EQUAL_STRING(gReference, json.c_str());
+  TEST_ASSERT_EQUAL_size_t(strlen(gReference), json.length());
+}
+
+// Batch shape: commas between array elements and after nested objects.
+void test_batch_array_matches_arduinojson() {
+  util::JsonWriter json(gBuffer, sizeof(gBuffer));
+  json.beginArray();
+  for (uint32_t i = 0; i < 3; ++i) {
+    json.beginObject();
+    json.addUint64("ts", 1700000000000ULL + i);
+    json.beginObject("values");
+    json.addUint("n", i);
+    json.addBool("on", i % 2 == 0);
+    json.endObject();
+    json.endObject();
+  }
+  json.beginObject();
+  json.endObject();
+  json.endArray();
+  TEST_ASSERT_TRUE(json.ok());
+
+  JsonDocument doc;
+  JsonArray root = doc.to<JsonArray>();
+  for (uint32_t i = 0; i < 3; ++i) {
+    JsonObject record = root.add<JsonObject>();
+    record["ts"] = 1700000000000ULL + i;
+    JsonObject values = record["values"].to<JsonObject>();
+    values["n"] = i;
+    values["on"] = i % 2 == 0;
+  }
+  root.add<JsonObject>();
+  serializeJson(doc, gReference, sizeof(gReference));
+
+  TEST_ASSERT_EQUAL_STRING(gReference, json.c_str());
+}
+
+void test_float_trimming() {
+  TEST_ASSERT_EQUAL_STRING("{\"v\":23.4}", floatJson(23.4f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":5}", floatJson(5.0f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":0.05}", floatJson(0.05f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":1}", floatJson(0.999f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":-1.5}", floatJson(-1.5f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":12.3}", floatJson(12.345f, 1));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":12}", floatJson(12.345f, 0));
+  // More than 6 decimals is clamped to 6.
+  TEST_ASSERT_EQUAL_STRING("{\"v\":0.123457}", floatJson(0.1234567f, 9));
+}
+
+void test_negative_zero() {
+  TEST_ASSERT_EQUAL_STRING("{\"v\":0}", floatJson(-0.0f));
+  // Rounds to zero at 2 decimals: no sign either.
+  TEST_ASSERT_EQUAL_STRING("{\"v\":0}", floatJson(-0.001f));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":-0.01}", floatJson(-0.006f));
+}
+
+void test_non_finite_is_null() {
+  TEST_ASSERT_EQUAL_STRING("{\"v\":null}", floatJson(NAN));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":null}", floatJson(INFINITY));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":null}", floatJson(-INFINITY));
+  TEST_ASSERT_EQUAL_STRING("{\"v\":null}", floatJson(3.0e9f));
+}
+
+void test_control_characters_become_spaces() {
+  util::JsonWriter json(gBuffer, sizeof(gBuffer));
+  json.beginObject();
+  json.addString("s", "a\tb\nc");
+  json.endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"s\":\"a b c\"}", json.c_str());
+}
+
+void test_buffer_overflow() {
+  const char expected[] = "{\"key\":12345}";
+
+  // Exact fit: the capacity includes the NUL.
+  char exact[sizeof(expected)];
+  util::JsonWriter fits(exact, sizeof(exact));
+  fits.beginObject();
+  fits.addUint("key", 12345);
+  fits.endObject();
+  TEST_ASSERT_TRUE(fits.ok());
+  TEST_ASSERT_EQUAL_STRING(expected, exact);
+
+  // One byte short: stops appending, stays NUL-terminated.
+  char shortBuffer[sizeof(expected) - 1];
+  util::JsonWriter overflow(shortBuffer, sizeof(shortBuffer));
+  overflow.beginObject();
+  overflow.addUint("key", 12345);
+  overflow.endObject();
+  TEST_ASSERT_FALSE(overflow.ok());
+  TEST_ASSERT_EQUAL_size_t(sizeof(shortBuffer) - 1, overflow.length());
+  TEST_ASSERT_EQUAL_size_t(overflow.length(), strlen(shortBuffer));
+
+  // Later fields are dropped, not appended after a gap.
+  overflow.addBool("more", true);
+  TEST_ASSERT_FALSE(overflow.ok());
+  TEST_ASSERT_EQUAL_size_t(sizeof(shortBuffer) - 1, strlen(shortBuffer));
+
+  util::JsonWriter empty(gBuffer, 0);
+  TEST_ASSERT_FALSE(empty.ok());
+}
+
+void test_print_short_write() {
+  LimitedPrint out(5);
+  util::JsonWriter json(out);
+  json.beginObject();
+  json.addUint("key", 12345);
+  json.endObject();
+  TEST_ASSERT_FALSE(json.ok());
+  TEST_ASSERT_EQUAL_size_t(5, json.length());
+  TEST_ASSERT_EQUAL_size_t(5, out.written());
+}
+
+// Telemetry::kMaxJsonBytes / kMaxRecordBytes hold the longest sample the
+// firmware can produce.
+void test_telemetry_worst_case_fits_bound() {
+  // Longest float texts below the null cut-off, for the 2-decimal format.
+  const float floats[] = {-2147483520.0f, -16777215.0f, -1048575.94f, -131071.99f};
+
+  for (uint8_t i = 0; i < sizeof(floats) / sizeof(floats[0]); ++i) {
+    sensors::DhtReading dht;
+    dht.ok = true;
+    dht.temperatureC = floats[i];
+    dht.humidityPct = floats[i];
+
+    sensors::MotionWindow motion;
+    motion.windowMs = 1;
+    motion.motionCount = UINT16_MAX;
+    motion.hasEvent = true;
+    motion.firstEventOffsetMs = UINT32_MAX;
+    motion.lastEventOffsetMs = UINT32_MAX;
+    motion.occupiedMs = 1;
+
+    app::Telemetry telemetry;
+    telemetry.updateDht(dht);
+    telemetry.updateMotion(motion);
+    telemetry.updateSensors(INT32_MIN, UINT32_MAX, -floats[i]);
+    telemetry.captureSample(0, controllers::LightState(), controllers::WateringState(), false, false);
+
+    char values[app::Telemetry::kMaxJsonBytes];
+    util::JsonWriter valuesJson(values, sizeof(values));
+    TEST_ASSERT_TRUE(telemetry.writeLatestJson(valuesJson));
+
+    app::Telemetry::Sample sample;
+    TEST_ASSERT_TRUE(telemetry.popOldest(sample));
+    sample.tsMs = UINT64_MAX;
+    char record[app::Telemetry::kMaxRecordBytes];
+    util::JsonWriter recordJson(record, sizeof(record));
+    app::Telemetry::writeRecordJson(recordJson, sample);
+    TEST_ASSERT_TRUE(recordJson.ok());
+  }
+}
+
+// Bytes and host time per Telemetry record, JsonWriter vs ArduinoJson. The
+// output must be identical; the timings are reported, not asserted.
+void test_telemetry_record_cost_vs_arduinojson() {
+  const app::Telemetry::Sample sample = typicalSample();
+
+  util::JsonWriter json(gBuffer, sizeof(gBuffer));
+  app::Telemetry::writeRecordJson(json, sample);
+  TEST_ASSERT_TRUE(json.ok());
+  const size_t referenceBytes = serializeRecordArduinoJson(sample, gReference, sizeof(gReference));
+  TEST_ASSERT_EQUAL_STRING(gReference, json.c_str());
+  TEST_ASSERT_EQUAL_size_t(referenceBytes, json.length());
+
+  constexpr uint32_t kCalls = 20000;
+  volatile size_t sink = 0;
+  const double writerNs = nsPerCall(kCalls, [&]() {
+    util::JsonWriter writer(gBuffer, sizeof(gBuffer));
+    app::Telemetry::writeRecordJson(writer, sample);
+    sink = sink + writer.length();
+  });
+  const double arduinoJsonNs = nsPerCall(kCalls, [&]() {
+    sink = sink + serializeRecordArduinoJson(sample, gReference, sizeof(gReference));
+  });
+
+  char message[128];
+  snprintf(message, sizeof(message),
+           "record %u bytes: JsonWriter %.0f ns/call, ArduinoJson %.0f ns/call",
+           (unsigned)json.length(), writerNs, arduinoJsonNs);
+  TEST_MESSAGE(message);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_object_matches_arduinojson);
+  RUN_TEST(test_batch_array_matches_arduinojson);
+  RUN_TEST(test_float_trimming);
+  RUN_TEST(test_negative_zero);
+  RUN_TEST(test_non_finite_is_null);
+  RUN_TEST(test_control_characters_become_spaces);
+  RUN_TEST(test_buffer_overflow);
+  RUN_TEST(test_print_short_write);
+  RUN_TEST(test_telemetry_worst_case_fits_bound);
+  RUN_TEST(test_telemetry_record_cost_vs_arduinojson);
+  return UNITY_END();
+}
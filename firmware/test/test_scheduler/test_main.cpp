@@ -0,0 +1,242 @@
+#include <unity.h>
+
+#include "app/Scheduler.h"
+
+// Scheduler on a simulated clock: tasks "run" by advancing the clock, and
+// sleepUntilNextDeadline() jumps it forward, so a whole day takes seconds.
+// The polling loop() it replaced is modelled on the same clock for comparison.
+
+namespace {
+
+uint32_t gNowMs = 0;
+
+uint32_t fakeNow() { return gNowMs; }
+void fakeSleep(uint32_t ms) { gNowMs += ms; }
+
+// ---- Simulated day ----
+
+constexpr uint32_t kDayMs = 24UL * 60 * 60 * 1000;
+constexpr uint32_t kSensorsBusyMs = 3;
+constexpr uint32_t kTelemetryBusyMs = 8;
+
+void taskFast(uint32_t) {}
+void taskSensors(uint32_t) { gNowMs += kSensorsBusyMs; }
+void taskTelemetry(uint32_t) { gNowMs += kTelemetryBusyMs; }
+
+// Runs the five main.cpp tasks on the scheduler for a day from `startMs`.
+struct ScheduledDay {
+  app::Scheduler scheduler;
+  app::Scheduler::TaskId button, network, controllers, sensors, telemetry;
+  uint32_t elapsedMs = 0;
+};
+
+void runScheduledDay(ScheduledDay& day, uint32_t startMs) {
+  gNowMs = startMs;
+  day.scheduler.setClock(fakeNow, fakeSleep);
+  day.scheduler.begin(gNowMs);
+
+  day.button = day.scheduler.addTask("button", taskFast, 25, 50);
+  day.network = day.scheduler.addTask("network", taskFast, 20, 40);
+  day.controllers = day.scheduler.addTask("controllers", taskFast, 50, 30);
+  day.sensors = day.scheduler.addTask("sensors", taskSensors, 5000, 20);
+  day.telemetry = day.scheduler.addTask("telemetry", taskTelemetry, 10000, 10, 10000);
+
+  while (gNowMs - startMs < kDayMs) {
+    day.scheduler.runDue(gNowMs);
+    day.scheduler.sleepUntilNextDeadline(100);
+  }
+  day.elapsedMs = gNowMs - startMs;
+}
+
+// ---- Baseline: the polling loop() the scheduler replaced ----
+// Every pass runs WiFi/MQTT upkeep, the button and the light controller,
+// then checks `nowMs - lastXMs >= period` for sensors and telemetry and
+// sets lastXMs = nowMs. It never sleeps.
+
+constexpr uint32_t kBaselinePassMs = 3;  // Unconditional per-pass work
+
+struct PolledTask {
+  uint32_t periodMs;
+  uint32_t busyMs;
+  uint32_t lastMs;
+  uint32_t runs;
+  uint32_t maxLatenessMs;
+};
+
+// Returns the busy (non-idle) time; the clock only moves by work.
+uint32_t runBaselineDay(PolledTask* tasks, uint8_t count, uint32_t startMs) {
+  gNowMs = startMs;
+  uint32_t busyMs = 0;
+  while (gNowMs - startMs < kDayMs) {
+    gNowMs += kBaselinePassMs;
+    busyMs += kBaselinePassMs;
+    for (uint8_t i = 0; i < count; ++i) {
+      PolledTask& task = tasks[i];
+      const uint32_t sinceLast = gNowMs - task.lastMs;
+      if (sinceLast < task.periodMs) {
+        continue;
+      }
+      if (sinceLast - task.periodMs > task.maxLatenessMs) {
+        task.maxLatenessMs = sinceLast - task.periodMs;
+      }
+      task.lastMs = gNowMs;
+      ++task.runs;
+      gNowMs += task.busyMs;
+      busyMs += task.busyMs;
+    }
+  }
+  return busyMs;
+}
+
+// ---- Priority order ----
+
+char gOrder[8];
+uint8_t gOrderCount = 0;
+
+void taskA(uint32_t) { gOrder[gOrderCount++] = 'A'; }
+void taskB(uint32_t) { gOrder[gOrderCount++] = 'B'; }
+void taskC(uint32_t) { gOrder[gOrderCount++] = 'C'; }
+
+uint32_t gSlowRuns = 0;
+void taskCounted(uint32_t) { ++gSlowRuns; }
+
+}  // namespace
+
+void setUp() {
+  gOrderCount = 0;
+  gSlowRuns = 0;
+}
+void tearDown() {}
+
+// Periods as in main.cpp. The clock starts 30 s before the 32-bit wrap,
+// so deadlines cross it early in the day.
+void test_simulated_day() {
+  ScheduledDay day;
+  runScheduledDay(day, 0xFFFFFFFFu - 30000);
+  const app::Scheduler& scheduler = day.scheduler;
+  const app::Scheduler::TaskId button = day.button;
+  const app::Scheduler::TaskId network = day.network;
+  const app::Scheduler::TaskId controllers = day.controllers;
+  const app::Scheduler::TaskId sensors = day.sensors;
+  const app::Scheduler::TaskId telemetry = day.telemetry;
+  const uint32_t elapsedMs = day.elapsedMs;
+
+  // Fixed-rate deadlines: no drift over the day, no skipped runs.
+  const app::Scheduler::TaskId ids[] = {button, network, controllers, sensors, telemetry};
+  const uint32_t periods[] = {25, 20, 50, 5000, 10000};
+  for (uint8_t i = 0; i < 5; ++i) {
+    const uint32_t expected = elapsedMs / periods[i];
+    const uint32_t runs = scheduler.taskStats(ids[i]).runs;
+    TEST_ASSERT_TRUE_MESSAGE(runs + 1 >= expected && runs <= expected + 1,
+                             scheduler.taskName(ids[i]));
+  }
+
+  // Start jitter: a task can only wait for the runs already in progress
+  // (no preemption), never a whole period.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kSensorsBusyMs + kTelemetryBusyMs,
+                                   scheduler.taskStats(button).maxLatenessMs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kSensorsBusyMs + kTelemetryBusyMs,
+                                   scheduler.taskStats(network).maxLatenessMs);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.taskStats(sensors).maxLatenessMs);
+  TEST_ASSERT_EQUAL_UINT32(kSensorsBusyMs, scheduler.taskStats(sensors).maxRunMs);
+  TEST_ASSERT_EQUAL_UINT32(kTelemetryBusyMs, scheduler.taskStats(telemetry).maxRunMs);
+
+  // Idle accounting: everything that was not task run time was slept.
+  const app::Scheduler::Stats& stats = scheduler.stats();
+  const uint32_t busyMs = scheduler.taskStats(sensors).runs * kSensorsBusyMs +
+                          scheduler.taskStats(telemetry).runs * kTelemetryBusyMs;
+  TEST_ASSERT_EQUAL_UINT32(elapsedMs, stats.elapsedMs);
+  TEST_ASSERT_EQUAL_UINT32(elapsedMs - busyMs, stats.sleptMs);
+  TEST_ASSERT_EQUAL_UINT32((uint64_t)(elapsedMs - busyMs) * 100 / elapsedMs, stats.idlePct());
+}
+
+// The same day under the polling loop(): it never sleeps (0% idle), and
+// re-anchoring at the late start (lastXMs = nowMs) turns every late start
+// into drift, so periodic tasks lose runs over the day.
+void test_baseline_loop_comparison() {
+  ScheduledDay day;
+  runScheduledDay(day, 0);
+  const app::Scheduler::TaskStats& scheduledSensors = day.scheduler.taskStats(day.sensors);
+  const app::Scheduler::TaskStats& scheduledTelemetry = day.scheduler.taskStats(day.telemetry);
+
+  PolledTask polled[] = {
+      {5000, kSensorsBusyMs, 0, 0, 0},
+      {10000, kTelemetryBusyMs, 0, 0, 0},
+  };
+  const uint32_t baselineBusyMs = runBaselineDay(polled, 2, 0);
+  const uint32_t baselineElapsedMs = gNowMs;
+  const uint32_t baselineIdlePct =
+      (uint32_t)((uint64_t)(baselineElapsedMs - baselineBusyMs) * 100 / baselineElapsedMs);
+
+  // Idle: the scheduler sleeps nearly all day, the loop not at all.
+  TEST_ASSERT_EQUAL_UINT32(0, baselineIdlePct);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(99, day.scheduler.stats().idlePct());
+
+  // Start jitter: the loop starts up to a pass late; the scheduler is on time.
+  TEST_ASSERT_GREATER_THAN_UINT32(0, polled[0].maxLatenessMs);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, polled[1].maxLatenessMs);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduledSensors.maxLatenessMs);
+  TEST_ASSERT_LESS_THAN_UINT32(polled[1].maxLatenessMs, scheduledTelemetry.maxLatenessMs);
+
+  // Drift: fixed-rate deadlines keep every run; the loop loses some.
+  const uint32_t expectedSensorRuns = kDayMs / 5000;
+  const uint32_t expectedTelemetryRuns = kDayMs / 10000;
+  TEST_ASSERT_UINT32_WITHIN(1, expectedSensorRuns, scheduledSensors.runs);
+  TEST_ASSERT_UINT32_WITHIN(1, expectedTelemetryRuns, scheduledTelemetry.runs);
+  TEST_ASSERT_LESS_THAN_UINT32(expectedSensorRuns - 1, polled[0].runs);
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "idle %u%% vs %u%%; sensors late <= %u vs %u ms, %u vs %u runs",
+           (unsigned)day.scheduler.stats().idlePct(), (unsigned)baselineIdlePct,
+           (unsigned)scheduledSensors.maxLatenessMs, (unsigned)polled[0].maxLatenessMs,
+           (unsigned)scheduledSensors.runs, (unsigned)polled[0].runs);
+  TEST_MESSAGE(message);
+}
+
+void test_priority_order() {
+  gNowMs = 1000;
+  app::Scheduler scheduler;
+  scheduler.setClock(fakeNow, fakeSleep);
+  scheduler.begin(gNowMs);
+  scheduler.addTask("low", taskA, 100, 1);
+  scheduler.addTask("high", taskB, 100, 9);
+  scheduler.addTask("mid", taskC, 100, 5);
+
+  scheduler.runDue(gNowMs);
+  TEST_ASSERT_EQUAL_UINT8(3, gOrderCount);
+  TEST_ASSERT_EQUAL_INT('B', gOrder[0]);
+  TEST_ASSERT_EQUAL_INT('C', gOrder[1]);
+  TEST_ASSERT_EQUAL_INT('A', gOrder[2]);
+
+  // Each task runs at most once per pass.
+  scheduler.runDue(gNowMs);
+  TEST_ASSERT_EQUAL_UINT8(3, gOrderCount);
+}
+
+// A task that falls several periods behind runs once, not in a burst, and
+// is re-anchored to its actual start.
+void test_missed_runs_are_skipped() {
+  gNowMs = 0;
+  app::Scheduler scheduler;
+  scheduler.setClock(fakeNow, fakeSleep);
+  scheduler.begin(gNowMs);
+  scheduler.addTask("slow", taskCounted, 10, 1);
+
+  scheduler.runDue(gNowMs);
+  TEST_ASSERT_EQUAL_UINT32(1, gSlowRuns);
+
+  gNowMs = 55;
+  scheduler.runDue(gNowMs);
+  TEST_ASSERT_EQUAL_UINT32(2, gSlowRuns);
+  TEST_ASSERT_EQUAL_UINT32(10, scheduler.msUntilNextDeadline(gNowMs));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_simulated_day);
+  RUN_TEST(test_baseline_loop_comparison);
+  RUN_TEST(test_priority_order);
+  RUN_TEST(test_missed_runs_are_skipped);
+  return UNITY_END();
+}
@@ -0,0 +1,141 @@
+#include <unity.h>
+
+#include "app/Settings.h"
+
+// Settings change notifications: exactly one per real value change, none
+// for a set that leaves the value as it was.
+
+namespace {
+
+uint32_t gLightChanges = 0;
+uint32_t gValveChanges = 0;
+
+void onChange(app::Settings::Change change) {
+  if (change == app::Settings::Change::Light) {
+    ++gLightChanges;
+  } else {
+    ++gValveChanges;
+  }
+}
+
+}  // namespace
+
+void setUp() {
+  gLightChanges = 0;
+  gValveChanges = 0;
+}
+void tearDown() {}
+
+void test_setting_defaults_is_silent() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.setManualOff(settings.manualOff());
+  settings.setRemoteLightOverride(settings.remoteOverrideEnabled(), settings.remoteLightOn());
+  settings.setTempLimitEnabled(settings.tempLimitEnabled());
+  settings.setTempTooColdC(settings.tempTooColdC());
+  settings.setSelfLightEnable(settings.selfLightEnable());
+  settings.setSelfValveEnable(settings.selfValveEnable());
+
+  TEST_ASSERT_EQUAL_UINT32(0, gLightChanges);
+  TEST_ASSERT_EQUAL_UINT32(0, gValveChanges);
+}
+
+void test_light_setters_fire_once_per_change() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.setManualOff(true);
+  settings.setManualOff(true);
+  TEST_ASSERT_EQUAL_UINT32(1, gLightChanges);
+
+  settings.setTempLimitEnabled(true);
+  settings.setTempLimitEnabled(true);
+  TEST_ASSERT_EQUAL_UINT32(2, gLightChanges);
+
+  settings.setTempTooColdC(12.5f);
+  settings.setTempTooColdC(12.5f);
+  TEST_ASSERT_EQUAL_UINT32(3, gLightChanges);
+
+  settings.setSelfLightEnable(false);
+  settings.setSelfLightEnable(false);
+  TEST_ASSERT_EQUAL_UINT32(4, gLightChanges);
+
+  // Setting a value back is a change too.
+  settings.setManualOff(false);
+  TEST_ASSERT_EQUAL_UINT32(5, gLightChanges);
+
+  TEST_ASSERT_EQUAL_UINT32(0, gValveChanges);
+}
+
+// Either half of the override is a change; the pair is one notification.
+void test_remote_override_fires_once_per_change() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.setRemoteLightOverride(true, true);
+  TEST_ASSERT_EQUAL_UINT32(1, gLightChanges);
+  settings.setRemoteLightOverride(true, true);
+  TEST_ASSERT_EQUAL_UINT32(1, gLightChanges);
+  settings.setRemoteLightOverride(true, false);
+  TEST_ASSERT_EQUAL_UINT32(2, gLightChanges);
+  settings.setRemoteLightOverride(false, false);
+  TEST_ASSERT_EQUAL_UINT32(3, gLightChanges);
+  TEST_ASSERT_EQUAL_UINT32(0, gValveChanges);
+}
+
+void test_valve_setter_fires_valve_only() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.setSelfValveEnable(true);
+  settings.setSelfValveEnable(true);
+  TEST_ASSERT_EQUAL_UINT32(1, gValveChanges);
+  settings.setSelfValveEnable(false);
+  TEST_ASSERT_EQUAL_UINT32(2, gValveChanges);
+  TEST_ASSERT_EQUAL_UINT32(0, gLightChanges);
+}
+
+// Every toggle changes the latch, so every toggle notifies.
+void test_toggle_always_fires() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.toggleManualOff();
+  TEST_ASSERT_TRUE(settings.manualOff());
+  settings.toggleManualOff();
+  TEST_ASSERT_FALSE(settings.manualOff());
+  TEST_ASSERT_EQUAL_UINT32(2, gLightChanges);
+}
+
+void test_repeated_nan_threshold_is_silent() {
+  app::Settings settings;
+  settings.setChangeHandler(onChange);
+
+  settings.setTempTooColdC(NAN);
+  settings.setTempTooColdC(NAN);
+  TEST_ASSERT_EQUAL_UINT32(1, gLightChanges);
+  settings.setTempTooColdC(18.0f);
+  TEST_ASSERT_EQUAL_UINT32(2, gLightChanges);
+}
+
+void test_no_handler() {
+  app::Settings settings;
+  settings.setManualOff(true);
+  settings.setSelfValveEnable(true);
+  TEST_ASSERT_TRUE(settings.manualOff());
+  TEST_ASSERT_TRUE(settings.selfValveEnable());
+  TEST_ASSERT_EQUAL_UINT32(0, gLightChanges + gValveChanges);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_setting_defaults_is_silent);
+  RUN_TEST(test_light_setters_fire_once_per_change);
+  RUN_TEST(test_remote_override_fires_once_per_change);
+  RUN_TEST(test_valve_setter_fires_valve_only);
+  RUN_TEST(test_toggle_always_fires);
+  RUN_TEST(test_repeated_nan_threshold_is_silent);
+  RUN_TEST(test_no_handler);
+  return UNITY_END();
+}
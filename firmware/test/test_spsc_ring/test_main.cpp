@@ -0,0 +1,157 @@
+#include <unity.h>
+
+#include <thread>
+
+#include "util/SpscRing.h"
+
+// Cross-thread stress: one producer thread and one consumer thread, as the
+// network task (core 0) and loop() (core 1) use the rings on the device.
+
+namespace {
+
+constexpr uint32_t kItems = 1000000;
+
+struct Message {
+  uint32_t seq;
+  uint32_t check;  // ~seq: a torn copy would not match
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_single_thread_fill_and_drain() {
+  util::SpscRing<uint32_t, 4> ring;
+  TEST_ASSERT_TRUE(ring.empty());
+  for (uint32_t i = 0; i < 4; ++i) {
+    TEST_ASSERT_TRUE(ring.push(i));
+  }
+  TEST_ASSERT_FALSE(ring.push(99));
+  TEST_ASSERT_EQUAL_UINT32(1, ring.dropped());
+  TEST_ASSERT_EQUAL_UINT32(4, ring.size());
+
+  uint32_t value;
+  for (uint32_t i = 0; i < 4; ++i) {
+    TEST_ASSERT_TRUE(ring.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(i, value);
+  }
+  TEST_ASSERT_FALSE(ring.pop(value));
+}
+
+// Every message arrives exactly once, in order, intact; every rejected
+// push() is counted in dropped().
+void test_two_threads_order_count_and_drops() {
+  static util::SpscRing<Message, 64> ring;
+
+  uint32_t rejected = 0;
+  std::thread producer([&rejected]() {
+    for (uint32_t seq = 0; seq < kItems;) {
+      Message message;
+      message.seq = seq;
+      message.check = ~seq;
+      if (ring.push(message)) {
+        ++seq;
+      } else {
+        ++rejected;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t received = 0;
+  uint32_t outOfOrder = 0;
+  uint32_t torn = 0;
+  std::thread consumer([&]() {
+    Message message;
+    while (received < kItems) {
+      if (!ring.pop(message)) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (message.seq != received) {
+        ++outOfOrder;
+      }
+      if (message.check != ~message.seq) {
+        ++torn;
+      }
+      ++received;
+    }
+  });
+
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(kItems, received);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(rejected, ring.dropped());
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+// producerSlotAt()/commitPush(n): a multi-slot message becomes visible all
+// at once, never partially.
+void test_two_threads_multi_slot_commit() {
+  static util::SpscRing<uint32_t, 16> ring;
+  constexpr uint32_t kGroups = 200000;
+  constexpr uint32_t kGroupSize = 3;
+
+  std::thread producer([]() {
+    for (uint32_t group = 0; group < kGroups;) {
+      uint32_t* slots[kGroupSize];
+      bool room = true;
+      for (uint32_t i = 0; i < kGroupSize && room; ++i) {
+        slots[i] = ring.producerSlotAt(i);
+        room = slots[i] != nullptr;
+      }
+      if (!room) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (uint32_t i = 0; i < kGroupSize; ++i) {
+        *slots[i] = group * kGroupSize + i;
+      }
+      ring.commitPush(kGroupSize);
+      ++group;
+    }
+  });
+
+  uint32_t partial = 0;
+  uint32_t wrong = 0;
+  uint32_t next = 0;
+  std::thread consumer([&]() {
+    while (next < kGroups * kGroupSize) {
+      const uint32_t available = ring.size();
+      if (available == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (available % kGroupSize != 0) {
+        ++partial;
+      }
+      for (uint32_t i = 0; i < kGroupSize; ++i) {
+        const uint32_t* slot = ring.consumerSlotAt(i);
+        if (slot == nullptr || *slot != next + i) {
+          ++wrong;
+        }
+      }
+      ring.commitPop(kGroupSize);
+      next += kGroupSize;
+    }
+  });
+
+  producer.join();
+  consumer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, partial);
+  TEST_ASSERT_EQUAL_UINT32(0, wrong);
+  TEST_ASSERT_TRUE(ring.empty());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_thread_fill_and_drain);
+  RUN_TEST(test_two_threads_order_count_and_drops);
+  RUN_TEST(test_two_threads_multi_slot_commit);
+  return UNITY_END();
+}